@@ -29,12 +29,33 @@
 #ifndef _MDL_CONCURRENT
 #define _MDL_CONCURRENT
 
+#include "src/lib/h/concurrent/barrier.h"
+#include "src/lib/h/concurrent/cancellation.h"
+#include "src/lib/h/concurrent/concurrenthashmap.h"
+#include "src/lib/h/concurrent/contextexecutor.h"
 #include "src/lib/h/concurrent/exception.h"
 #include "src/lib/h/concurrent/executors.h"
+#include "src/lib/h/concurrent/fiber.h"
 #include "src/lib/h/concurrent/future.h"
+#include "src/lib/h/concurrent/futex.h"
+#include "src/lib/h/concurrent/latch.h"
+#include "src/lib/h/concurrent/lockprofiler.h"
+#include "src/lib/h/concurrent/managedblocking.h"
+#include "src/lib/h/concurrent/notifier.h"
+#include "src/lib/h/concurrent/partitionedexecutor.h"
+#include "src/lib/h/concurrent/phaser.h"
+#include "src/lib/h/concurrent/pipeline.h"
+#include "src/lib/h/concurrent/ratelimiter.h"
+#include "src/lib/h/concurrent/reactor.h"
+#include "src/lib/h/concurrent/reclamation.h"
 #include "src/lib/h/concurrent/synchronizable.h"
 #include "src/lib/h/concurrent/threadlocal.h"
 #include "src/lib/h/concurrent/semaphore.h"
+#include "src/lib/h/concurrent/serialexecutor.h"
+#include "src/lib/h/concurrent/sharedsynchronizable.h"
+#include "src/lib/h/concurrent/spinwait.h"
+#include "src/lib/h/concurrent/stacktrace.h"
+#include "src/lib/h/concurrent/stripedcounter.h"
 #include "src/lib/h/concurrent/syncqueue.h"
 #include "src/lib/h/concurrent/thread.h"
 
@@ -29,10 +29,14 @@
 #ifndef _MDL_UTIL
 #define _MDL_UTIL
 
+#include "src/lib/h/util/blockpool.h"
 #include "src/lib/h/util/exception.h"
 #include "src/lib/h/util/functional.h"
 #include "src/lib/h/util/getopts.h"
+#include "src/lib/h/util/hash.h"
+#include "src/lib/h/util/resourcepool.h"
 #include "src/lib/h/util/string.h"
+#include "src/lib/h/util/threadhint.h"
 #include "src/lib/h/util/time.h"
 
 #endif // _MDL_UTIL
\ No newline at end of file
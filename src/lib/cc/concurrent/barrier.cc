@@ -0,0 +1,113 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../../h/concurrent/barrier.h"
+
+#include <exception>
+#include <stdexcept>
+
+namespace mdl {
+namespace concurrent {
+
+  namespace {
+    constexpr uint64_t kParty = uint64_t(1) << 32;
+
+    uint32_t ArrivedOf(uint64_t counts) { return static_cast<uint32_t>(counts); }
+    uint32_t PartiesOf(uint64_t counts) { return static_cast<uint32_t>(counts >> 32); }
+  }
+
+  Barrier::Barrier(int parties, std::function<void ()> completion, const WaitPolicy& policy) 
+      : completion(completion), counts(parties * kParty), spinWait(policy) {
+    if (parties <= 0) {
+      throw std::invalid_argument("Barrier needs at least one party");
+    }
+  }
+
+  long Barrier::ArriveAndWait() {
+    uint32_t current = phase.load(std::memory_order_acquire);
+    uint64_t previous = counts.fetch_add(1, std::memory_order_acq_rel);
+    if (ArrivedOf(previous) + 1 == PartiesOf(previous)) {
+      Complete(current);
+    } else {
+      Await(current);
+    }
+    return current;
+  }
+
+  void Barrier::ArriveAndDrop() {
+    uint32_t current = phase.load(std::memory_order_acquire);
+    uint64_t previous = counts.fetch_sub(kParty, std::memory_order_acq_rel);
+    uint32_t parties = PartiesOf(previous) - 1;
+    if (parties > 0 && ArrivedOf(previous) == parties) {
+      Complete(current);
+    }
+  }
+
+  int Barrier::Parties() const {
+    return PartiesOf(counts.load());
+  }
+
+  long Barrier::Phase() const {
+    return phase.load();
+  }
+
+  void Barrier::Complete(uint32_t current) {
+    std::exception_ptr error;
+    if (completion) {
+      try {
+        completion();
+      } catch (...) {
+        error = std::current_exception();
+      }
+    }
+
+    // Everyone else is waiting, nobody can arrive until the phase moves on.
+    counts.fetch_and(~uint64_t(UINT32_MAX), std::memory_order_relaxed);
+    phase.store(current + 1, std::memory_order_seq_cst);
+    if (waiters.load() > 0) {
+      FutexWakeAll(phase);
+    }
+
+    if (error) { std::rethrow_exception(error); }
+  }
+
+  void Barrier::Await(uint32_t current) {
+    auto advanced = [this, current]() { 
+      return phase.load(std::memory_order_acquire) != current; 
+    };
+    if (spinWait.Policy().Spins() && spinWait.Await(advanced)) { return; }
+
+    waiters++;
+    while (phase.load() == current) {
+      FutexWait(phase, current);
+    }
+    waiters--;
+  }
+
+} // concurrent
+} // mdl
@@ -0,0 +1,152 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../../h/concurrent/cancellation.h"
+
+#include "../../h/concurrent/exception.h"
+
+namespace mdl {
+namespace concurrent {
+
+  CancellationRegistration::CancellationRegistration() : id(0) {}
+
+  CancellationRegistration::CancellationRegistration(const std::shared_ptr<State>& state, long id)
+      : state(state), id(id) {}
+
+  CancellationRegistration::CancellationRegistration(CancellationRegistration&& other) 
+      : state(std::move(other.state)), id(other.id) {
+    other.id = 0;
+  }
+
+  CancellationRegistration::~CancellationRegistration() {
+    Unregister();
+  }
+
+  CancellationRegistration& CancellationRegistration::operator=(
+      CancellationRegistration&& other) {
+    Unregister();
+    state = std::move(other.state);
+    id = other.id;
+    other.id = 0;
+    return *this;
+  }
+
+  void CancellationRegistration::Unregister() {
+    if (!state || !id) { return; }
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    for (auto it = state->callbacks.begin(); it != state->callbacks.end(); it++) {
+      if (it->first == id) {
+        state->callbacks.erase(it);
+        break;
+      }
+    }
+
+    // A callback may unregister itself, that thread must not wait for itself.
+    while (state->runningId == id && state->runningThread != std::this_thread::get_id()) {
+      state->callbackDone.wait(lock);
+    }
+
+    state.reset();
+    id = 0;
+  }
+
+  CancellationToken::CancellationToken() {}
+
+  CancellationToken::CancellationToken(
+      const std::shared_ptr<CancellationRegistration::State>& state) : state(state) {}
+
+  bool CancellationToken::IsCancellationRequested() const {
+    return state && state->cancelled.load();
+  }
+
+  void CancellationToken::ThrowIfCancellationRequested() const {
+    if (IsCancellationRequested()) {
+      throw interrupted_exception("Task has been cancelled");
+    }
+  }
+
+  bool CancellationToken::CanBeCancelled() const {
+    return state != nullptr;
+  }
+
+  CancellationRegistration CancellationToken::Register(std::function<void ()>&& fn) const {
+    if (!state) { return CancellationRegistration(); }
+
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (!state->cancelled.load()) {
+        long id = ++state->idSeq;
+        state->callbacks.push_back(std::make_pair(id, std::move(fn)));
+        return CancellationRegistration(state, id);
+      }
+    }
+
+    // already cancelled.
+    fn();
+    return CancellationRegistration();
+  }
+
+  CancellationSource::CancellationSource() 
+      : state(std::make_shared<CancellationRegistration::State>()) {}
+
+  CancellationToken CancellationSource::Token() const {
+    return CancellationToken(state);
+  }
+
+  bool CancellationSource::Cancel() {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    if (state->cancelled.exchange(true)) { return false; }
+
+    // callbacks run without the lock, so that they're free to take other locks and unregister.
+    state->runningThread = std::this_thread::get_id();
+    while (!state->callbacks.empty()) {
+      auto callback = std::move(state->callbacks.front());
+      state->callbacks.pop_front();
+      state->runningId = callback.first;
+
+      lock.unlock();
+      try {
+        callback.second();
+      } catch (...) {}
+      lock.lock();
+
+      state->runningId = 0;
+      state->callbackDone.notify_all();
+    }
+    state->runningThread = std::thread::id();
+
+    return true;
+  }
+
+  bool CancellationSource::IsCancellationRequested() const {
+    return state->cancelled.load();
+  }
+
+} // concurrent
+} // mdl
@@ -38,6 +38,13 @@ namespace concurrent {
   interrupted_exception::interrupted_exception(const std::string& message)
       : std::runtime_error(message) {}
 
+  rejected_exception::rejected_exception(const rejected_exception& other) 
+      : std::runtime_error(other) {}
+  rejected_exception::rejected_exception(const char* message)
+      : std::runtime_error(message) {}
+  rejected_exception::rejected_exception(const std::string& message)
+      : std::runtime_error(message) {}
+
   execution_exception::execution_exception(const execution_exception& other) 
       : std::runtime_error(other) {}
   execution_exception::execution_exception(const char* message, int errorCode)
@@ -48,5 +55,23 @@ namespace concurrent {
     return errorCode;
   }
 
+  std::pair<std::string, int> _CurrentError() {
+    try {
+      throw;
+    } catch (int errorCode) {
+      return std::make_pair(std::string(), errorCode);
+    } catch (const char * msg) {
+      return std::make_pair(std::string(msg), -1);
+    } catch (const std::string& msg) {
+      return std::make_pair(msg, -1);
+    } catch (const execution_exception& ex) {
+      return std::make_pair(std::string(ex.what()), ex.what_code());
+    } catch (const std::exception& ex) {
+      return std::make_pair(std::string(ex.what()), -1);
+    } catch (...) {
+      return std::make_pair(std::string(), -1);
+    }
+  }
+
 } // concurrent
 } // mdl
@@ -28,14 +28,44 @@
 
 #include "../../h/concurrent/executors.h"
 
-#include <iostream>
+#include <chrono>
+
+#include "../../h/concurrent/stacktrace.h"
 
 namespace mdl {
 namespace concurrent {
+  namespace {
+    ExecutorOptions FixedSize(int numThreads) {
+      ExecutorOptions options;
+      options.coreThreads = numThreads;
+      options.maxThreads = numThreads;
+      return options;
+    }
+
+    long SteadyNanos() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+  }
+
   ExecutorService::ExecutorService(int numThreads, ThreadFactory& threadFactory) 
-      : numThreads(numThreads) {
-    for (int i = 0; i < numThreads; i++) {
-      threads.push_back(threadFactory.NewThread(&ExecutorService::WorkerThreadFn, this));
+      : ExecutorService(FixedSize(numThreads), threadFactory) {}
+
+  ExecutorService::ExecutorService(const ExecutorOptions& options, ThreadFactory& threadFactory)
+      : options(options), threadFactory(threadFactory), queue(options.queueCapacity, options.waitPolicy), 
+        compensator(*this) {
+    if (this->options.maxThreads < this->options.coreThreads) {
+      this->options.maxThreads = this->options.coreThreads;
+    }
+
+    sync.Synchronized<void>([this]() {
+      for (int i = 0; i < this->options.coreThreads; i++) {
+        StartThread(Task());
+      }
+    });
+
+    if (this->options.slowTaskMillis > 0) {
+      watchdog = named_thread("watchdog", &ExecutorService::WatchdogThreadFn, this);
     }
   }
 
@@ -44,7 +74,7 @@ namespace concurrent {
   }
 
   void ExecutorService::Execute(const std::function<void ()>& task) {
-    queue.Add([task] () {
+    Enqueue([task] () {
       try {
         task();
       } catch (...) {}
@@ -52,42 +82,345 @@ namespace concurrent {
   }
 
   void ExecutorService::Shutdown() {
-    if (shutdown) { return; }
+    if (shutdown.exchange(true)) { return; }
 
-    shutdown = true;
     std::thread stopper(&ExecutorService::ThreadInterrupterFn, this);
+    stopper.join();
 
-    for (auto it = threads.begin(); it != threads.end(); it++) {
-      it->join();
+    if (watchdog.joinable()) {
+      watchdogSync.Synchronized<void>([this]() { watchdogSync.NotifyAll(); });
+      watchdog.join();
     }
 
-    stopper.join();
+    // all workers have returned by now, and no new ones can be started.
+    sync.Synchronized<void>([this]() {
+      for (auto it = threads.begin(); it != threads.end(); it++) {
+        it->join();
+      }
+      threads.clear();
+      ReapRetired();
+    });
+  }
+
+  int ExecutorService::NumThreads() const {
+    return numThreads.load();
+  }
+
+  long ExecutorService::NumRejected() const {
+    return numRejected.load();
   }
 
-  void ExecutorService::WorkerThreadFn() {
-    std::function<void ()> fn;
+  std::vector<SlowTask> ExecutorService::SlowTasks() const {
+    std::vector<SlowTask> slow;
+    if (options.slowTaskMillis <= 0) { return slow; }
+
+    long now = SteadyNanos();
+    for (auto& worker : RunningSince(now - options.slowTaskMillis * 1000000L)) {
+      long started = worker->started.load();
+      if (started == 0) { continue; }
+      slow.push_back(SlowTask { worker->name, (now - started) / 1000000L, std::string() });
+    }
+    return slow;
+  }
+
+  long ExecutorService::NumSlowTasks() const {
+    return numSlowTasks.load();
+  }
+
+  void ExecutorService::Enqueue(std::function<void ()>&& fn, std::function<void ()>&& discard) {
+    Task task { std::move(fn), util::Now(), std::move(discard) };
+    if (options.queueCapacity <= 0) {
+      queue.Add(std::move(task));
+    } else if (!queue.TryAdd(std::move(task))) {
+      // the new worker gets the task itself. Through the queue, others would beat it to the 
+      //  free slot, or it would have none yet when the task is retried.
+      if (IsElastic() && Grow(&task)) { return; }
+      if (!queue.TryAdd(std::move(task))) {
+        Reject(std::move(task));
+        return;
+      }
+    }
+    GrowIfBacklogged();
+  }
+
+  void ExecutorService::EnqueueAccepted(std::function<void ()>&& fn) {
+    queue.ForceAdd(Task { std::move(fn), util::Now(), nullptr, true });
+    GrowIfBacklogged();
+  }
+
+  void ExecutorService::GrowIfBacklogged() {
+    if (IsElastic() && options.growQueueDepth > 0 && queue.Size() >= options.growQueueDepth) {
+      Grow();
+    } else if (IsElastic() && options.growWaitMillis > 0 
+        && HeadWaitMillis() > options.growWaitMillis) {
+      // workers only check on dequeue, which may not come for a while if they're all busy.
+      Grow();
+    }
+  }
+
+  long ExecutorService::HeadWaitMillis() {
+    util::instant enqueued;
+    if (!queue.Peek([&enqueued](const Task& head) { enqueued = head.enqueued; })) { return 0; }
+    return util::EllapsedTime(enqueued, util::Now()) / 1000L;
+  }
+
+  void ExecutorService::Reject(Task&& task) {
+    numRejected++;
+    switch (options.rejectionPolicy) {
+      case RejectionPolicy::kCallerRuns:
+        if (!shutdown) {
+          task.fn();
+        } else if (task.discard) {
+          task.discard();
+        }
+        return;
+      case RejectionPolicy::kAbort:
+        throw rejected_exception("Executor queue is full");
+      case RejectionPolicy::kDiscard:
+        if (task.discard) { task.discard(); }
+        return;
+      case RejectionPolicy::kDiscardOldest: {
+        Task oldest;
+        while (!queue.TryAdd(std::move(task))) {
+          if (!queue.TryPoll(oldest)) { continue; }
+          if (oldest.accepted) {
+            // accepted work can't be dropped, so this one goes instead. The oldest only loses
+            //  its place in line.
+            queue.ForceAdd(std::move(oldest));
+            if (task.discard) { task.discard(); }
+            return;
+          }
+          if (oldest.discard) { oldest.discard(); }
+        }
+        return;
+      }
+      case RejectionPolicy::kBlock:
+        if (options.blockTimeoutMillis <= 0) {
+          queue.Add(std::move(task));
+        } else if (!queue.TryAdd(std::move(task), options.blockTimeoutMillis)) {
+          throw rejected_exception("Timed out waiting for room in the executor queue");
+        }
+        return;
+    }
+  }
+
+  bool ExecutorService::IsElastic() const {
+    return options.maxThreads > options.coreThreads;
+  }
+
+  bool ExecutorService::Grow(Task* firstTask) {
+    if (numThreads.load() - numCompensating.load() >= options.maxThreads) { return false; }
+
+    return sync.Synchronized<bool>([this, firstTask]() {
+      if (shutdown || numThreads.load() - numCompensating.load() >= options.maxThreads) { 
+        return false; 
+      }
+
+      ReapRetired();
+      StartThread(firstTask ? std::move(*firstTask) : Task());
+      return true;
+    });
+  }
+
+  void ExecutorService::StartThread(Task&& firstTask) {
+    // must be synchronized
+    numThreads++;
+    numRunning++;
+    threads.push_back(threadFactory.NewThread(
+        &ExecutorService::WorkerThreadFn, this, std::move(firstTask)));
+  }
+
+  bool ExecutorService::TryRetire() {
+    if (TryRetireCompensating()) { return true; }
+
+    int current = numThreads.load();
+    while (current > options.coreThreads + numCompensating.load()) {
+      if (numThreads.compare_exchange_weak(current, current - 1)) { return true; }
+    }
+    return false;
+  }
+
+  bool ExecutorService::TryRetireCompensating() {
+    int current = numCompensating.load();
+    while (current > numBlocked.load()) {
+      if (numCompensating.compare_exchange_weak(current, current - 1)) { 
+        numThreads--;
+        return true; 
+      }
+    }
+    return false;
+  }
+
+  void ExecutorService::Compensator::BeginBlocking() {
+    int blocked = ++executor.numBlocked;
+    // an idle worker started for an earlier blocker is still around.
+    if (executor.shutdown || blocked <= executor.numCompensating.load()) { return; }
+
+    executor.sync.Synchronized<void>([this]() {
+      if (executor.shutdown || executor.numBlocked.load() <= executor.numCompensating.load()
+          || executor.numCompensating.load() >= executor.options.maxCompensationThreads) {
+        return;
+      }
+
+      executor.numCompensating++;
+      executor.ReapRetired();
+      executor.StartThread(Task());
+    });
+  }
+
+  void ExecutorService::Compensator::EndBlocking() {
+    executor.numBlocked--;
+  }
+
+  void ExecutorService::ReapRetired() {
+    // must be synchronized
+    for (auto it = retired.begin(); it != retired.end(); it++) {
+      it->join();
+    }
+    retired.clear();
+  }
+
+  void ExecutorService::WorkerThreadFn(Task firstTask) {
+    Task task = std::move(firstTask);
+    bool retiring = false;
+    std::shared_ptr<Worker> worker = options.slowTaskMillis > 0 ? RegisterWorker() : nullptr;
+    if (options.onWorkerStart) {
+      try {
+        options.onWorkerStart();
+      } catch (...) {}
+    }
 
     while (!shutdown) {
       try {
-        fn = queue.Poll();
+        if (task.fn) {
+          // handed over by Grow.
+        } else if (!IsElastic() && numCompensating.load() == 0) {
+          task = queue.Poll();
+        } else if (!queue.TryPoll(task, options.keepAliveMillis)) {
+          if (TryRetire()) { 
+            retiring = true;
+            break; 
+          }
+          continue;
+        }
       } catch (mdl::concurrent::interrupted_exception& ex) {
         break;
       }
 
+      if (IsElastic() && options.growWaitMillis > 0 && queue.Size() > 0
+          && util::EllapsedTime(task.enqueued, util::Now()) / 1000L > options.growWaitMillis) {
+        Grow();
+      }
+
+      if (worker) { worker->started.store(SteadyNanos()); }
+      if (options.maxCompensationThreads > 0) { _managed_blocker = &compensator; }
       try {
-        fn();
+        task.fn();
       } catch (std::exception& ex) {
         // TODO: What do we do here. Log, once logging supported.
       } catch (...) {}
+      _managed_blocker = nullptr;
+      if (worker) { worker->started.store(0); }
+      task.fn = nullptr;
+
+      // a blocked task resumed, so one worker is now in excess.
+      if (numCompensating.load() > numBlocked.load() && TryRetireCompensating()) {
+        retiring = true;
+        break;
+      }
+    }
+
+    // shut down before the task handed over could run.
+    if (task.fn && task.discard) { task.discard(); }
+
+    if (options.onWorkerExit) {
+      try {
+        options.onWorkerExit();
+      } catch (...) {}
     }
+    if (worker) { UnregisterWorker(worker); }
+    if (!retiring) { numThreads--; }
+
+    sync.Synchronized<void>([this]() {
+      // Threads cannot join themselves. Hand this one over so that whoever is next to start or
+      //  stop a worker joins it.
+      auto self = std::this_thread::get_id();
+      for (auto it = threads.begin(); it != threads.end(); it++) {
+        if (it->get_id() == self) {
+          retired.splice(retired.end(), threads, it);
+          break;
+        }
+      }
+    });
+
+    numRunning--;
+  }
+
+  std::shared_ptr<ExecutorService::Worker> ExecutorService::RegisterWorker() {
+    auto worker = std::make_shared<Worker>();
+    worker->name = this_thread::get_name();
+    worker->handle = pthread_self();
+    watchdogSync.Synchronized<void>([this, &worker]() { workers.push_back(worker); });
+    return worker;
+  }
 
-    numStoppedThreads++;
+  void ExecutorService::UnregisterWorker(const std::shared_ptr<Worker>& worker) {
+    watchdogSync.Synchronized<void>([this, &worker]() { workers.remove(worker); });
+    // waits for the watchdog to be done signalling this thread, if it's at it.
+    worker->signalSync.Synchronized<void>([&worker]() { worker->exited = true; });
+  }
+
+  std::vector<std::shared_ptr<ExecutorService::Worker>> ExecutorService::RunningSince(
+      long threshold) const {
+    return watchdogSync.Synchronized<std::vector<std::shared_ptr<Worker>>>([this, threshold]() {
+      std::vector<std::shared_ptr<Worker>> running;
+      for (auto& worker : workers) {
+        long started = worker->started.load();
+        if (started != 0 && started <= threshold) { running.push_back(worker); }
+      }
+      return running;
+    });
+  }
+
+  void ExecutorService::WatchdogThreadFn() {
+    long interval = options.watchdogIntervalMillis > 0 
+        ? options.watchdogIntervalMillis 
+        : std::max(1L, options.slowTaskMillis / 4);
+
+    while (!shutdown) {
+      long now = SteadyNanos();
+      for (auto& worker : RunningSince(now - options.slowTaskMillis * 1000000L)) {
+        long started = worker->started.load();
+        // only the watchdog touches reported.
+        if (started == 0 || started == worker->reported) { continue; }
+        worker->reported = started;
+
+        SlowTask task { worker->name, (now - started) / 1000000L, std::string() };
+        if (options.captureStackTraces) {
+          bool exited = worker->signalSync.Synchronized<bool>([&worker, &task]() {
+            if (!worker->exited) { task.stackTrace = CaptureStackTrace(worker->handle); }
+            return worker->exited;
+          });
+          // moved on while we looked, the stack is of something else.
+          if (exited || worker->started.load() != started) { continue; }
+        }
+
+        numSlowTasks++;
+        try {
+          if (options.onSlowTask) { options.onSlowTask(task); }
+        } catch (...) {}
+      }
+
+      watchdogSync.Synchronized<void>([this, interval]() {
+        if (!shutdown) { watchdogSync.Wait(interval); }
+      });
+    }
   }
 
   void ExecutorService::ThreadInterrupterFn() {
     const int delay = 100;
 
-    while (numStoppedThreads.load() < numThreads) {
+    while (numRunning.load() > 0) {
       queue.InterruptAll();
       this_thread::sleep(delay);
     }
@@ -0,0 +1,468 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "../../h/concurrent/fiber.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../../h/concurrent/thread.h"
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+#define _MDL_FIBER_ASM 1
+#else
+#include <ucontext.h>
+#endif
+
+#ifdef _MDL_FIBER_ASM
+// Pushes the callee saved registers, stores the stack pointer in *from, then moves to the stack 
+//  at to, and pops what was pushed there.
+extern "C" void mdl_fiber_switch(void** from, void* to);
+// Where fibers first land, out of mdl_fiber_switch. Calls the entry function with the fiber, 
+//  both handed over in callee saved registers.
+extern "C" void mdl_fiber_start();
+
+#if defined(__x86_64__)
+asm(R"(
+  .text
+  .globl mdl_fiber_switch
+  .hidden mdl_fiber_switch
+  .type mdl_fiber_switch, @function
+mdl_fiber_switch:
+  pushq %rbp
+  pushq %rbx
+  pushq %r12
+  pushq %r13
+  pushq %r14
+  pushq %r15
+  subq $8, %rsp
+  stmxcsr (%rsp)
+  fnstcw 4(%rsp)
+  movq %rsp, (%rdi)
+  movq %rsi, %rsp
+  ldmxcsr (%rsp)
+  fldcw 4(%rsp)
+  addq $8, %rsp
+  popq %r15
+  popq %r14
+  popq %r13
+  popq %r12
+  popq %rbx
+  popq %rbp
+  ret
+  .size mdl_fiber_switch, .-mdl_fiber_switch
+
+  .globl mdl_fiber_start
+  .hidden mdl_fiber_start
+  .type mdl_fiber_start, @function
+mdl_fiber_start:
+  movq %r12, %rdi
+  callq *%r13
+  ud2
+  .size mdl_fiber_start, .-mdl_fiber_start
+)");
+#else
+asm(R"(
+  .text
+  .globl mdl_fiber_switch
+  .hidden mdl_fiber_switch
+  .type mdl_fiber_switch, %function
+mdl_fiber_switch:
+  sub sp, sp, #160
+  stp x19, x20, [sp, #0]
+  stp x21, x22, [sp, #16]
+  stp x23, x24, [sp, #32]
+  stp x25, x26, [sp, #48]
+  stp x27, x28, [sp, #64]
+  stp x29, x30, [sp, #80]
+  stp d8, d9, [sp, #96]
+  stp d10, d11, [sp, #112]
+  stp d12, d13, [sp, #128]
+  stp d14, d15, [sp, #144]
+  mov x2, sp
+  str x2, [x0]
+  mov sp, x1
+  ldp x19, x20, [sp, #0]
+  ldp x21, x22, [sp, #16]
+  ldp x23, x24, [sp, #32]
+  ldp x25, x26, [sp, #48]
+  ldp x27, x28, [sp, #64]
+  ldp x29, x30, [sp, #80]
+  ldp d8, d9, [sp, #96]
+  ldp d10, d11, [sp, #112]
+  ldp d12, d13, [sp, #128]
+  ldp d14, d15, [sp, #144]
+  add sp, sp, #160
+  ret
+  .size mdl_fiber_switch, .-mdl_fiber_switch
+
+  .globl mdl_fiber_start
+  .hidden mdl_fiber_start
+  .type mdl_fiber_start, %function
+mdl_fiber_start:
+  mov x0, x19
+  blr x20
+  brk #0
+  .size mdl_fiber_start, .-mdl_fiber_start
+)");
+#endif
+#endif
+
+namespace mdl {
+namespace concurrent {
+#ifdef _MDL_FIBER_ASM
+  struct _FiberContext {
+    void* sp = nullptr;
+  };
+#else
+  struct _FiberContext {
+    ucontext_t context;
+  };
+#endif
+
+  // What wakers hold on to, so they can outlive the fiber they wake up.
+  struct _FiberParker {
+    enum State { kRunning, kParked, kWoken };
+
+    _Fiber* fiber;
+    std::atomic_int state = kRunning;
+
+    _FiberParker(_Fiber* fiber) : fiber(fiber) {}
+  };
+
+  struct _Fiber {
+    enum Next { kYield, kPark, kDone };
+
+    FiberScheduler* scheduler;
+    std::function<void ()> fn;
+    // Lowest address of the mapping, guard page included.
+    char* stack;
+    // Where the fiber left off.
+    _FiberContext context {};
+    // Where the worker running the fiber left off.
+    _FiberContext worker {};
+    // What the fiber asked for when it last switched out.
+    Next next = kYield;
+    // When a parked fiber wakes up on its own, if ever.
+    std::optional<util::instant> wakeAt;
+    // Blocker of the worker running the fiber.
+    ManagedBlocker* outer = nullptr;
+    std::shared_ptr<_FiberParker> parker;
+
+    _Fiber(FiberScheduler* scheduler, std::function<void ()>&& fn, char* stack) 
+        : scheduler(scheduler), fn(std::move(fn)), stack(stack), 
+          parker(std::make_shared<_FiberParker>(this)) {}
+  };
+
+  namespace {
+    thread_local _Fiber* currentFiber = nullptr;
+
+    // A fiber can move to another thread between two calls, so the address of currentFiber 
+    //  must not be worked out once and reused. Keeping this out of line makes sure of that.
+    [[gnu::noinline]] _Fiber* CurrentFiber() {
+      return currentFiber;
+    }
+
+    std::size_t PageSize() {
+      static std::size_t size = sysconf(_SC_PAGESIZE);
+      return size;
+    }
+
+    void SwitchContext(_FiberContext& from, _FiberContext& to) {
+#ifdef _MDL_FIBER_ASM
+      mdl_fiber_switch(&from.sp, to.sp);
+#else
+      swapcontext(&from.context, &to.context);
+#endif
+    }
+
+    void Suspend(_Fiber* fiber, _Fiber::Next next) {
+      fiber->next = next;
+      SwitchContext(fiber->context, fiber->worker);
+    }
+
+    // Switches out until the fiber is woken up, or wakeAt comes.
+    void Park(_Fiber* fiber, std::optional<util::instant> wakeAt) {
+      fiber->wakeAt = wakeAt;
+      Suspend(fiber, _Fiber::kPark);
+    }
+
+    void FiberEntry(void* arg) {
+      _Fiber* fiber = static_cast<_Fiber*>(arg);
+      try {
+        fiber->fn();
+      } catch (...) {}
+      Suspend(fiber, _Fiber::kDone);
+    }
+
+#ifndef _MDL_FIBER_ASM
+    void UcontextEntry() {
+      FiberEntry(CurrentFiber());
+    }
+#endif
+
+    void MakeContext(_FiberContext& context, char* stack, std::size_t size, _Fiber* fiber) {
+#ifdef _MDL_FIBER_ASM
+      std::uintptr_t top = (reinterpret_cast<std::uintptr_t>(stack) + size) & ~std::uintptr_t(15);
+#if defined(__x86_64__)
+      // what mdl_fiber_switch pops: control words (default mxcsr and x87), r15, r14, r13, r12, 
+      //  rbx, rbp, then the return address. Leaves the stack 16 byte aligned for the call.
+      void** frame = reinterpret_cast<void**>(top - 16 - 8 * sizeof(void*));
+      std::memset(frame, 0, 8 * sizeof(void*));
+      std::uint32_t controls[2] = { 0x1F80, 0x037F };
+      std::memcpy(frame, controls, sizeof(controls));
+      frame[3] = reinterpret_cast<void*>(&FiberEntry);
+      frame[4] = fiber;
+      frame[7] = reinterpret_cast<void*>(&mdl_fiber_start);
+#else
+      // x19 to x30, then d8 to d15.
+      void** frame = reinterpret_cast<void**>(top - 160);
+      std::memset(frame, 0, 160);
+      frame[0] = fiber;
+      frame[1] = reinterpret_cast<void*>(&FiberEntry);
+      frame[11] = reinterpret_cast<void*>(&mdl_fiber_start);
+#endif
+      context.sp = frame;
+#else
+      getcontext(&context.context);
+      context.context.uc_stack.ss_sp = stack;
+      context.context.uc_stack.ss_size = size;
+      context.context.uc_link = nullptr;
+      makecontext(&context.context, &UcontextEntry, 0);
+#endif
+    }
+  }
+
+  FiberScheduler::FiberScheduler(ExecutorService& executor, const FiberOptions& options)
+      : executor(executor), options(options), yielder(*this) {
+    std::size_t page = PageSize();
+    this->options.stackSize = (std::max(this->options.stackSize, page) + page - 1) / page * page;
+    timer = named_thread("fiber-timer", &FiberScheduler::TimerThreadFn, this);
+  }
+
+  FiberScheduler::~FiberScheduler() {
+    sync.Synchronized<void>([this]() {
+      while (numFibers.load() > 0) { sync.Wait(); }
+      stopping = true;
+      sync.NotifyAll();
+    });
+    timer.join();
+
+    for (char* stack : stacks) {
+      munmap(stack, PageSize() + options.stackSize);
+    }
+  }
+
+  void FiberScheduler::Execute(const std::function<void ()>& fn) {
+    Start([fn]() {
+      try {
+        fn();
+      } catch (...) {}
+    });
+  }
+
+  long FiberScheduler::NumFibers() const {
+    return numFibers.load();
+  }
+
+  void FiberScheduler::Start(std::function<void ()>&& fn) {
+    _Fiber* fiber = new _Fiber(this, std::move(fn), AllocateStack());
+    MakeContext(fiber->context, fiber->stack + PageSize(), options.stackSize, fiber);
+    numFibers++;
+    Schedule(fiber);
+  }
+
+  void FiberScheduler::Resume(_Fiber* fiber) {
+    // back here means back on this worker's own stack, so this is still the same thread.
+    _Fiber* previous = currentFiber;
+    ManagedBlocker* outer = _managed_blocker;
+    fiber->outer = outer;
+    currentFiber = fiber;
+    _managed_blocker = &yielder;
+    do {
+      SwitchContext(fiber->worker, fiber->context);
+      // nothing else waiting for this worker, so the fiber may as well go on right here.
+    } while (fiber->next == _Fiber::kYield && executor.queue.Size() <= 0);
+    currentFiber = previous;
+    _managed_blocker = outer;
+
+    // only now is the fiber's stack free for another worker to pick up.
+    switch (fiber->next) {
+      case _Fiber::kYield:
+        Schedule(fiber);
+        return;
+      case _Fiber::kPark: {
+        if (fiber->wakeAt) {
+          sync.Synchronized<void>([this, fiber]() {
+            sleeping.emplace(*fiber->wakeAt, fiber->parker);
+            sync.NotifyAll();
+          });
+        }
+        // a waker may have come in since the fiber last looked, then it must not wait for more.
+        int running = _FiberParker::kRunning;
+        if (!fiber->parker->state.compare_exchange_strong(running, _FiberParker::kParked)) {
+          fiber->parker->state.store(_FiberParker::kRunning);
+          Schedule(fiber);
+        }
+        return;
+      }
+      case _Fiber::kDone:
+        Finish(fiber);
+        return;
+    }
+  }
+
+  void FiberScheduler::Schedule(_Fiber* fiber) {
+    executor.EnqueueAccepted([this, fiber]() { Resume(fiber); });
+  }
+
+  void FiberScheduler::Wake(_FiberParker& parker) {
+    if (parker.state.exchange(_FiberParker::kWoken) == _FiberParker::kParked) {
+      // any other waker coming in before the fiber runs again is answered by that run.
+      parker.state.store(_FiberParker::kRunning);
+      parker.fiber->scheduler->Schedule(parker.fiber);
+    }
+  }
+
+  void FiberScheduler::Finish(_Fiber* fiber) {
+    ReleaseStack(fiber->stack);
+    delete fiber;
+    // the destructor may run as soon as it sees the last fiber gone, so the count drops under
+    //  the same lock as the notification, and nothing in this is touched after that.
+    sync.Synchronized<void>([this]() {
+      if (--numFibers == 0) { sync.NotifyAll(); }
+    });
+  }
+
+  char* FiberScheduler::AllocateStack() {
+    char* stack = sync.Synchronized<char*>([this]() -> char* {
+      if (stacks.empty()) { return nullptr; }
+      char* stack = stacks.back();
+      stacks.pop_back();
+      return stack;
+    });
+    if (stack) { return stack; }
+
+    void* mapping = mmap(nullptr, PageSize() + options.stackSize, PROT_READ | PROT_WRITE, 
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) { throw std::runtime_error("Could not allocate fiber stack"); }
+    // stacks grow down, into the guard page.
+    mprotect(mapping, PageSize(), PROT_NONE);
+    return static_cast<char*>(mapping);
+  }
+
+  void FiberScheduler::ReleaseStack(char* stack) {
+    bool cached = sync.Synchronized<bool>([this, stack]() {
+      if (stacks.size() >= static_cast<std::size_t>(options.cachedStacks)) { return false; }
+      stacks.push_back(stack);
+      return true;
+    });
+    if (!cached) { munmap(stack, PageSize() + options.stackSize); }
+  }
+
+  void FiberScheduler::TimerThreadFn() {
+    std::vector<std::shared_ptr<_FiberParker>> due;
+    auto collect = [this, &due]() {
+      while (!stopping) {
+        util::instant now = util::Now();
+        while (!sleeping.empty() && sleeping.begin()->first <= now) {
+          due.push_back(sleeping.begin()->second);
+          sleeping.erase(sleeping.begin());
+        }
+        if (!due.empty()) { return true; }
+
+        if (sleeping.empty()) {
+          sync.Wait();
+        } else {
+          sync.Wait(std::max(1L, static_cast<long>(std::chrono::ceil<std::chrono::milliseconds>(
+              sleeping.begin()->first - now).count())));
+        }
+      }
+      return false;
+    };
+
+    while (sync.Synchronized<bool>(collect)) {
+      for (auto& parker : due) { Wake(*parker); }
+      due.clear();
+    }
+  }
+
+  void FiberScheduler::Yielder::BeginBlocking() {
+    _Fiber* fiber = CurrentFiber();
+    if (fiber && fiber->outer) { fiber->outer->BeginBlocking(); }
+  }
+
+  void FiberScheduler::Yielder::EndBlocking() {
+    _Fiber* fiber = CurrentFiber();
+    if (fiber && fiber->outer) { fiber->outer->EndBlocking(); }
+  }
+
+  bool FiberScheduler::Yielder::YieldUntil(
+      const std::function<bool (const Waker&)>& ready, long timeoutMillis) {
+    _Fiber* fiber = CurrentFiber();
+    std::optional<util::instant> deadline;
+    if (timeoutMillis >= 0) { deadline = util::Now() + std::chrono::milliseconds(timeoutMillis); }
+
+    std::shared_ptr<_FiberParker> parker = fiber->parker;
+    Waker waker = [parker]() { Wake(*parker); };
+    while (!ready(waker)) {
+      if (deadline && util::Now() >= *deadline) { return false; }
+      Park(fiber, deadline);
+    }
+    return true;
+  }
+
+  namespace this_fiber {
+    bool active() {
+      return CurrentFiber() != nullptr;
+    }
+
+    void yield() {
+      _Fiber* fiber = CurrentFiber();
+      if (fiber) { Suspend(fiber, _Fiber::kYield); }
+    }
+
+    void sleep(long millis) {
+      _Fiber* fiber = CurrentFiber();
+      if (!fiber) {
+        this_thread::sleep(millis);
+        return;
+      }
+      util::instant wakeAt = util::Now() + std::chrono::milliseconds(millis);
+      // wakers left behind by earlier waits may cut the nap short.
+      while (util::Now() < wakeAt) { Park(fiber, wakeAt); }
+    }
+  }
+
+} // concurrent
+} // mdl
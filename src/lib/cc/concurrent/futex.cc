@@ -0,0 +1,101 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../../h/concurrent/futex.h"
+
+#include <chrono>
+#include <climits>
+#include <thread>
+
+#ifdef __linux__
+#include <cerrno>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace mdl {
+namespace concurrent {
+
+#ifdef __linux__
+  static_assert(sizeof(futex_t) == sizeof(uint32_t) && futex_t::is_always_lock_free, 
+      "futex words must be plain 32 bit integers");
+
+  namespace {
+    long Futex(futex_t& word, int op, uint32_t val, const timespec* timeout = nullptr) {
+      return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), op, val, timeout, nullptr, 0);
+    }
+  }
+
+  bool FutexWait(futex_t& word, uint32_t expected, long timeoutMillis) {
+    if (timeoutMillis < 0) {
+      Futex(word, FUTEX_WAIT_PRIVATE, expected);
+      return true;
+    }
+
+    timespec timeout;
+    timeout.tv_sec = timeoutMillis / 1000;
+    timeout.tv_nsec = (timeoutMillis % 1000) * 1000000;
+    return Futex(word, FUTEX_WAIT_PRIVATE, expected, &timeout) == 0 || errno != ETIMEDOUT;
+  }
+
+  void FutexWakeOne(futex_t& word) {
+    Futex(word, FUTEX_WAKE_PRIVATE, 1);
+  }
+
+  void FutexWakeAll(futex_t& word) {
+    Futex(word, FUTEX_WAKE_PRIVATE, INT_MAX);
+  }
+#else
+  bool FutexWait(futex_t& word, uint32_t expected, long timeoutMillis) {
+    if (timeoutMillis < 0) {
+      word.wait(expected);
+      return true;
+    }
+
+    // atomic wait has no timeout, so timed waits poll.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+    while (word.load() == expected) {
+      if (std::chrono::steady_clock::now() >= deadline) { return false; }
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return true;
+  }
+
+  void FutexWakeOne(futex_t& word) {
+    word.notify_one();
+  }
+
+  void FutexWakeAll(futex_t& word) {
+    word.notify_all();
+  }
+#endif
+
+} // concurrent
+} // mdl
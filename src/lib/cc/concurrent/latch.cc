@@ -0,0 +1,97 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../../h/concurrent/latch.h"
+
+#include <stdexcept>
+
+#include "../../h/util/time.h"
+
+namespace mdl {
+namespace concurrent {
+
+  CountDownLatch::CountDownLatch(int count, const WaitPolicy& policy) 
+      : state(count), spinWait(policy) {
+    if (count < 0) {
+      throw std::invalid_argument("CountDownLatch count can't be negative");
+    }
+  }
+
+  void CountDownLatch::CountDown(int n) {
+    if (n < 0) {
+      throw std::invalid_argument("CountDownLatch can't count down a negative amount");
+    }
+
+    uint32_t current = state.load(std::memory_order_relaxed);
+    while (true) {
+      uint32_t count = current & ~kWaiters;
+      if (count == 0) { return; }
+
+      uint32_t next = count > (uint32_t) n ? (count - n) | (current & kWaiters) : 0;
+      if (state.compare_exchange_weak(current, next, std::memory_order_acq_rel)) {
+        if (next == 0 && (current & kWaiters)) {
+          FutexWakeAll(state);
+        }
+        return;
+      }
+    }
+  }
+
+  int CountDownLatch::Count() const {
+    return state.load() & ~kWaiters;
+  }
+
+  void CountDownLatch::Await() {
+    Await(-1);
+  }
+
+  bool CountDownLatch::Await(long timeoutMillis) {
+    auto done = [this]() { return (state.load(std::memory_order_acquire) & ~kWaiters) == 0; };
+    if (done() || (spinWait.Policy().Spins() && spinWait.Await(done))) { return true; }
+
+    util::instant start = util::Now();
+    uint32_t current = state.load(std::memory_order_acquire);
+    while ((current & ~kWaiters) != 0) {
+      if (!(current & kWaiters) 
+          && !state.compare_exchange_weak(current, current | kWaiters, std::memory_order_acquire)) {
+        continue;
+      }
+
+      long remaining = -1;
+      if (timeoutMillis >= 0) {
+        remaining = timeoutMillis - util::EllapsedTime(start, util::Now()) / 1000L;
+        if (remaining <= 0) { return done(); }
+      }
+      FutexWait(state, current | kWaiters, remaining);
+      current = state.load(std::memory_order_acquire);
+    }
+    return true;
+  }
+
+} // concurrent
+} // mdl
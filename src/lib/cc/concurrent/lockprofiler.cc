@@ -0,0 +1,163 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../../h/concurrent/lockprofiler.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace mdl {
+namespace concurrent {
+#ifdef MDL_LOCK_PROFILING
+  namespace {
+    // Guards the list of profiles. Only taken when locks come and go, and when reporting.
+    std::mutex& RegistryMutex() {
+      static std::mutex mutex;
+      return mutex;
+    }
+
+    _LockProfile*& RegistryHead() {
+      static _LockProfile* head = nullptr;
+      return head;
+    }
+  }
+
+  std::vector<LockStats> LockProfiler::Snapshot() {
+    std::vector<LockStats> stats;
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    for (_LockProfile* profile = RegistryHead(); profile; profile = profile->next) {
+      stats.push_back(profile->Stats());
+    }
+    return stats;
+  }
+
+  void LockProfiler::Reset() {
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    for (_LockProfile* profile = RegistryHead(); profile; profile = profile->next) {
+      profile->Reset();
+    }
+  }
+
+  _LockProfile::_LockProfile(const std::string& name) : name(name) {
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    next = RegistryHead();
+    if (next) { next->prev = this; }
+    RegistryHead() = this;
+  }
+
+  _LockProfile::~_LockProfile() {
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    if (prev) {
+      prev->next = next;
+    } else {
+      RegistryHead() = next;
+    }
+    if (next) { next->prev = prev; }
+  }
+
+  void _LockProfile::Release() {
+    holdMicros.fetch_add(MicrosSince(holdStart), std::memory_order_relaxed);
+  }
+
+  void _LockProfile::BeforeWait() {
+    waits.fetch_add(1, std::memory_order_relaxed);
+    Release();
+  }
+
+  void _LockProfile::AfterWait() {
+    holdStart = std::chrono::steady_clock::now();
+  }
+
+  void _LockProfile::OnNotify() {
+    notifies.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  const std::string& _LockProfile::Name() const {
+    return name;
+  }
+
+  LockStats _LockProfile::Stats() const {
+    LockStats stats;
+    stats.name = name;
+    stats.acquisitions = acquisitions.load(std::memory_order_relaxed);
+    stats.contended = contended.load(std::memory_order_relaxed);
+    stats.waitMicros = waitMicros.load(std::memory_order_relaxed);
+    stats.maxWaitMicros = maxWaitMicros.load(std::memory_order_relaxed);
+    stats.holdMicros = holdMicros.load(std::memory_order_relaxed);
+    stats.waits = waits.load(std::memory_order_relaxed);
+    stats.notifies = notifies.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  void _LockProfile::Reset() {
+    for (auto* counter : { &acquisitions, &contended, &waitMicros, &maxWaitMicros, &holdMicros,
+        &waits, &notifies }) {
+      counter->store(0, std::memory_order_relaxed);
+    }
+  }
+
+  long _LockProfile::MicrosSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+  }
+#else
+  std::vector<LockStats> LockProfiler::Snapshot() {
+    return std::vector<LockStats>();
+  }
+
+  void LockProfiler::Reset() {}
+#endif
+
+  std::vector<LockStats> LockProfiler::TopContended(int n) {
+    std::vector<LockStats> stats = Snapshot();
+    std::sort(stats.begin(), stats.end(), [](const LockStats& a, const LockStats& b) {
+      return a.waitMicros != b.waitMicros 
+          ? a.waitMicros > b.waitMicros 
+          : a.contended > b.contended;
+    });
+    if ((int) stats.size() > n) { stats.resize(std::max(n, 0)); }
+    return stats;
+  }
+
+  std::string LockProfiler::Dump(int n) {
+    std::ostringstream out;
+    for (const LockStats& stats : TopContended(n)) {
+      out << (stats.name.empty() ? "<unnamed>" : stats.name)
+          << ": acquisitions=" << stats.acquisitions
+          << " contended=" << stats.contended
+          << " waitMicros=" << stats.waitMicros
+          << " maxWaitMicros=" << stats.maxWaitMicros
+          << " holdMicros=" << stats.holdMicros
+          << " waits=" << stats.waits
+          << " notifies=" << stats.notifies << std::endl;
+    }
+    return out.str();
+  }
+
+} // concurrent
+} // mdl
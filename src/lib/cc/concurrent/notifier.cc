@@ -0,0 +1,130 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "../../h/concurrent/notifier.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+namespace mdl {
+namespace concurrent {
+
+  EventNotifier::EventNotifier() {
+#ifdef __linux__
+    readFd = writeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    bool created = readFd >= 0;
+#else
+    int fds[2];
+    bool created = pipe(fds) == 0;
+    if (created) {
+      readFd = fds[0];
+      writeFd = fds[1];
+      for (int fd : fds) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+      }
+    }
+#endif
+    if (!created) {
+      throw std::runtime_error(std::string("Could not create notifier: ") + std::strerror(errno));
+    }
+  }
+
+  EventNotifier::~EventNotifier() {
+    close(readFd);
+    if (writeFd != readFd) { close(writeFd); }
+  }
+
+  int EventNotifier::Fd() const {
+    return readFd;
+  }
+
+  void EventNotifier::Signal() {
+    // a full pipe, or a maxed out eventfd, is as signalled as it gets: EAGAIN is fine.
+#ifdef __linux__
+    std::uint64_t one = 1;
+    while (write(writeFd, &one, sizeof(one)) < 0 && errno == EINTR) {}
+#else
+    char one = 1;
+    while (write(writeFd, &one, sizeof(one)) < 0 && errno == EINTR) {}
+#endif
+  }
+
+  void EventNotifier::Reset() {
+#ifdef __linux__
+    std::uint64_t count;
+    while (read(readFd, &count, sizeof(count)) < 0 && errno == EINTR) {}
+#else
+    char buffer[64];
+    while (true) {
+      long count = read(readFd, buffer, sizeof(buffer));
+      if (count <= 0 && !(count < 0 && errno == EINTR)) { break; }
+    }
+#endif
+  }
+
+  int EventNotifier::WaitAny(EventNotifier* const* notifiers, int count, long timeoutMillis) {
+    std::vector<pollfd> fds(count);
+    for (int i = 0; i < count; i++) {
+      fds[i].fd = notifiers[i]->Fd();
+      fds[i].events = POLLIN;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+    while (true) {
+      long remaining = -1;
+      if (timeoutMillis >= 0) {
+        remaining = std::max(0L, static_cast<long>(std::chrono::ceil<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count()));
+      }
+
+      int ready = poll(fds.data(), count, static_cast<int>(remaining));
+      if (ready < 0 && errno == EINTR) { continue; }
+      if (ready <= 0) { return -1; }
+
+      for (int i = 0; i < count; i++) {
+        if (fds[i].revents) { return i; }
+      }
+    }
+  }
+
+} // concurrent
+} // mdl
@@ -0,0 +1,206 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../../h/concurrent/partitionedexecutor.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "../../h/util/hash.h"
+
+namespace mdl {
+namespace concurrent {
+  namespace {
+    PartitionedExecutorOptions WithPartitions(int partitions) {
+      PartitionedExecutorOptions options;
+      options.partitions = partitions;
+      return options;
+    }
+  }
+
+  PartitionedExecutor::PartitionedExecutor(int partitions, ThreadFactory& threadFactory) 
+      : PartitionedExecutor(WithPartitions(partitions), threadFactory) {}
+
+  PartitionedExecutor::PartitionedExecutor(
+      const PartitionedExecutorOptions& options, ThreadFactory& threadFactory) 
+      : options(options), lastRebalance(util::Now()) {
+    if (options.partitions < 1 || options.bucketsPerPartition < 1) {
+      throw std::invalid_argument("PartitionedExecutor needs at least one partition and bucket");
+    }
+
+    numBuckets = options.partitions * options.bucketsPerPartition;
+    buckets.reset(new Bucket[numBuckets]);
+    for (int i = 0; i < numBuckets; i++) {
+      buckets[i].partition = i % options.partitions;
+    }
+
+    for (int i = 0; i < options.partitions; i++) {
+      partitions.push_back(std::make_unique<Partition>(options.waitPolicy));
+    }
+    for (auto& partition : partitions) {
+      numRunning++;
+      partition->thread = threadFactory.NewThread(
+          &PartitionedExecutor::WorkerThreadFn, this, partition.get());
+    }
+  }
+
+  PartitionedExecutor::~PartitionedExecutor() {
+    Shutdown();
+  }
+
+  int PartitionedExecutor::Rebalance() {
+    lastRebalance = util::Now();
+
+    return routing.SynchronizedWrite<int>([this]() {
+      int n = options.partitions;
+      std::vector<long> load(n, 0);
+      std::vector<long> recent(numBuckets);
+      long total = 0;
+      for (int i = 0; i < numBuckets; i++) {
+        // decays, so a key that went quiet stops counting after a few rounds.
+        recent[i] = buckets[i].recent.load();
+        buckets[i].recent -= recent[i] / 2;
+        load[buckets[i].partition.load()] += recent[i];
+        total += recent[i];
+      }
+      if (total == 0) { return 0; }
+
+      double hot = options.hotRatio * total / n;
+      int moved = 0;
+      while (true) {
+        int hottest = std::max_element(load.begin(), load.end()) - load.begin();
+        int coldest = std::min_element(load.begin(), load.end()) - load.begin();
+        if (load[hottest] <= hot) { break; }
+
+        // The busiest bucket that can move, and that leaves the cold partition cooler than 
+        //  the hot one was. Moving anything else would only shift the problem around.
+        int candidate = -1;
+        for (int i = 0; i < numBuckets; i++) {
+          Bucket& bucket = buckets[i];
+          if (bucket.partition.load() != hottest || recent[i] == 0 || bucket.pending.load() > 0 
+              || load[coldest] + recent[i] >= load[hottest]) {
+            continue;
+          }
+          if (candidate < 0 || recent[i] > recent[candidate]) { candidate = i; }
+        }
+        if (candidate < 0) { break; }
+
+        // Nothing of this bucket is queued or running, and no new task can be routed while
+        //  the write lock is held: the next one goes to the new partition, after everything 
+        //  done by the old one.
+        buckets[candidate].partition = coldest;
+        load[hottest] -= recent[candidate];
+        load[coldest] += recent[candidate];
+        moved++;
+      }
+      return moved;
+    });
+  }
+
+  std::vector<PartitionStats> PartitionedExecutor::Stats() const {
+    std::vector<PartitionStats> stats(options.partitions);
+    for (int i = 0; i < options.partitions; i++) {
+      Partition& partition = *partitions[i];
+      stats[i].queued = std::max(0L, (long) partition.queue.Size());
+      stats[i].executed = partition.executed.load();
+      stats[i].busyMicros = partition.busyMicros.load();
+      stats[i].waitMicros = partition.waitMicros.load();
+    }
+    for (int i = 0; i < numBuckets; i++) {
+      stats[buckets[i].partition.load()].buckets++;
+    }
+    return stats;
+  }
+
+  void PartitionedExecutor::Shutdown() {
+    if (shutdown.exchange(true)) { return; }
+
+    // Workers check for shutdown between tasks, and get interrupted out of an empty queue.
+    while (numRunning.load() > 0) {
+      for (auto& partition : partitions) {
+        partition->queue.InterruptAll();
+      }
+      this_thread::sleep(10);
+    }
+
+    for (auto& partition : partitions) {
+      partition->thread.join();
+    }
+  }
+
+  int PartitionedExecutor::NumPartitions() const {
+    return options.partitions;
+  }
+
+  int PartitionedExecutor::BucketOf(std::size_t hash) const {
+    // std::hash is the identity for integers, mix it so consecutive keys spread out.
+    return static_cast<int>(util::MixHash(hash) % numBuckets);
+  }
+
+  void PartitionedExecutor::Enqueue(int bucket, std::function<void ()>&& fn) {
+    routing.SynchronizedRead<void>([this, bucket, &fn]() {
+      Bucket& target = buckets[bucket];
+      target.pending++;
+      target.recent++;
+      partitions[target.partition.load()]->queue.Add(Task { std::move(fn), util::Now(), bucket });
+    });
+
+    if (options.rebalanceMillis > 0) {
+      util::instant last = lastRebalance.load(std::memory_order_relaxed);
+      util::instant now = util::Now();
+      if (util::EllapsedTime(last, now) / 1000L >= options.rebalanceMillis 
+          && lastRebalance.compare_exchange_strong(last, now)) {
+        Rebalance();
+      }
+    }
+  }
+
+  void PartitionedExecutor::WorkerThreadFn(Partition* partition) {
+    Task task;
+
+    while (!shutdown) {
+      try {
+        task = partition->queue.Poll();
+      } catch (mdl::concurrent::interrupted_exception& ex) {
+        break;
+      }
+
+      util::instant start = util::Now();
+      partition->waitMicros += util::EllapsedTime(task.enqueued, start);
+      task.fn();
+      task.fn = nullptr;
+      partition->busyMicros += util::EllapsedTime(start, util::Now());
+      partition->executed++;
+      buckets[task.bucket].pending--;
+    }
+
+    numRunning--;
+  }
+
+} // concurrent
+} // mdl
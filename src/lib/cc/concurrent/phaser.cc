@@ -0,0 +1,188 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../../h/concurrent/phaser.h"
+
+#include <climits>
+#include <exception>
+#include <stdexcept>
+
+#include "../../h/util/time.h"
+
+namespace mdl {
+namespace concurrent {
+
+  namespace {
+    constexpr uint64_t kMaxParties = 0xffff;
+    constexpr uint64_t kUnarrived = 1;
+    constexpr uint64_t kParty = uint64_t(1) << 16;
+    // Phases never use the top bit. Set while the last party left and the phase is ending, as
+    //  with no parties the counts can't tell.
+    constexpr uint64_t kEmptyEnding = uint64_t(1) << 63;
+
+    int PhaseOf(uint64_t state) { return static_cast<int>((state >> 32) & INT_MAX); }
+    int PartiesOf(uint64_t state) { return static_cast<int>((state >> 16) & kMaxParties); }
+    int UnarrivedOf(uint64_t state) { return static_cast<int>(state & kMaxParties); }
+
+    uint64_t Pack(int phase, int parties, int unarrived) {
+      return (uint64_t(phase) << 32) | (uint64_t(parties) << 16) | uint64_t(unarrived);
+    }
+
+    bool Ending(uint64_t state) {
+      return (UnarrivedOf(state) == 0 && PartiesOf(state) > 0) || (state & kEmptyEnding);
+    }
+  }
+
+  Phaser::Phaser(int parties, std::function<void (int)> onAdvance, const WaitPolicy& policy) 
+      : state(Pack(0, parties, parties)), onAdvance(onAdvance), spinWait(policy) {
+    if (parties < 0 || (uint64_t) parties > kMaxParties) {
+      throw std::invalid_argument("Phaser parties out of range");
+    }
+  }
+
+  int Phaser::Register(int parties) {
+    uint64_t current = state.load();
+    while (true) {
+      if (Ending(current)) {
+        AwaitAdvance(PhaseOf(current));
+        current = state.load();
+        continue;
+      }
+      if (parties < 0 || PartiesOf(current) + (uint64_t) parties > kMaxParties) {
+        throw std::invalid_argument("Phaser parties out of range");
+      }
+      if (state.compare_exchange_weak(current, current + parties * (kParty + kUnarrived))) {
+        return PhaseOf(current);
+      }
+    }
+  }
+
+  int Phaser::Arrive() {
+    return DoArrive(false);
+  }
+
+  int Phaser::ArriveAndDeregister() {
+    return DoArrive(true);
+  }
+
+  int Phaser::ArriveAndAwaitAdvance() {
+    int phase = DoArrive(false);
+    AwaitAdvance(phase, -1);
+    return (phase + 1) & INT_MAX;
+  }
+
+  int Phaser::AwaitAdvance(int phase) {
+    AwaitAdvance(phase, -1);
+    return Phase();
+  }
+
+  bool Phaser::AwaitAdvance(int phase, long timeoutMillis) {
+    auto advanced = [this, phase]() { return PhaseOf(state.load()) != phase; };
+    if (advanced() || (spinWait.Policy().Spins() && spinWait.Await(advanced))) { return true; }
+
+    util::instant start = util::Now();
+    bool result = true;
+    waiters++;
+    while (true) {
+      // Read before checking the phase: if it ends after the check, this no longer matches.
+      uint32_t seen = advances.load();
+      if (advanced()) { break; }
+
+      long remaining = -1;
+      if (timeoutMillis >= 0) {
+        remaining = timeoutMillis - util::EllapsedTime(start, util::Now()) / 1000L;
+        if (remaining <= 0) {
+          result = advanced();
+          break;
+        }
+      }
+      FutexWait(advances, seen, remaining);
+    }
+    waiters--;
+    return result;
+  }
+
+  int Phaser::Phase() const {
+    return PhaseOf(state.load());
+  }
+
+  int Phaser::RegisteredParties() const {
+    return PartiesOf(state.load());
+  }
+
+  int Phaser::UnarrivedParties() const {
+    return UnarrivedOf(state.load());
+  }
+
+  int Phaser::DoArrive(bool deregister) {
+    uint64_t current = state.load();
+    while (true) {
+      if (Ending(current)) {
+        AwaitAdvance(PhaseOf(current));
+        current = state.load();
+        continue;
+      }
+      if (PartiesOf(current) == 0) {
+        throw std::logic_error("Phaser has no registered parties");
+      }
+
+      uint64_t next = current - kUnarrived - (deregister ? kParty : 0);
+      if (PartiesOf(next) == 0) { next |= kEmptyEnding; }
+      if (state.compare_exchange_weak(current, next)) {
+        if (UnarrivedOf(current) == 1) { Advance(next); }
+        return PhaseOf(current);
+      }
+    }
+  }
+
+  // Only the last party to arrive gets here, and until it's done everyone else trying to 
+  //  change the state waits.
+  void Phaser::Advance(uint64_t ending) {
+    int phase = PhaseOf(ending);
+    int parties = PartiesOf(ending);
+
+    std::exception_ptr error;
+    if (onAdvance) {
+      try {
+        onAdvance(phase);
+      } catch (...) {
+        error = std::current_exception();
+      }
+    }
+
+    state.store(Pack((phase + 1) & INT_MAX, parties, parties));
+    advances.fetch_add(1);
+    if (waiters.load() > 0) {
+      FutexWakeAll(advances);
+    }
+
+    if (error) { std::rethrow_exception(error); }
+  }
+
+} // concurrent
+} // mdl
@@ -0,0 +1,129 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../../h/concurrent/pipeline.h"
+
+#include <chrono>
+#include <exception>
+
+namespace mdl {
+namespace concurrent {
+
+  _PipelineContext::_PipelineContext() : started(util::Now()) {}
+
+  CancellationToken _PipelineContext::Token() const {
+    return source.Token();
+  }
+
+  void _PipelineContext::Start() {
+    started = util::Now();
+  }
+
+  util::instant _PipelineContext::Started() const {
+    return started;
+  }
+
+  void _PipelineContext::Fail(const std::string& msg, int errorCode) {
+    sync.Synchronized<void>([this, &msg, errorCode]() {
+      if (source.IsCancellationRequested()) { return; }
+      errorMsg = msg;
+      this->errorCode = errorCode;
+      source.Cancel();
+    });
+  }
+
+  void _PipelineContext::FailWithCurrentException(const std::string& stage) {
+    std::pair<std::string, int> error = _CurrentError();
+    Fail(error.first.empty() ? "Stage " + stage + " failed" : "Stage " + stage + ": " + error.first,
+        error.second);
+  }
+
+  void _PipelineContext::ThrowFailure() {
+    std::pair<std::string, int> failure = 
+        sync.Synchronized<std::pair<std::string, int>>([this]() {
+          return std::make_pair(errorMsg, errorCode);
+        });
+    throw execution_exception(failure.first, failure.second);
+  }
+
+  _PipelineStage::_PipelineStage(const std::string& name, int parallelism, 
+      const std::shared_ptr<_PipelineContext>& context) 
+      : context(context), token(context->Token()), name(name), parallelism(parallelism) {}
+
+  _PipelineStage::~_PipelineStage() {
+    Join();
+  }
+
+  void _PipelineStage::Start(ThreadFactory& threadFactory) {
+    for (int i = 0; i < parallelism; i++) {
+      threads.push_back(threadFactory.NewThread(&_PipelineStage::WorkerThreadFn, this));
+    }
+  }
+
+  void _PipelineStage::Join() {
+    for (auto& thread : threads) {
+      if (thread.joinable()) { thread.join(); }
+    }
+  }
+
+  StageStats _PipelineStage::Stats() const {
+    StageStats stats;
+    stats.name = name;
+    stats.parallelism = parallelism;
+    stats.processed = processed.load();
+    stats.queued = Queued();
+    stats.busyMicros = busyMicros.load();
+    stats.idleMicros = idleMicros.load();
+    stats.blockedMicros = blockedMicros.load();
+
+    long elapsed = util::EllapsedTime(context->Started(), util::Now());
+    stats.throughput = elapsed > 0 ? stats.processed * 1e6 / elapsed : 0;
+    return stats;
+  }
+
+  long _PipelineStage::Since(util::instant& start) {
+    util::instant now = util::Now();
+    long elapsed = util::EllapsedTime(start, now);
+    start = now;
+    return elapsed;
+  }
+
+  void _PipelineStage::WorkerThreadFn() {
+    try {
+      Run();
+    } catch (const interrupted_exception& ex) {
+      // Stopped because some other stage failed. Unless nothing did, and it came from the stage
+      //  function itself.
+      if (!token.IsCancellationRequested()) { context->FailWithCurrentException(name); }
+    } catch (...) {
+      context->FailWithCurrentException(name);
+    }
+  }
+
+} // concurrent
+} // mdl
@@ -0,0 +1,106 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../../h/concurrent/ratelimiter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+namespace mdl {
+namespace concurrent {
+
+  RateLimiter::RateLimiter(double permitsPerSecond, long burst) 
+      : origin(util::Now()), burst(burst), interval(Interval(permitsPerSecond)), due(0) {
+    if (burst < 1) {
+      throw std::invalid_argument("RateLimiter burst must be at least 1");
+    }
+  }
+
+  long RateLimiter::Acquire(long permits) {
+    int64_t wait = Reserve(permits, INT64_MAX);
+    if (wait > 0) {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+    }
+    return wait / 1000;
+  }
+
+  bool RateLimiter::TryAcquire(long permits, long timeoutMillis) {
+    int64_t wait = Reserve(permits, std::max(timeoutMillis, 0L) * 1000000);
+    if (wait < 0) { return false; }
+    if (wait > 0) {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+    }
+    return true;
+  }
+
+  void RateLimiter::SetRate(double permitsPerSecond) {
+    interval = Interval(permitsPerSecond);
+  }
+
+  double RateLimiter::Rate() const {
+    return 1e9 / interval.load();
+  }
+
+  long RateLimiter::Burst() const {
+    return burst;
+  }
+
+  int64_t RateLimiter::Elapsed() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(util::Now() - origin).count();
+  }
+
+  int64_t RateLimiter::Reserve(long permits, int64_t maxWait) {
+    if (permits < 0) {
+      throw std::invalid_argument("Can't acquire a negative number of permits");
+    }
+
+    int64_t step = interval.load(std::memory_order_relaxed);
+    int64_t now = Elapsed();
+    int64_t current = due.load(std::memory_order_relaxed);
+    while (true) {
+      // A bucket that's been idle for a while is full, not holding permits from the past.
+      int64_t next = std::max(current, now) + permits * step;
+      int64_t wait = next - burst * step - now;
+      if (wait > maxWait) { return -1; }
+      if (due.compare_exchange_weak(current, next, std::memory_order_relaxed)) {
+        return std::max<int64_t>(wait, 0);
+      }
+    }
+  }
+
+  int64_t RateLimiter::Interval(double permitsPerSecond) {
+    if (!(permitsPerSecond > 0)) {
+      throw std::invalid_argument("RateLimiter rate must be positive");
+    }
+    return std::max<int64_t>(1, static_cast<int64_t>(1e9 / permitsPerSecond));
+  }
+
+} // concurrent
+} // mdl
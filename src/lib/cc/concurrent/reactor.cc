@@ -0,0 +1,366 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "../../h/concurrent/reactor.h"
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "../../h/concurrent/thread.h"
+
+namespace mdl {
+namespace concurrent {
+  namespace {
+    const int kMaxEvents = 64;
+
+    void ThrowSystemError(const std::string& what) {
+      throw std::runtime_error(what + ": " + std::strerror(errno));
+    }
+
+    std::uint32_t ToEpoll(int events) {
+      std::uint32_t epoll = EPOLLRDHUP;
+      if (events & kReadable) { epoll |= EPOLLIN; }
+      if (events & kWritable) { epoll |= EPOLLOUT; }
+      return epoll;
+    }
+
+    int FromEpoll(std::uint32_t epoll) {
+      int events = 0;
+      if (epoll & EPOLLIN) { events |= kReadable; }
+      if (epoll & EPOLLOUT) { events |= kWritable; }
+      if (epoll & (EPOLLHUP | EPOLLRDHUP)) { events |= kHangup; }
+      if (epoll & EPOLLERR) { events |= kError; }
+      return events;
+    }
+
+    void Drain(int fd) {
+      std::uint64_t count;
+      while (read(fd, &count, sizeof(count)) < 0 && errno == EINTR) {}
+    }
+  }
+
+  Reactor::Reactor(const std::string& name) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0 || timerFd < 0) {
+      int error = errno;
+      for (int fd : { epollFd, wakeFd, timerFd }) {
+        if (fd >= 0) { close(fd); }
+      }
+      errno = error;
+      ThrowSystemError("Could not create reactor");
+    }
+
+    for (int fd : { wakeFd, timerFd }) {
+      epoll_event event {};
+      event.events = EPOLLIN;
+      event.data.fd = fd;
+      epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    loop = named_thread(name, &Reactor::LoopFn, this);
+  }
+
+  Reactor::~Reactor() {
+    // the loop would be left running on a destroyed reactor, or join itself.
+    if (InLoop()) { std::terminate(); }
+    Stop();
+
+    // drops cancellation registrations, while the fds they refer to are still known.
+    std::unordered_map<int, std::shared_ptr<Handler>> remaining;
+    sync.Synchronized<void>([this, &remaining]() { remaining.swap(handlers); });
+    remaining.clear();
+
+    close(timerFd);
+    close(wakeFd);
+    close(epollFd);
+  }
+
+  void Reactor::Add(int fd, int events, IoCallback&& fn) {
+    AddHandler(++nextId, fd, events, std::move(fn));
+  }
+
+  void Reactor::Modify(int fd, int events) {
+    epoll_event event {};
+    event.events = ToEpoll(events);
+    event.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) < 0) {
+      ThrowSystemError("Could not modify fd " + std::to_string(fd));
+    }
+  }
+
+  bool Reactor::Remove(int fd) {
+    return RemoveHandler(fd, 0);
+  }
+
+  long Reactor::Schedule(long delayMillis, std::function<void ()>&& fn, long periodMillis) {
+    long id = ++nextId;
+    util::instant deadline = util::Now() + std::chrono::milliseconds(std::max(0L, delayMillis));
+    auto shared = std::make_shared<std::function<void ()>>(std::move(fn));
+
+    sync.Synchronized<void>([this, id, deadline, periodMillis, &shared]() {
+      bool earliest = timers.empty() || deadline < timers.begin()->first.first;
+      timers.emplace(std::make_pair(deadline, id), Timer { periodMillis, std::move(shared) });
+      deadlines.emplace(id, deadline);
+      if (earliest) { ArmTimer(); }
+    });
+    return id;
+  }
+
+  bool Reactor::Cancel(long timerId) {
+    return sync.Synchronized<bool>([this, timerId]() {
+      auto it = deadlines.find(timerId);
+      if (it == deadlines.end()) { return false; }
+
+      // the timer fd may go off for nothing now, which is harmless.
+      timers.erase(std::make_pair(it->second, timerId));
+      deadlines.erase(it);
+      return true;
+    });
+  }
+
+  void Reactor::Post(std::function<void ()>&& fn) {
+    bool wake = sync.Synchronized<bool>([this, &fn]() {
+      posted.push_back(std::move(fn));
+      // the loop is woken up already otherwise.
+      return posted.size() == 1;
+    });
+    if (wake) { Wake(); }
+  }
+
+  bool Reactor::InLoop() const {
+    return std::this_thread::get_id() == loop.get_id();
+  }
+
+  void Reactor::Stop() {
+    stopping = true;
+    Wake();
+    if (InLoop()) { return; }
+
+    std::call_once(joined, [this]() { 
+      if (loop.joinable()) { loop.join(); }
+    });
+  }
+
+  long Reactor::NumFailedCallbacks() const {
+    return numFailedCallbacks.load();
+  }
+
+  Future<int> Reactor::WhenReady(int fd, int events) {
+    Promise<int> promise;
+    Future<int> future = promise.GetFuture();
+    Watch(fd, events, [promise](int ready) mutable { promise.Set(ready); }, promise.Token());
+    return future;
+  }
+
+  Future<void> Reactor::After(long delayMillis) {
+    Promise<void> promise;
+    Future<void> future = promise.GetFuture();
+    Schedule(delayMillis, [promise]() mutable { promise.Set(); });
+    return future;
+  }
+
+  std::shared_ptr<Reactor::Handler> Reactor::AddHandler(
+      long id, int fd, int events, IoCallback&& fn) {
+    auto handler = std::make_shared<Handler>();
+    handler->id = id;
+    handler->fd = fd;
+    handler->fn = std::move(fn);
+
+    sync.Synchronized<void>([this, fd, events, &handler]() {
+      if (handlers.count(fd)) { 
+        throw std::runtime_error("fd " + std::to_string(fd) + " is already registered"); 
+      }
+
+      epoll_event event {};
+      event.events = ToEpoll(events);
+      event.data.fd = fd;
+      if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        ThrowSystemError("Could not add fd " + std::to_string(fd));
+      }
+      handlers.emplace(fd, handler);
+    });
+    return handler;
+  }
+
+  bool Reactor::RemoveHandler(int fd, long id) {
+    std::shared_ptr<Handler> removed;
+    sync.Synchronized<void>([this, fd, id, &removed]() {
+      auto it = handlers.find(fd);
+      if (it == handlers.end() || (id > 0 && it->second->id != id)) { return; }
+
+      removed = std::move(it->second);
+      handlers.erase(it);
+      epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+
+      if (InLoop()) { return; }
+      while (running == removed) { sync.Wait(); }
+    });
+    // dropped out here, as it may unregister from a cancellation that is firing.
+    return removed != nullptr;
+  }
+
+  void Reactor::Watch(int fd, int events, IoCallback&& complete, const CancellationToken& token) {
+    long id = ++nextId;
+    auto handler = AddHandler(id, fd, events, [this, fd, id, complete](int ready) mutable {
+      RemoveHandler(fd, id);
+      complete(ready);
+    });
+    handler->cancellation = token.Register([this, fd, id]() { RemoveHandler(fd, id); });
+  }
+
+  void Reactor::Wake() {
+    std::uint64_t one = 1;
+    while (write(wakeFd, &one, sizeof(one)) < 0 && errno == EINTR) {}
+  }
+
+  void Reactor::ArmTimer() {
+    // must be synchronized
+    itimerspec spec {};
+    if (!timers.empty()) {
+      long nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          timers.begin()->first.first.time_since_epoch()).count();
+      // an all zero value would disarm it instead.
+      nanos = std::max(1L, nanos);
+      spec.it_value.tv_sec = nanos / 1000000000L;
+      spec.it_value.tv_nsec = nanos % 1000000000L;
+    }
+    // steady_clock is CLOCK_MONOTONIC on Linux.
+    timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+  }
+
+  void Reactor::LoopFn() {
+    epoll_event events[kMaxEvents];
+
+    while (!stopping) {
+      int count = epoll_wait(epollFd, events, kMaxEvents, -1);
+      if (count < 0) {
+        if (errno == EINTR) { continue; }
+        break;
+      }
+
+      for (int i = 0; i < count && !stopping; i++) {
+        int fd = events[i].data.fd;
+        if (fd == wakeFd) {
+          Drain(wakeFd);
+          RunPosted();
+        } else if (fd == timerFd) {
+          Drain(timerFd);
+          RunTimers();
+        } else {
+          Dispatch(fd, events[i].events);
+        }
+      }
+    }
+  }
+
+  void Reactor::Dispatch(int fd, std::uint32_t events) {
+    std::shared_ptr<Handler> handler = sync.Synchronized<std::shared_ptr<Handler>>([this, fd]() {
+      auto it = handlers.find(fd);
+      if (it == handlers.end()) { return std::shared_ptr<Handler>(); }
+      running = it->second;
+      return it->second;
+    });
+    // removed after epoll_wait returned.
+    if (!handler) { return; }
+
+    int ready = FromEpoll(events);
+    RunCallback([&handler, ready]() { handler->fn(ready); });
+
+    sync.Synchronized<void>([this]() {
+      running = nullptr;
+      sync.NotifyAll();
+    });
+  }
+
+  void Reactor::RunCallback(const std::function<void ()>& fn) {
+    try {
+      fn();
+    } catch (...) {
+      numFailedCallbacks++;
+    }
+  }
+
+  void Reactor::RunPosted() {
+    std::deque<std::function<void ()>> batch;
+    sync.Synchronized<void>([this, &batch]() { batch.swap(posted); });
+
+    for (auto& fn : batch) {
+      if (stopping) { return; }
+      RunCallback(fn);
+    }
+  }
+
+  void Reactor::RunTimers() {
+    std::vector<std::shared_ptr<std::function<void ()>>> due;
+
+    sync.Synchronized<void>([this, &due]() {
+      util::instant now = util::Now();
+      while (!timers.empty() && timers.begin()->first.first <= now) {
+        auto node = timers.extract(timers.begin());
+        long id = node.key().second;
+        Timer& timer = node.mapped();
+        due.push_back(timer.fn);
+
+        if (timer.periodMillis <= 0) {
+          deadlines.erase(id);
+          continue;
+        }
+
+        // periodic timers that fell behind skip the runs they missed.
+        util::instant next = node.key().first + std::chrono::milliseconds(timer.periodMillis);
+        if (next <= now) { next = now + std::chrono::milliseconds(timer.periodMillis); }
+        node.key() = std::make_pair(next, id);
+        deadlines[id] = next;
+        timers.insert(std::move(node));
+      }
+      ArmTimer();
+    });
+
+    for (auto& fn : due) {
+      if (stopping) { return; }
+      RunCallback(*fn);
+    }
+  }
+
+} // concurrent
+} // mdl
+
+#endif // __linux__
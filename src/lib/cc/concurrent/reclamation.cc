@@ -0,0 +1,328 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../../h/concurrent/reclamation.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace mdl {
+namespace concurrent {
+  namespace {
+    // Records this thread claimed, given back when it exits.
+    struct ThreadRecords {
+      struct Entry {
+        long registryId;
+        std::weak_ptr<_ReclaimRegistry> registry;
+        _ReclaimRecord* record;
+      };
+
+      std::vector<Entry> records;
+      // Threads mostly stick to one domain, whose record is then found without a search.
+      long lastId = 0;
+      _ReclaimRecord* last = nullptr;
+
+      ~ThreadRecords() {
+        for (Entry& entry : records) {
+          if (std::shared_ptr<_ReclaimRegistry> registry = entry.registry.lock()) {
+            registry->Release(entry.record);
+          }
+        }
+      }
+    };
+
+    thread_local ThreadRecords threadRecords;
+    std::atomic_long registrySeq = 0;
+
+    void Free(std::vector<_Retired>& retired) {
+      for (_Retired& r : retired) { r.deleter(r.ptr); }
+      retired.clear();
+    }
+  }
+
+  _ReclaimRegistry::_ReclaimRegistry(std::function<_ReclaimRecord* ()>&& newRecord) 
+      : id(++registrySeq), newRecord(std::move(newRecord)) {}
+
+  _ReclaimRegistry::~_ReclaimRegistry() {
+    FreeAll();
+    _ReclaimRecord* record = head.load();
+    while (record) {
+      _ReclaimRecord* next = record->next;
+      delete record;
+      record = next;
+    }
+  }
+
+  _ReclaimRecord& _ReclaimRegistry::Local() {
+    ThreadRecords& local = threadRecords;
+    if (local.lastId == id) { return *local.last; }
+
+    // Registries that are gone took their records with them.
+    std::vector<ThreadRecords::Entry>& records = local.records;
+    records.erase(std::remove_if(records.begin(), records.end(), 
+        [](const ThreadRecords::Entry& entry) { return entry.registry.expired(); }), 
+        records.end());
+
+    _ReclaimRecord* record = nullptr;
+    for (ThreadRecords::Entry& entry : records) {
+      if (entry.registryId == id) { 
+        record = entry.record;
+        break;
+      }
+    }
+    if (!record) {
+      record = Claim();
+      records.push_back(ThreadRecords::Entry { id, weak_from_this(), record });
+    }
+
+    local.lastId = id;
+    local.last = record;
+    return *record;
+  }
+
+  _ReclaimRecord* _ReclaimRegistry::Claim() {
+    _ReclaimRecord* record = nullptr;
+    for (_ReclaimRecord* r = head.load(); r; r = r->next) {
+      bool inUse = false;
+      if (!r->inUse.load(std::memory_order_relaxed) && r->inUse.compare_exchange_strong(inUse, true)) {
+        record = r;
+        break;
+      }
+    }
+
+    if (!record) {
+      record = newRecord();
+      record->next = head.load();
+      while (!head.compare_exchange_weak(record->next, record)) {}
+    }
+    return record;
+  }
+
+  _ReclaimRecord* _ReclaimRegistry::Head() const {
+    return head.load();
+  }
+
+  void _ReclaimRegistry::AdoptOrphans(std::vector<_Retired>& retired) {
+    std::unique_lock<std::mutex> lock(orphansMutex, std::try_to_lock);
+    if (!lock.owns_lock() || orphans.empty()) { return; }
+    retired.insert(retired.end(), orphans.begin(), orphans.end());
+    orphans.clear();
+  }
+
+  void _ReclaimRegistry::FreeAll() {
+    for (_ReclaimRecord* record = head.load(); record; record = record->next) {
+      Free(record->retired);
+    }
+    std::lock_guard<std::mutex> lock(orphansMutex);
+    Free(orphans);
+  }
+
+  void _ReclaimRegistry::Release(_ReclaimRecord* record) {
+    {
+      std::lock_guard<std::mutex> lock(orphansMutex);
+      orphans.insert(orphans.end(), record->retired.begin(), record->retired.end());
+      record->retired.clear();
+    }
+    record->inUse.store(false);
+  }
+
+  struct EpochDomain::Record : public _ReclaimRecord {
+    // Epoch this thread's reader entered at, or zero outside of any Guard.
+    alignas(64) std::atomic_long epoch = 0;
+    int nesting = 0;
+    std::size_t collectAt = 0;
+  };
+
+  EpochDomain::Guard::Guard(EpochDomain& domain) : record(domain.Local()) {
+    if (record.nesting++ == 0) {
+      record.epoch.store(domain.epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      // Writers must see us in before we load anything from the structure.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+  }
+
+  EpochDomain::Guard::~Guard() {
+    if (--record.nesting == 0) {
+      record.epoch.store(0, std::memory_order_release);
+    }
+  }
+
+  EpochDomain::EpochDomain(int retireThreshold) 
+      : retireThreshold(std::max(retireThreshold, 1)), 
+        registry(std::make_shared<_ReclaimRegistry>([]() { return new Record(); })) {}
+
+  EpochDomain::~EpochDomain() {
+    registry->FreeAll();
+  }
+
+  EpochDomain& EpochDomain::Default() {
+    static EpochDomain domain;
+    return domain;
+  }
+
+  void EpochDomain::Retire(void* ptr, void (*deleter)(void*)) {
+    Record& record = Local();
+    record.retired.push_back(_Retired { ptr, deleter, epoch.load() });
+    if (record.retired.size() >= std::max(record.collectAt, (std::size_t) retireThreshold)) {
+      Collect(record);
+    }
+  }
+
+  void EpochDomain::Synchronize() {
+    Record& record = Local();
+    if (record.nesting > 0) {
+      throw std::logic_error("Can't synchronize from inside an EpochDomain::Guard");
+    }
+
+    // Two steps forward and every reader that was in has left.
+    long target = epoch.load() + 2;
+    while (epoch.load() < target) {
+      if (!TryAdvance()) { std::this_thread::yield(); }
+    }
+    Collect(record);
+  }
+
+  long EpochDomain::Epoch() const {
+    return epoch.load();
+  }
+
+  EpochDomain::Record& EpochDomain::Local() {
+    return static_cast<Record&>(registry->Local());
+  }
+
+  bool EpochDomain::TryAdvance() {
+    long current = epoch.load();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (_ReclaimRecord* r = registry->Head(); r; r = r->next) {
+      long entered = static_cast<Record*>(r)->epoch.load();
+      if (entered != 0 && entered != current) { return false; }
+    }
+    // Losing means somebody else moved it forward, which is just as good.
+    epoch.compare_exchange_strong(current, current + 1);
+    return true;
+  }
+
+  void EpochDomain::Collect(Record& record) {
+    TryAdvance();
+    registry->AdoptOrphans(record.retired);
+
+    long safe = epoch.load() - 2;
+    auto kept = std::partition(record.retired.begin(), record.retired.end(), 
+        [safe](const _Retired& r) { return r.epoch > safe; });
+    // Deleters may retire more, so they run once the list is back in order.
+    std::vector<_Retired> reclaimable(kept, record.retired.end());
+    record.retired.erase(kept, record.retired.end());
+    Free(reclaimable);
+
+    // Readers holding things back shouldn't make every Retire() walk the whole list.
+    record.collectAt = 2 * record.retired.size();
+  }
+
+  struct HazardPointerDomain::Record : public _ReclaimRecord {
+    std::atomic<void*> hazards[kSlots] = {};
+    // Bit mask of the slots taken by a Hazard.
+    int used = 0;
+    std::size_t collectAt = 0;
+  };
+
+  HazardPointerDomain::Hazard::Hazard(HazardPointerDomain& domain) 
+      : record(domain.Local()), index(0) {
+    while (index < kSlots && (record.used & (1 << index))) { index++; }
+    if (index == kSlots) {
+      throw std::runtime_error("Thread is out of hazard pointer slots");
+    }
+    record.used |= 1 << index;
+  }
+
+  HazardPointerDomain::Hazard::~Hazard() {
+    Reset();
+    record.used &= ~(1 << index);
+  }
+
+  void HazardPointerDomain::Hazard::Reset() {
+    record.hazards[index].store(nullptr, std::memory_order_release);
+  }
+
+  void HazardPointerDomain::Hazard::Set(void* ptr) {
+    record.hazards[index].store(ptr);
+  }
+
+  HazardPointerDomain::HazardPointerDomain(int retireThreshold) 
+      : retireThreshold(std::max(retireThreshold, 1)), 
+        registry(std::make_shared<_ReclaimRegistry>([]() { return new Record(); })) {}
+
+  HazardPointerDomain::~HazardPointerDomain() {
+    registry->FreeAll();
+  }
+
+  HazardPointerDomain& HazardPointerDomain::Default() {
+    static HazardPointerDomain domain;
+    return domain;
+  }
+
+  void HazardPointerDomain::Retire(void* ptr, void (*deleter)(void*)) {
+    Record& record = Local();
+    record.retired.push_back(_Retired { ptr, deleter, 0 });
+    if (record.retired.size() >= std::max(record.collectAt, (std::size_t) retireThreshold)) {
+      Collect();
+    }
+  }
+
+  void HazardPointerDomain::Collect() {
+    Record& record = Local();
+    registry->AdoptOrphans(record.retired);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::vector<void*> hazards;
+    for (_ReclaimRecord* r = registry->Head(); r; r = r->next) {
+      for (auto& hazard : static_cast<Record*>(r)->hazards) {
+        void* ptr = hazard.load();
+        if (ptr) { hazards.push_back(ptr); }
+      }
+    }
+    std::sort(hazards.begin(), hazards.end());
+
+    auto kept = std::partition(record.retired.begin(), record.retired.end(), 
+        [&hazards](const _Retired& r) {
+          return std::binary_search(hazards.begin(), hazards.end(), r.ptr);
+        });
+    std::vector<_Retired> reclaimable(kept, record.retired.end());
+    record.retired.erase(kept, record.retired.end());
+    Free(reclaimable);
+
+    record.collectAt = 2 * record.retired.size();
+  }
+
+  HazardPointerDomain::Record& HazardPointerDomain::Local() {
+    return static_cast<Record&>(registry->Local());
+  }
+
+} // concurrent
+} // mdl
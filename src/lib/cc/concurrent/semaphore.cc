@@ -28,59 +28,240 @@
 
 #include "../../h/concurrent/semaphore.h"
 
+#include "../../h/concurrent/exception.h"
+
 namespace mdl {
 namespace concurrent {
 
   Semaphore::Semaphore(long tickets) : tickets(tickets) {}
 
+  Semaphore::Semaphore(long tickets, const WaitPolicy& policy) : tickets(tickets), sync(policy) {}
+
+  Semaphore::Semaphore(const std::string& name, long tickets, const WaitPolicy& policy) 
+      : tickets(tickets), sync(name, policy) {}
+
   void Semaphore::Up() {
-    sync.Synchronized<void>([this]() {
-      tickets++;
-      sync.Notify();
+    ManagedBlocker::Waker fiber = sync.Synchronized<ManagedBlocker::Waker>([this]() {
+      return ReleaseTicket();
     });
+    if (fiber) { fiber(); }
   }
 
   template<>
   void Semaphore::Up<void>(std::function<void (long)>&& doBeforeFn) {
-    return sync.Synchronized<void>([this, &doBeforeFn]() {
+    ManagedBlocker::Waker fiber = sync.Synchronized<ManagedBlocker::Waker>([this, &doBeforeFn]() {
       doBeforeFn(tickets);
-      tickets++;
-      sync.Notify();
+      return ReleaseTicket();
     });
+    if (fiber) { fiber(); }
   }
 
   void Semaphore::Down() {
+    if (ManagedBlocker* fiber = _yielding_blocker()) {
+      std::function<void (long)> none = [](long) {};
+      YieldingDown<void>(fiber, nullptr, none);
+      return;
+    }
+
+    // checked outside the lock, so it may be wrong both ways. Close enough for a hint.
+    ManagedBlock block(tickets.load() <= 0);
     sync.Synchronized<void>([this]() {
-      tickets--;
-      if (tickets < 0) {
-        sync.Wait();
-      }
+      AwaitTicket();
     });
   }
 
   template<>
   void Semaphore::Down<void> (std::function<void (long)>&& doAfterFn) {
+    if (ManagedBlocker* fiber = _yielding_blocker()) {
+      YieldingDown<void>(fiber, nullptr, doAfterFn);
+      return;
+    }
+
+    ManagedBlock block(tickets.load() <= 0);
      sync.Synchronized<void>([this, &doAfterFn]() {
-      tickets--;
-      if (tickets < 0) {
-        sync.Wait();
-      }
+      AwaitTicket();
       doAfterFn(tickets);
     });
   }
 
+  void Semaphore::Down(const CancellationToken& token) {
+    if (ManagedBlocker* fiber = _yielding_blocker()) {
+      std::function<void (long)> none = [](long) {};
+      YieldingDown<void>(fiber, &token, none);
+      return;
+    }
+
+    ManagedBlock block(tickets.load() <= 0);
+    sync.Synchronized<void>([this, &token]() {
+      AwaitTicket(token);
+    });
+  }
+
+  bool Semaphore::TryDown(long timeoutMillis) {
+    ManagedBlocker* fiber = timeoutMillis > 0 ? _yielding_blocker() : nullptr;
+    if (fiber) {
+      std::function<void (long)> none = [](long) {};
+      return YieldingTryDown(fiber, timeoutMillis, none);
+    }
+
+    ManagedBlock block(timeoutMillis > 0 && tickets.load() <= 0);
+    return sync.Synchronized<bool>([this, timeoutMillis]() {
+      return AwaitTicket(timeoutMillis);
+    });
+  }
+
+  bool Semaphore::TryDown(long timeoutMillis, std::function<void (long)>&& doAfterFn) {
+    ManagedBlocker* fiber = timeoutMillis > 0 ? _yielding_blocker() : nullptr;
+    if (fiber) { return YieldingTryDown(fiber, timeoutMillis, doAfterFn); }
+
+    ManagedBlock block(timeoutMillis > 0 && tickets.load() <= 0);
+    return sync.Synchronized<bool>([this, timeoutMillis, &doAfterFn]() {
+      if (!AwaitTicket(timeoutMillis)) { return false; }
+      doAfterFn(tickets);
+      return true;
+    });
+  }
+
   long Semaphore::NumTickets() const {
     return tickets.load();
   }
 
   void Semaphore::InterruptAll() {
-    sync.Synchronized<void>([this]() {
+    std::map<long, ManagedBlocker::Waker> interrupted;
+    sync.Synchronized<void>([this, &interrupted]() {
       // all interrupted threads will be awaken, and they will not require a ticket anymore. For 
-      //  that reason, we set the number of tickets back to zero.
+      //  that reason, we set the number of tickets back to zero, plus whatever tickets had 
+      //  already been handed to waiters that didn't get to take them.
       if (tickets.load() < 0) { tickets.store(0); }
+      tickets += wakeups;
+      wakeups = 0;
       
+      interrupts++;
       sync.Interrupt();
+      interrupted.swap(fibers);
     });
+    for (auto& [id, fiber] : interrupted) { fiber(); }
+  }
+
+  void Semaphore::AwaitTicket() {
+    tickets--;
+    if (tickets < 0) {
+      while (wakeups == 0) {
+        sync.Wait();
+      }
+      wakeups--;
+    }
+  }
+
+  bool Semaphore::AwaitTicket(long timeoutMillis) {
+    tickets--;
+    if (tickets < 0) {
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+      while (wakeups == 0) {
+        long remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0 || !sync.Wait(remaining)) {
+          if (wakeups > 0) { break; }
+          // gave up: this thread is no longer waiting, so it gives back its claim.
+          tickets++;
+          return false;
+        }
+      }
+      wakeups--;
+    }
+    return true;
+  }
+
+  void Semaphore::AwaitTicket(const CancellationToken& token) {
+    token.ThrowIfCancellationRequested();
+    tickets--;
+    if (tickets < 0) {
+      sync.Cancellable<void>(token, [this, &token]() {
+        while (wakeups == 0) {
+          if (token.IsCancellationRequested()) {
+            // gave up: this thread is no longer waiting, so it gives back its claim.
+            tickets++;
+            token.ThrowIfCancellationRequested();
+          }
+          sync.Wait();
+        }
+        wakeups--;
+      });
+    }
+  }
+
+  bool Semaphore::TryTake() {
+    // a positive count means nobody is waiting, so there's no one to jump ahead of.
+    if (tickets.load() <= 0) { return false; }
+    tickets--;
+    return true;
+  }
+
+  bool Semaphore::YieldingTryDown(
+      ManagedBlocker* fiber, long timeoutMillis, std::function<void (long)>& doAfterFn) {
+    FiberWait wait(*this, nullptr);
+    return fiber->YieldUntil([this, &wait, &doAfterFn](const ManagedBlocker::Waker& waker) {
+      wait.ThrowIfGivenUp(waker);
+      return sync.Synchronized<bool>([this, &wait, &doAfterFn, &waker]() {
+        if (!wait.TakeOrQueue(waker)) { return false; }
+        doAfterFn(tickets);
+        return true;
+      });
+    }, timeoutMillis);
+  }
+
+  ManagedBlocker::Waker Semaphore::ReleaseTicket() {
+    tickets++;
+    if (tickets <= 0) {
+      // there was at least one thread waiting for this ticket.
+      wakeups++;
+      sync.Notify();
+      return nullptr;
+    }
+    return NextFiber();
+  }
+
+  ManagedBlocker::Waker Semaphore::NextFiber() {
+    if (fibers.empty()) { return nullptr; }
+    ManagedBlocker::Waker fiber = std::move(fibers.begin()->second);
+    fibers.erase(fibers.begin());
+    return fiber;
+  }
+
+  Semaphore::FiberWait::FiberWait(Semaphore& semaphore, const CancellationToken* token) 
+      : semaphore(semaphore), since(semaphore.interrupts.load()), token(token) {}
+
+  Semaphore::FiberWait::~FiberWait() {
+    if (id == 0) { return; }
+    ManagedBlocker::Waker next = semaphore.sync.Synchronized<ManagedBlocker::Waker>([this]() {
+      if (semaphore.fibers.erase(id) > 0 || took || semaphore.tickets.load() <= 0) { 
+        return ManagedBlocker::Waker(); 
+      }
+      // woken up for a ticket, then timed out, or got cancelled, before taking it.
+      return semaphore.NextFiber();
+    });
+    if (next) { next(); }
+  }
+
+  void Semaphore::FiberWait::ThrowIfGivenUp(const ManagedBlocker::Waker& waker) {
+    if (semaphore.interrupts.load() != since) { 
+      throw interrupted_exception("Semaphore interrupted"); 
+    }
+    if (!token) { return; }
+    token->ThrowIfCancellationRequested();
+    // only before the first wait: the registration lasts until the fiber leaves.
+    if (id == 0 && token->CanBeCancelled()) { 
+      cancellation = token->Register(ManagedBlocker::Waker(waker)); 
+    }
+  }
+
+  bool Semaphore::FiberWait::TakeOrQueue(const ManagedBlocker::Waker& waker) {
+    took = semaphore.TryTake();
+    if (took) { return true; }
+    // keeps its place in line when woken up for a ticket someone else took.
+    if (id == 0) { id = ++semaphore.fiberSeq; }
+    semaphore.fibers.try_emplace(id, waker);
+    return false;
   }
 
 } // concurrent
@@ -0,0 +1,116 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../../h/concurrent/serialexecutor.h"
+
+#include <stdexcept>
+#include <thread>
+
+#include "../../h/concurrent/spinwait.h"
+
+namespace mdl {
+namespace concurrent {
+  namespace {
+    // Linking a node is a couple of instructions, but its producer can get preempted in 
+    //  between. Past this many spins, give it the CPU back.
+    constexpr int kLinkSpins = 64;
+  }
+
+  SerialExecutor::State::State(ExecutorService& executor, int maxBatch) 
+      : executor(executor), maxBatch(maxBatch), tail(new Node()), head(tail.load()) {}
+
+  SerialExecutor::State::~State() {
+    while (head) {
+      Node* next = head->next.load();
+      delete head;
+      head = next;
+    }
+  }
+
+  SerialExecutor::SerialExecutor(ExecutorService& executor, int maxBatch) 
+      : state(std::make_shared<State>(executor, maxBatch)) {
+    if (maxBatch < 1) {
+      throw std::invalid_argument("SerialExecutor maxBatch must be at least 1");
+    }
+  }
+
+  void SerialExecutor::Execute(const std::function<void ()>& task) {
+    Enqueue([task]() { task(); });
+  }
+
+  long SerialExecutor::Pending() const {
+    return state->pending.load();
+  }
+
+  void SerialExecutor::Enqueue(std::function<void ()>&& fn) {
+    Node* node = new Node();
+    node->fn = std::move(fn);
+
+    Node* previous = state->tail.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+
+    // Whoever takes pending off zero schedules the strand. The drain keeps it scheduled for as
+    //  long as it doesn't bring it back to zero.
+    if (state->pending.fetch_add(1, std::memory_order_acq_rel) == 0) {
+      std::shared_ptr<State> strand = state;
+      state->executor.EnqueueAccepted([strand]() { Drain(strand); });
+    }
+  }
+
+  void SerialExecutor::Drain(const std::shared_ptr<State>& state) {
+    for (int i = 0; i < state->maxBatch; i++) {
+      // The head is a consumed placeholder, the next task hangs off it. pending says it's 
+      //  there, but its producer may not have linked it yet.
+      Node* head = state->head;
+      Node* next;
+      for (int spins = 0; !(next = head->next.load(std::memory_order_acquire)); spins++) {
+        if (spins < kLinkSpins) {
+          CpuRelax();
+        } else {
+          std::this_thread::yield();
+        }
+      }
+
+      state->head = next;
+      delete head;
+
+      std::function<void ()> fn = std::move(next->fn);
+      next->fn = nullptr;
+      try {
+        fn();
+      } catch (...) {}
+
+      if (state->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) { return; }
+    }
+
+    // Still busy, go to the back of the executor's queue so other work gets a turn.
+    state->executor.EnqueueAccepted([state]() { Drain(state); });
+  }
+
+} // concurrent
+} // mdl
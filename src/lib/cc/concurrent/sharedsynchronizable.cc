@@ -0,0 +1,180 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../../h/concurrent/sharedsynchronizable.h"
+
+#include "../../h/concurrent/exception.h"
+#include "../../h/util/threadhint.h"
+
+namespace mdl {
+namespace concurrent {
+
+  SharedSynchronizable::SharedSynchronizable(int readerSlots) 
+      : numSlots(util::NumThreadSlots(readerSlots)), slots(new ReaderSlot[numSlots]) {}
+
+  // This object keeps its own locks
+  SharedSynchronizable::SharedSynchronizable(const SharedSynchronizable& other) 
+      : numSlots(other.numSlots), slots(new ReaderSlot[numSlots]) {}
+
+  SharedSynchronizable::~SharedSynchronizable() {}
+
+  SharedSynchronizable& SharedSynchronizable::operator=(const SharedSynchronizable& other) {
+    // This object keeps its own locks
+    return *this;
+  }
+
+  void SharedSynchronizable::Wait() {
+    CheckWriteLocked("Wait");
+
+    long seq = interruptedSeq.load();
+    {
+      // Taking waitMutex before letting go of the write lock means no Notify can slip in 
+      //  between the two.
+      std::unique_lock<std::mutex> lock(waitMutex);
+      UnlockWrite();
+      condition.wait(lock);
+    }
+    LockWrite();
+
+    if (interruptedSeq.load() > seq) {
+      throw interrupted_exception("SharedSynchronizable interrupted by caller");
+    }
+  }
+
+  bool SharedSynchronizable::Wait(long timeoutMillis) {
+    CheckWriteLocked("Wait");
+
+    long seq = interruptedSeq.load();
+    std::cv_status status;
+    {
+      std::unique_lock<std::mutex> lock(waitMutex);
+      UnlockWrite();
+      status = condition.wait_for(lock, std::chrono::milliseconds(timeoutMillis));
+    }
+    LockWrite();
+
+    if (interruptedSeq.load() > seq) {
+      throw interrupted_exception("SharedSynchronizable interrupted by caller");
+    }
+
+    return status == std::cv_status::no_timeout;
+  }
+
+  void SharedSynchronizable::Notify() {
+    CheckWriteLocked("Notify");
+    std::lock_guard<std::mutex> lock(waitMutex);
+    condition.notify_one();
+  }
+
+  void SharedSynchronizable::NotifyAll() {
+    CheckWriteLocked("Notify");
+    std::lock_guard<std::mutex> lock(waitMutex);
+    condition.notify_all();
+  }
+
+  void SharedSynchronizable::Interrupt() {
+    CheckWriteLocked("Interrupt");
+    std::lock_guard<std::mutex> lock(waitMutex);
+    interruptedSeq++;
+    condition.notify_all();
+  }
+
+  SharedSynchronizable::Holder::Holder(SharedSynchronizable& owner, Mode mode) 
+      : owner(owner), mode(mode) {
+    if (mode == kRead) {
+      slot = &owner.LockRead();
+    } else {
+      owner.LockWrite();
+    }
+  }
+
+  SharedSynchronizable::Holder::~Holder() {
+    if (mode == kRead) {
+      owner.UnlockRead(*slot);
+    } else {
+      owner.UnlockWrite();
+    }
+  }
+
+  SharedSynchronizable::ReaderSlot& SharedSynchronizable::Slot() {
+    return slots[util::ThreadHint() & (numSlots - 1)];
+  }
+
+  SharedSynchronizable::ReaderSlot& SharedSynchronizable::LockRead() {
+    ReaderSlot& slot = Slot();
+    while (true) {
+      // Registering first and checking for writers second (and the reverse in LockWrite) 
+      //  guarantees that at least one of the two sees the other.
+      slot.readers.fetch_add(1);
+      if (!writer.load()) { return slot; }
+
+      // a writer is active or waiting, back off until it's done.
+      UnlockRead(slot);
+      writer.wait(true);
+    }
+  }
+
+  void SharedSynchronizable::UnlockRead(ReaderSlot& slot) {
+    slot.readers.fetch_sub(1);
+    if (writer.load()) {
+      drainSeq++;
+      drainSeq.notify_all();
+    }
+  }
+
+  void SharedSynchronizable::LockWrite() {
+    bool expected = false;
+    while (!writer.compare_exchange_weak(expected, true)) {
+      if (expected) { writer.wait(true); }
+      expected = false;
+    }
+
+    // no new readers get in from here on. Wait for the ones inside to leave.
+    for (int i = 0; i < numSlots; i++) {
+      while (slots[i].readers.load() != 0) {
+        long seq = drainSeq.load();
+        if (slots[i].readers.load() != 0) {
+          drainSeq.wait(seq);
+        }
+      }
+    }
+  }
+
+  void SharedSynchronizable::UnlockWrite() {
+    writer.store(false);
+    writer.notify_all();
+  }
+
+  void SharedSynchronizable::CheckWriteLocked(const char* operation) {
+    if (!threadMode || *threadMode != kWrite) {
+      throw std::runtime_error(std::string("Call to ") + operation + " while not write locked.");
+    }
+  }
+
+} // concurrent
+} // mdl
@@ -0,0 +1,77 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../../h/concurrent/spinwait.h"
+
+#include <algorithm>
+
+namespace mdl {
+namespace concurrent {
+
+  WaitPolicy WaitPolicy::Park() {
+    return WaitPolicy();
+  }
+
+  WaitPolicy WaitPolicy::LowLatency() {
+    WaitPolicy policy;
+    policy.maxSpins = 4000;
+    policy.maxYields = 8;
+    return policy;
+  }
+
+  SpinWait::SpinWait(const WaitPolicy& policy) 
+      : policy(policy), spinBudget(policy.maxSpins) {}
+
+  const WaitPolicy& SpinWait::Policy() const {
+    return policy;
+  }
+
+  int SpinWait::SpinBudget() const {
+    return policy.adaptive ? spinBudget.load(std::memory_order_relaxed) : policy.maxSpins;
+  }
+
+  void SpinWait::OnSuccess(int spins) {
+    if (!policy.adaptive) { return; }
+
+    // Moves halfway towards twice what the last wait needed, so a few long waits don't throw
+    //  the budget off.
+    int budget = spinBudget.load(std::memory_order_relaxed);
+    int target = std::clamp(2 * spins, std::min(kMinSpins, policy.maxSpins), policy.maxSpins);
+    spinBudget.store(std::max(budget, (budget + target + 1) / 2), std::memory_order_relaxed);
+  }
+
+  void SpinWait::OnFailure() {
+    if (!policy.adaptive) { return; }
+
+    int budget = spinBudget.load(std::memory_order_relaxed);
+    spinBudget.store(std::max(std::min(kMinSpins, policy.maxSpins), budget / 2), 
+        std::memory_order_relaxed);
+  }
+
+} // concurrent
+} // mdl
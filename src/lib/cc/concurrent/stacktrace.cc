@@ -0,0 +1,155 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../../h/concurrent/stacktrace.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+
+#ifdef __linux__
+#include <csignal>
+#include <cstdlib>
+#include <execinfo.h>
+#include <pthread.h>
+#endif
+
+namespace mdl {
+namespace concurrent {
+#ifdef __linux__
+  namespace {
+    const int kMaxFrames = 64;
+
+    std::mutex captureMutex;
+    void* frames[kMaxFrames];
+    std::atomic_int numFrames = 0;
+    // Captures are numbered, and the number travels with the signal. frames belong to the 
+    //  capture whose number is in slot: the handler only writes them after swapping that number
+    //  for its negative, and a capture that times out takes it back first, so a handler that
+    //  runs late can't write over the frames of the next one.
+    std::atomic_int requested = 0;
+    std::atomic_int slot = 0;
+    std::atomic_int answered = 0;
+
+    std::string Symbolize(void* const* frames, int count, int skip) {
+      std::ostringstream out;
+      char** symbols = backtrace_symbols(frames, count);
+      for (int i = skip; i < count; i++) {
+        out << (symbols ? symbols[i] : "??") << '\n';
+      }
+      free(symbols);
+      return out.str();
+    }
+
+    void CaptureHandler(int, siginfo_t* info, void*) {
+      int seq = info->si_value.sival_int;
+      if (!slot.compare_exchange_strong(seq, -seq)) { return; }
+      // backtrace isn't formally async signal safe, but is once libgcc is loaded, which 
+      //  InstallHandler takes care of.
+      numFrames.store(backtrace(frames, kMaxFrames));
+      answered.store(seq);
+    }
+
+    int CaptureSignal() {
+      return SIGRTMIN + 3;
+    }
+
+    // Returns false if the application has a handler of its own on the signal, which is then
+    //  left alone.
+    bool InstallHandler() {
+      static std::once_flag once;
+      static bool installed = false;
+      std::call_once(once, []() {
+        struct sigaction previous {};
+        if (sigaction(CaptureSignal(), nullptr, &previous) != 0) { return; }
+        if ((previous.sa_flags & SA_SIGINFO) 
+            || (previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN)) {
+          return;
+        }
+
+        void* warmUp[1];
+        backtrace(warmUp, 1);
+
+        struct sigaction action {};
+        action.sa_sigaction = CaptureHandler;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART | SA_SIGINFO;
+        installed = sigaction(CaptureSignal(), &action, nullptr) == 0;
+      });
+      return installed;
+    }
+  }
+
+  std::string CurrentStackTrace() {
+    void* frames[kMaxFrames];
+    int count = backtrace(frames, kMaxFrames);
+    // leaves this function out.
+    return Symbolize(frames, count, 1);
+  }
+
+  std::string CaptureStackTrace(std::thread::native_handle_type thread, long timeoutMillis) {
+    if (!InstallHandler()) { return std::string(); }
+    std::lock_guard<std::mutex> lock(captureMutex);
+
+    int seq = ++requested;
+    slot.store(seq);
+    sigval value {};
+    value.sival_int = seq;
+    if (pthread_sigqueue(thread, CaptureSignal(), value) != 0) { 
+      slot.store(0);
+      return std::string(); 
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+    while (answered.load() != seq) {
+      int expected = seq;
+      if (std::chrono::steady_clock::now() >= deadline 
+          && slot.compare_exchange_strong(expected, 0)) {
+        return std::string();
+      }
+      // past the deadline, but the handler is already writing. It won't be long.
+      std::this_thread::yield();
+    }
+    // leaves the signal handler frames out.
+    std::string trace = Symbolize(frames, numFrames.load(), 2);
+    slot.store(0);
+    return trace;
+  }
+#else
+  std::string CurrentStackTrace() {
+    return std::string();
+  }
+
+  std::string CaptureStackTrace(std::thread::native_handle_type, long) {
+    return std::string();
+  }
+#endif
+
+} // concurrent
+} // mdl
@@ -0,0 +1,70 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../../h/concurrent/stripedcounter.h"
+
+namespace mdl {
+namespace concurrent {
+
+  StripedCounter::StripedCounter(int cells) 
+      : numCells(util::NumThreadSlots(cells)), cells(new Cell[numCells]) {}
+
+  void StripedCounter::Add(long delta) {
+    std::atomic_long& value = cells[util::ThreadHint() & (numCells - 1)].value;
+    long current = value.load(std::memory_order_relaxed);
+    if (!value.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {
+      // Somebody else is using this cell. Count anyway, and try another one next time.
+      value.fetch_add(delta, std::memory_order_relaxed);
+      util::NextThreadHint();
+    }
+  }
+
+  long StripedCounter::Sum() const {
+    long sum = 0;
+    for (int i = 0; i < numCells; i++) {
+      sum += cells[i].value.load(std::memory_order_relaxed);
+    }
+    return sum;
+  }
+
+  void StripedCounter::Reset() {
+    for (int i = 0; i < numCells; i++) {
+      cells[i].value.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  long StripedCounter::SumThenReset() {
+    long sum = 0;
+    for (int i = 0; i < numCells; i++) {
+      sum += cells[i].value.exchange(0, std::memory_order_relaxed);
+    }
+    return sum;
+  }
+
+} // concurrent
+} // mdl
@@ -37,8 +37,14 @@ namespace concurrent {
 
   Synchronizable::Synchronizable() {}
 
+  Synchronizable::Synchronizable(const WaitPolicy& policy) : spinWait(policy) {}
+
+  Synchronizable::Synchronizable(const std::string& name, const WaitPolicy& policy) 
+      : spinWait(policy), profile(name) {}
+
   // This object keeps its own mutex, lock thread local and interruptedSeq
-  Synchronizable::Synchronizable(const Synchronizable& other) {}
+  Synchronizable::Synchronizable(const Synchronizable& other) 
+      : spinWait(other.spinWait.Policy()), profile(other.profile.Name()) {}
 
   Synchronizable::~Synchronizable() {}
 
@@ -55,19 +61,60 @@ namespace concurrent {
     // we're locked.
     long seq = interruptedSeq.load();
 
-    condition.wait(*threadLock);
+    profile.BeforeWait();
+    if (!SpinForHandoff(seq)) {
+      condition.wait(*threadLock);
+    }
+    profile.AfterWait();
     
     if (interruptedSeq.load() > seq) {
       throw interrupted_exception("Synchronizable interrupted by caller");
     }
   }
 
+  bool Synchronizable::Wait(long timeoutMillis) {
+    if (!threadLock) {
+      throw std::runtime_error("Call to Wait while not syncrhonized.");
+    }
+
+    // we're locked.
+    long seq = interruptedSeq.load();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+
+    profile.BeforeWait();
+    std::cv_status status = SpinForHandoff(seq)
+        ? std::cv_status::no_timeout
+        : condition.wait_until(*threadLock, deadline);
+    profile.AfterWait();
+    
+    if (interruptedSeq.load() > seq) {
+      throw interrupted_exception("Synchronizable interrupted by caller");
+    }
+
+    return status == std::cv_status::no_timeout;
+  }
+
+  void Synchronizable::Wait(const CancellationToken& token) {
+    Cancellable<void>(token, [this, &token]() {
+      token.ThrowIfCancellationRequested();
+      Wait();
+      token.ThrowIfCancellationRequested();
+    });
+  }
+
   void Synchronizable::Notify() {
     // While not stricly required in C++, will notify only when thread holds lock
     if (!threadLock) {
       throw std::runtime_error("Call to Notify while not syncrhonized.");
     }
 
+    profile.OnNotify();
+    if (spinning.load() > handoffs.load()) {
+      // some waiter is still spinning, it will pick this up without a trip to the kernel.
+      handoffs++;
+      return;
+    }
+
     condition.notify_one();
   }
 
@@ -77,6 +124,8 @@ namespace concurrent {
       throw std::runtime_error("Call to Notify while not syncrhonized.");
     }
 
+    profile.OnNotify();
+    handoffs.store(spinning.load());
     condition.notify_all();
   }
 
@@ -89,5 +138,49 @@ namespace concurrent {
     condition.notify_all();
   }
 
+  bool Synchronizable::SpinForHandoff(long seq) {
+    if (!spinWait.Policy().Spins()) { return false; }
+
+    // must be locked.
+    spinning++;
+    threadLock->unlock();
+    spinWait.Await([this, seq]() {
+      return handoffs.load(std::memory_order_relaxed) > 0 
+          || interruptedSeq.load(std::memory_order_relaxed) > seq;
+    });
+    threadLock->lock();
+
+    // Locked again, so nobody can hand anything off while we decide whether to park.
+    spinning--;
+    if (interruptedSeq.load() > seq) {
+      // interrupted waiters don't take notifications meant for others.
+      if (handoffs.load() > spinning.load()) { handoffs.store(spinning.load()); }
+      return true;
+    }
+    if (handoffs.load() > 0) {
+      handoffs--;
+      return true;
+    }
+    return false;
+  }
+
+  void Synchronizable::Unregister(CancellationRegistration& registration) {
+    if (!threadLock) {
+      registration.Unregister();
+      return;
+    }
+
+    // The callback may be running, blocked on this lock. Unregistering waits for it, so the lock
+    //  must be let go meanwhile.
+    threadLock->unlock();
+    try {
+      registration.Unregister();
+    } catch (...) {
+      threadLock->lock();
+      throw;
+    }
+    threadLock->lock();
+  }
+
 } // concurrent
 } // mdl
@@ -30,6 +30,18 @@
 
 #include <stdexcept>
 #include <sstream>
+#include <system_error>
+
+#ifdef __linux__
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include  "../../h/concurrent/exception.h"
 
@@ -43,7 +55,183 @@ namespace concurrent {
     std::thread::id get_id() noexcept { return std::this_thread::get_id(); }
   }
 
-  ThreadFactory::ThreadFactory(const std::string& name) : name(name), idSeq(0) {}
+#ifdef __linux__
+  struct _ThreadStart {
+    std::unique_ptr<_ThreadBody> body;
+    // Published by the thread itself, first thing.
+    std::atomic<std::thread::id> id;
+  };
+
+  namespace {
+    void* RunThread(void* arg) {
+      std::unique_ptr<std::shared_ptr<_ThreadStart>> start(
+          static_cast<std::shared_ptr<_ThreadStart>*>(arg));
+      (*start)->id.store(std::this_thread::get_id());
+      // freed here, like std::thread does with its copies.
+      std::unique_ptr<_ThreadBody> body = std::move((*start)->body);
+      try {
+        body->Run();
+      } catch (...) {
+        std::terminate();
+      }
+      return nullptr;
+    }
+  }
+
+  Thread::Thread(std::unique_ptr<_ThreadBody>&& body, std::size_t stackSize) 
+      : start(std::make_shared<_ThreadStart>()) {
+    start->body = std::move(body);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (stackSize > 0) {
+      pthread_attr_setstacksize(&attr, std::max<std::size_t>(stackSize, PTHREAD_STACK_MIN));
+    }
+    auto arg = new std::shared_ptr<_ThreadStart>(start);
+    int error = pthread_create(&handle, &attr, &RunThread, arg);
+    pthread_attr_destroy(&attr);
+
+    if (error != 0) {
+      delete arg;
+      start.reset();
+      throw std::system_error(error, std::system_category(), "Failed to start thread");
+    }
+  }
+
+  bool Thread::joinable() const noexcept {
+    return start != nullptr;
+  }
+
+  void Thread::join() {
+    if (!joinable()) {
+      throw std::system_error(std::make_error_code(std::errc::invalid_argument), "Not joinable");
+    }
+    if (pthread_equal(handle, pthread_self())) {
+      throw std::system_error(
+          std::make_error_code(std::errc::resource_deadlock_would_occur), "Thread joining itself");
+    }
+    int error = pthread_join(handle, nullptr);
+    if (error != 0) {
+      throw std::system_error(error, std::system_category(), "Failed to join thread");
+    }
+    start.reset();
+  }
+
+  void Thread::detach() {
+    if (!joinable()) {
+      throw std::system_error(std::make_error_code(std::errc::invalid_argument), "Not joinable");
+    }
+    pthread_detach(handle);
+    start.reset();
+  }
+
+  std::thread::id Thread::get_id() const noexcept {
+    if (!joinable()) { return std::thread::id(); }
+
+    std::thread::id id;
+    while ((id = start->id.load()) == std::thread::id()) {
+      std::this_thread::yield();
+    }
+    return id;
+  }
+
+  Thread::native_handle_type Thread::native_handle() {
+    return handle;
+  }
+
+  void _set_native_thread_name(const std::string& name) {
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+  }
+
+  bool _apply_thread_options(const ThreadOptions& options) {
+    bool applied = true;
+
+    sched_param param {};
+    switch (options.schedulingPolicy) {
+      case SchedulingPolicy::kDefault:
+        break;
+      case SchedulingPolicy::kBatch:
+        applied &= pthread_setschedparam(pthread_self(), SCHED_BATCH, &param) == 0;
+        break;
+      case SchedulingPolicy::kIdle:
+        applied &= pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) == 0;
+        break;
+      case SchedulingPolicy::kFifo:
+        param.sched_priority = options.fifoPriority;
+        applied &= pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+        break;
+    }
+
+    if (options.nice != 0) {
+      // On Linux, nice values belong to threads, not processes.
+      pid_t tid = syscall(SYS_gettid);
+      errno = 0;
+      int current = getpriority(PRIO_PROCESS, tid);
+      applied &= errno == 0 && setpriority(PRIO_PROCESS, tid, current + options.nice) == 0;
+    }
+    return applied;
+  }
+
+#else
+  // no way to set the stack size of a std::thread.
+  Thread::Thread(std::unique_ptr<_ThreadBody>&& body, std::size_t) 
+      : thread([body = std::move(body)]() { body->Run(); }) {}
+
+  bool Thread::joinable() const noexcept {
+    return thread.joinable();
+  }
+
+  void Thread::join() {
+    thread.join();
+  }
+
+  void Thread::detach() {
+    thread.detach();
+  }
+
+  std::thread::id Thread::get_id() const noexcept {
+    return thread.get_id();
+  }
+
+  Thread::native_handle_type Thread::native_handle() {
+    return thread.native_handle();
+  }
+
+  void _set_native_thread_name(const std::string& name) {}
+
+  bool _apply_thread_options(const ThreadOptions& options) {
+    return options.schedulingPolicy == SchedulingPolicy::kDefault && options.nice == 0;
+  }
+
+#endif
+
+  Thread::Thread() noexcept {}
+
+  Thread::Thread(Thread&& other) noexcept {
+    *this = std::move(other);
+  }
+
+  Thread::~Thread() {
+    if (joinable()) { std::terminate(); }
+  }
+
+  Thread& Thread::operator=(Thread&& other) noexcept {
+    if (joinable()) { std::terminate(); }
+#ifdef __linux__
+    handle = other.handle;
+    start = std::move(other.start);
+#else
+    thread = std::move(other.thread);
+#endif
+    return *this;
+  }
+
+  ThreadFactory::ThreadFactory(const std::string& name, const ThreadOptions& options) 
+      : name(name), idSeq(0), options(std::make_shared<const ThreadOptions>(options)) {}
+
+  const ThreadOptions& ThreadFactory::Options() const {
+    return *options;
+  }
 
   std::string ThreadFactory::NextName() {
     std::ostringstream out;
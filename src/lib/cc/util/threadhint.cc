@@ -0,0 +1,66 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "../../h/util/threadhint.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <thread>
+
+namespace mdl {
+namespace util {
+  namespace {
+    std::atomic_int hintSeq = 0;
+    // Odd multiples of the golden ratio keep consecutive threads far apart. Never zero, which
+    //  xorshift would never move on from.
+    thread_local int hint = (hintSeq++ + 1) * 0x9E3779B9;
+  }
+
+  int ThreadHint() {
+    return hint;
+  }
+
+  void NextThreadHint() {
+    // xorshift, as in java.util.concurrent's striped adders.
+    unsigned h = static_cast<unsigned>(hint);
+    h ^= h << 13;
+    h ^= h >> 17;
+    h ^= h << 5;
+    hint = static_cast<int>(h);
+  }
+
+  int NumThreadSlots(int requested) {
+    if (requested <= 0) {
+      requested = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return std::bit_ceil(static_cast<unsigned>(requested));
+  }
+
+} // util
+} // mdl
@@ -0,0 +1,84 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _MDL_CONCURRENT_BARRIER
+#define _MDL_CONCURRENT_BARRIER
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#include "futex.h"
+#include "spinwait.h"
+
+namespace mdl {
+namespace concurrent {
+
+  /**
+   * Reusable rendezvous point for a fixed group of threads. Each phase ends when every party 
+   * has arrived: the last one to arrive runs the completion function, if any, and only then are
+   * the others released into the next phase. Arriving costs a single atomic increment, the 
+   * waiting threads sleep on the phase number itself.
+   */
+  class Barrier {
+    public:
+      Barrier(int parties, std::function<void ()> completion = nullptr, 
+          const WaitPolicy& policy = WaitPolicy());
+      Barrier(const Barrier& other) = delete;
+      Barrier(Barrier&& other) = delete;
+
+      Barrier& operator=(const Barrier& other) = delete;
+      Barrier& operator=(Barrier&& other) = delete;
+
+      // Waits for the remaining parties of the current phase. Returns the phase that just 
+      //  ended. If the completion function throws, the phase still ends and the exception 
+      //  goes to the thread that ran it.
+      long ArriveAndWait();
+      // Arrives for the current phase without waiting, and drops out of all the ones after it.
+      void ArriveAndDrop();
+
+      int Parties() const;
+      long Phase() const;
+
+    private:
+      std::function<void ()> completion;
+      // Parties in the upper half, arrivals for the current phase in the lower half. Keeping
+      //  both in one word means exactly one thread sees the phase fill up.
+      std::atomic<uint64_t> counts;
+      futex_t phase = 0;
+      std::atomic_int waiters = 0;
+      SpinWait spinWait;
+
+      void Complete(uint32_t current);
+      void Await(uint32_t current);
+  };
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_BARRIER
@@ -0,0 +1,125 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _MDL_CONCURRENT_CANCELLATION
+#define _MDL_CONCURRENT_CANCELLATION
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace mdl {
+namespace concurrent {
+
+  class CancellationToken;
+
+  /**
+   * Keeps a callback registered with a CancellationToken. Unregisters it when destroyed, waiting
+   * for the callback to finish if it happens to be running on another thread at the time, so 
+   * it's safe for callbacks to reference whatever outlives the registration.
+   */
+  class CancellationRegistration {
+    public:
+      CancellationRegistration();
+      CancellationRegistration(const CancellationRegistration& other) = delete;
+      CancellationRegistration(CancellationRegistration&& other);
+      ~CancellationRegistration();
+      CancellationRegistration& operator=(const CancellationRegistration& other) = delete;
+      CancellationRegistration& operator=(CancellationRegistration&& other);
+
+      void Unregister();
+    private:
+      struct State;
+
+      std::shared_ptr<State> state;
+      long id;
+
+      CancellationRegistration(const std::shared_ptr<State>& state, long id);
+
+      friend class CancellationToken;
+      friend class CancellationSource;
+  };
+
+  /**
+   * Read side of a cancellation request. Tasks (and the blocking calls they make) observe it and
+   * give up early once it fires. A default constructed token can never be cancelled.
+   */
+  class CancellationToken {
+    public:
+      CancellationToken();
+
+      bool IsCancellationRequested() const;
+      // Throws interrupted_exception if cancellation was requested.
+      void ThrowIfCancellationRequested() const;
+      // Whether this token can ever fire at all.
+      bool CanBeCancelled() const;
+
+      // Calls fn once cancellation is requested, from whichever thread requests it. If that 
+      //  already happened, fn is called right away.
+      CancellationRegistration Register(std::function<void ()>&& fn) const;
+    private:
+      std::shared_ptr<CancellationRegistration::State> state;
+
+      CancellationToken(const std::shared_ptr<CancellationRegistration::State>& state);
+
+      friend class CancellationSource;
+  };
+
+  /**
+   * Write side of a cancellation request. Hands out tokens and fires them all on Cancel.
+   */
+  class CancellationSource {
+    public:
+      CancellationSource();
+
+      CancellationToken Token() const;
+      // Returns true if this was the call that requested cancellation.
+      bool Cancel();
+      bool IsCancellationRequested() const;
+    private:
+      std::shared_ptr<CancellationRegistration::State> state;
+  };
+
+  struct CancellationRegistration::State {
+    std::atomic_bool cancelled = false;
+    std::mutex mutex;
+    std::condition_variable callbackDone;
+    std::list<std::pair<long, std::function<void ()>>> callbacks;
+    long idSeq = 0;
+    long runningId = 0;
+    std::thread::id runningThread;
+  };
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_CANCELLATION
@@ -0,0 +1,413 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _MDL_CONCURRENT_CONCURRENT_HASH_MAP
+#define _MDL_CONCURRENT_CONCURRENT_HASH_MAP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../util/hash.h"
+#include "sharedsynchronizable.h"
+
+namespace mdl {
+namespace concurrent {
+
+  /**
+   * Hash map safe to use from any number of threads. Keys are spread over segments, each
+   * guarded by its own SharedSynchronizable, so lookups never block each other and updates
+   * only contend with operations on the same segment.
+   *
+   * Segments grow on their own, and incrementally: once one gets too full it allocates a table
+   * twice the size, and every update to that segment moves a few buckets over, so no single
+   * call pays for the whole rehash.
+   *
+   * The functions passed to ComputeIfAbsent and Merge run holding their key's segment lock, and
+   * should be short. They may use the map, but only for reading. ForEach holds no lock while
+   * calling its function.
+   */
+  template <class K, class V, class Hash = std::hash<K>, class Equal = std::equal_to<K>>
+  class ConcurrentHashMap {
+    public:
+      // segments is rounded up to a power of two. Zero picks four per hardware thread.
+      //  initialCapacity is spread over all segments.
+      ConcurrentHashMap(int segments = 0, int initialCapacity = 64);
+      ConcurrentHashMap(const ConcurrentHashMap& other) = delete;
+      ConcurrentHashMap(ConcurrentHashMap&& other) = delete;
+      virtual ~ConcurrentHashMap();
+
+      ConcurrentHashMap& operator=(const ConcurrentHashMap& other) = delete;
+      ConcurrentHashMap& operator=(ConcurrentHashMap&& other) = delete;
+
+      // Returns false, leaving value untouched, if key isn't there.
+      bool Get(const K& key, V& value) const;
+      bool Contains(const K& key) const;
+
+      // Returns true if key was not there before.
+      bool Put(const K& key, const V& value);
+      // Returns false, changing nothing, if key was already there.
+      bool PutIfAbsent(const K& key, const V& value);
+      bool Remove(const K& key);
+
+      // Returns the value for key, calling fn to create it if there's none. fn runs at most
+      //  once per key, even if many threads ask for it at once.
+      V ComputeIfAbsent(const K& key, const std::function<V (const K&)>& fn);
+      // Puts value if key isn't there, or replaces the current value with fn(current, value).
+      //  Returns the value now mapped to key.
+      V Merge(const K& key, const V& value, const std::function<V (const V&, const V&)>& fn);
+
+      // Calls fn once for every entry present for the whole call. Entries added or removed
+      //  meanwhile may or may not be seen. Takes a copy of one segment at a time, so fn is free
+      //  to update the map.
+      void ForEach(const std::function<void (const K&, const V&)>& fn) const;
+
+      long Size() const;
+      bool Empty() const;
+      void Clear();
+
+    private:
+      // Buckets moved to the new table by each update to a segment that's growing.
+      static constexpr int kMigrationStep = 8;
+      static constexpr int kReaderSlots = 4;
+
+      struct Node {
+        K key;
+        V value;
+        uint64_t hash;
+        Node* next;
+      };
+
+      class Segment {
+        public:
+          mutable SharedSynchronizable sync;
+          // Being moved to buckets while growing, otherwise empty.
+          std::vector<Node*> old;
+          std::vector<Node*> buckets;
+          // Buckets at the front of old already moved.
+          std::size_t migrated = 0;
+          std::atomic_long size = 0;
+
+          Segment() : sync(kReaderSlots) {}
+          ~Segment() { Clear(); }
+
+          Node* Find(uint64_t hash, const K& key, const Equal& equal) const;
+          // Where a node with hash belongs: old, if its bucket there hasn't moved yet.
+          Node*& Head(uint64_t hash);
+          void Insert(uint64_t hash, const K& key, const V& value);
+          bool Erase(uint64_t hash, const K& key, const Equal& equal);
+          // Grows when past the load factor, and moves a few buckets if growing.
+          void Maintain();
+          void Clear();
+      };
+
+      int numSegments;
+      int segmentShift;
+      std::unique_ptr<Segment[]> segments;
+      Hash hasher;
+      Equal equal;
+
+      uint64_t HashOf(const K& key) const;
+      Segment& SegmentFor(uint64_t hash) const;
+  };
+
+  template <class K, class V, class Hash, class Equal>
+  ConcurrentHashMap<K, V, Hash, Equal>::ConcurrentHashMap(int segments, int initialCapacity) {
+    if (segments <= 0) {
+      segments = 4 * std::max(1u, std::thread::hardware_concurrency());
+    }
+    numSegments = std::bit_ceil(static_cast<unsigned>(segments));
+    segmentShift = 64 - std::countr_zero(static_cast<unsigned>(numSegments));
+    this->segments.reset(new Segment[numSegments]);
+
+    std::size_t perSegment = std::bit_ceil(static_cast<unsigned>(
+        std::max(4, initialCapacity / numSegments)));
+    for (int i = 0; i < numSegments; i++) {
+      this->segments[i].buckets.resize(perSegment, nullptr);
+    }
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  ConcurrentHashMap<K, V, Hash, Equal>::~ConcurrentHashMap() {}
+
+  template <class K, class V, class Hash, class Equal>
+  bool ConcurrentHashMap<K, V, Hash, Equal>::Get(const K& key, V& value) const {
+    uint64_t hash = HashOf(key);
+    Segment& segment = SegmentFor(hash);
+    return segment.sync.template SynchronizedRead<bool>([this, &segment, hash, &key, &value]() {
+      Node* node = segment.Find(hash, key, equal);
+      if (!node) { return false; }
+      value = node->value;
+      return true;
+    });
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  bool ConcurrentHashMap<K, V, Hash, Equal>::Contains(const K& key) const {
+    uint64_t hash = HashOf(key);
+    Segment& segment = SegmentFor(hash);
+    return segment.sync.template SynchronizedRead<bool>([this, &segment, hash, &key]() {
+      return segment.Find(hash, key, equal) != nullptr;
+    });
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  bool ConcurrentHashMap<K, V, Hash, Equal>::Put(const K& key, const V& value) {
+    uint64_t hash = HashOf(key);
+    Segment& segment = SegmentFor(hash);
+    return segment.sync.template SynchronizedWrite<bool>([this, &segment, hash, &key, &value]() {
+      segment.Maintain();
+      Node* node = segment.Find(hash, key, equal);
+      if (node) {
+        node->value = value;
+        return false;
+      }
+      segment.Insert(hash, key, value);
+      return true;
+    });
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  bool ConcurrentHashMap<K, V, Hash, Equal>::PutIfAbsent(const K& key, const V& value) {
+    uint64_t hash = HashOf(key);
+    Segment& segment = SegmentFor(hash);
+    return segment.sync.template SynchronizedWrite<bool>([this, &segment, hash, &key, &value]() {
+      segment.Maintain();
+      if (segment.Find(hash, key, equal)) { return false; }
+      segment.Insert(hash, key, value);
+      return true;
+    });
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  bool ConcurrentHashMap<K, V, Hash, Equal>::Remove(const K& key) {
+    uint64_t hash = HashOf(key);
+    Segment& segment = SegmentFor(hash);
+    return segment.sync.template SynchronizedWrite<bool>([this, &segment, hash, &key]() {
+      segment.Maintain();
+      return segment.Erase(hash, key, equal);
+    });
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  V ConcurrentHashMap<K, V, Hash, Equal>::ComputeIfAbsent(
+      const K& key, const std::function<V (const K&)>& fn) {
+    uint64_t hash = HashOf(key);
+    Segment& segment = SegmentFor(hash);
+    std::optional<V> existing = segment.sync.template SynchronizedRead<std::optional<V>>(
+        [this, &segment, hash, &key]() -> std::optional<V> {
+          Node* node = segment.Find(hash, key, equal);
+          if (!node) { return std::nullopt; }
+          return node->value;
+        });
+    if (existing) { return std::move(*existing); }
+
+    return segment.sync.template SynchronizedWrite<V>([this, &segment, hash, &key, &fn]() {
+      segment.Maintain();
+      // someone may have beaten us to it.
+      Node* node = segment.Find(hash, key, equal);
+      if (node) { return node->value; }
+
+      V value = fn(key);
+      segment.Insert(hash, key, value);
+      return value;
+    });
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  V ConcurrentHashMap<K, V, Hash, Equal>::Merge(const K& key, const V& value,
+      const std::function<V (const V&, const V&)>& fn) {
+    uint64_t hash = HashOf(key);
+    Segment& segment = SegmentFor(hash);
+    return segment.sync.template SynchronizedWrite<V>([this, &segment, hash, &key, &value, &fn]() {
+      segment.Maintain();
+      Node* node = segment.Find(hash, key, equal);
+      if (!node) {
+        segment.Insert(hash, key, value);
+        return value;
+      }
+      node->value = fn(node->value, value);
+      return node->value;
+    });
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  void ConcurrentHashMap<K, V, Hash, Equal>::ForEach(
+      const std::function<void (const K&, const V&)>& fn) const {
+    std::vector<std::pair<K, V>> entries;
+    for (int i = 0; i < numSegments; i++) {
+      Segment& segment = segments[i];
+      entries.clear();
+      segment.sync.template SynchronizedRead<void>([&segment, &entries]() {
+        entries.reserve(segment.size.load());
+        for (auto* table : { &segment.old, &segment.buckets }) {
+          for (Node* head : *table) {
+            for (Node* node = head; node; node = node->next) {
+              entries.emplace_back(node->key, node->value);
+            }
+          }
+        }
+      });
+
+      for (auto& entry : entries) { fn(entry.first, entry.second); }
+    }
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  long ConcurrentHashMap<K, V, Hash, Equal>::Size() const {
+    long size = 0;
+    for (int i = 0; i < numSegments; i++) { size += segments[i].size.load(); }
+    return size;
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  bool ConcurrentHashMap<K, V, Hash, Equal>::Empty() const {
+    return Size() == 0;
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  void ConcurrentHashMap<K, V, Hash, Equal>::Clear() {
+    for (int i = 0; i < numSegments; i++) {
+      Segment& segment = segments[i];
+      segment.sync.template SynchronizedWrite<void>([&segment]() { segment.Clear(); });
+    }
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  uint64_t ConcurrentHashMap<K, V, Hash, Equal>::HashOf(const K& key) const {
+    // picks a segment with the high bits, and a bucket with the low ones.
+    return util::MixHash(static_cast<uint64_t>(hasher(key)));
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  typename ConcurrentHashMap<K, V, Hash, Equal>::Segment&
+      ConcurrentHashMap<K, V, Hash, Equal>::SegmentFor(uint64_t hash) const {
+    return numSegments == 1 ? segments[0] : segments[hash >> segmentShift];
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  typename ConcurrentHashMap<K, V, Hash, Equal>::Node*
+      ConcurrentHashMap<K, V, Hash, Equal>::Segment::Find(
+          uint64_t hash, const K& key, const Equal& equal) const {
+    Node* head = const_cast<Segment*>(this)->Head(hash);
+    for (Node* node = head; node; node = node->next) {
+      if (node->hash == hash && equal(node->key, key)) { return node; }
+    }
+    return nullptr;
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  typename ConcurrentHashMap<K, V, Hash, Equal>::Node*&
+      ConcurrentHashMap<K, V, Hash, Equal>::Segment::Head(uint64_t hash) {
+    if (!old.empty()) {
+      std::size_t index = hash & (old.size() - 1);
+      if (index >= migrated) { return old[index]; }
+    }
+    return buckets[hash & (buckets.size() - 1)];
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  void ConcurrentHashMap<K, V, Hash, Equal>::Segment::Insert(
+      uint64_t hash, const K& key, const V& value) {
+    Node*& head = Head(hash);
+    head = new Node { key, value, hash, head };
+    size++;
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  bool ConcurrentHashMap<K, V, Hash, Equal>::Segment::Erase(
+      uint64_t hash, const K& key, const Equal& equal) {
+    for (Node** link = &Head(hash); *link; link = &(*link)->next) {
+      Node* node = *link;
+      if (node->hash == hash && equal(node->key, key)) {
+        *link = node->next;
+        delete node;
+        size--;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  void ConcurrentHashMap<K, V, Hash, Equal>::Segment::Maintain() {
+    if (old.empty()) {
+      // load factor of 3/4.
+      if (4 * (std::size_t) size.load() < 3 * buckets.size()) { return; }
+      old.swap(buckets);
+      buckets.assign(2 * old.size(), nullptr);
+      migrated = 0;
+    }
+
+    std::size_t mask = buckets.size() - 1;
+    std::size_t end = std::min(old.size(), migrated + kMigrationStep);
+    for (; migrated < end; migrated++) {
+      Node* node = old[migrated];
+      while (node) {
+        Node* next = node->next;
+        Node*& head = buckets[node->hash & mask];
+        node->next = head;
+        head = node;
+        node = next;
+      }
+      old[migrated] = nullptr;
+    }
+
+    if (migrated == old.size()) {
+      old = std::vector<Node*>();
+      migrated = 0;
+    }
+  }
+
+  template <class K, class V, class Hash, class Equal>
+  void ConcurrentHashMap<K, V, Hash, Equal>::Segment::Clear() {
+    for (auto* table : { &old, &buckets }) {
+      for (Node*& head : *table) {
+        while (head) {
+          Node* next = head->next;
+          delete head;
+          head = next;
+        }
+      }
+    }
+    old = std::vector<Node*>();
+    migrated = 0;
+    size = 0;
+  }
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_CONCURRENT_HASH_MAP
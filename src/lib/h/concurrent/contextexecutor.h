@@ -0,0 +1,189 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#ifndef _MDL_CONCURRENT_CONTEXT_EXECUTOR
+#define _MDL_CONCURRENT_CONTEXT_EXECUTOR
+
+#include <functional>
+#include <memory>
+
+#include "cancellation.h"
+#include "executors.h"
+#include "future.h"
+#include "thread.h"
+
+namespace mdl {
+namespace concurrent {
+
+  /**
+   * ExecutorService whose workers each own a Context, for scratch state that's too costly to 
+   * build per task: buffers, parsers, compiled regexes, random number generators. A worker 
+   * creates its context once, before its first task, and destroys it after its last one. Tasks 
+   * get the context of the worker running them, which no other task uses at the same time.
+   * Tasks that end up running on the submitting thread (see RejectionPolicy::kCallerRuns) get a
+   * context of their own, created for them and destroyed right after.
+   */
+  template <class Context>
+  class ContextExecutor {
+    public:
+      typedef std::function<std::unique_ptr<Context> ()> ContextFactory;
+
+      // Default constructs contexts.
+      ContextExecutor(const ExecutorOptions& options, ThreadFactory& threadFactory);
+      ContextExecutor(const ExecutorOptions& options, ThreadFactory& threadFactory, 
+          const ContextFactory& contextFactory);
+      ContextExecutor(const ContextExecutor& other) = delete;
+      ContextExecutor(ContextExecutor&& other) = delete;
+      virtual ~ContextExecutor() = default;
+      ContextExecutor& operator=(const ContextExecutor& other) = delete;
+      ContextExecutor& operator=(ContextExecutor&& other) = delete;
+
+      void Execute(const std::function<void (Context&)>& task);
+
+      template <class T>
+      Future<T> Submit(const std::function<T (Context&)>& task);
+
+      template <class T>
+      Future<T> Submit(const std::function<T (Context&, const CancellationToken&)>& task);
+
+      // Waits for workers to finish, which destroys their contexts.
+      void Shutdown();
+
+      int NumThreads() const;
+      long NumRejected() const;
+
+    private:
+      // Context of the worker running on this thread, and the executor it works for.
+      struct Current {
+        const ContextExecutor* owner = nullptr;
+        Context* context = nullptr;
+        // A task is using context. One it runs itself, under kCallerRuns, gets another.
+        bool inUse = false;
+      };
+      static inline thread_local Current current;
+
+      ContextFactory contextFactory;
+      // Declared last so that it shuts down, and workers let go of their contexts, first.
+      ExecutorService executor;
+
+      static ExecutorOptions WithHooks(ContextExecutor* self, ExecutorOptions options);
+      template <class T>
+      T RunWithContext(const std::function<T (Context&)>& task);
+  };
+
+  template <class Context>
+  ContextExecutor<Context>::ContextExecutor(
+      const ExecutorOptions& options, ThreadFactory& threadFactory)
+      : ContextExecutor(options, threadFactory, []() { return std::make_unique<Context>(); }) {}
+
+  template <class Context>
+  ContextExecutor<Context>::ContextExecutor(const ExecutorOptions& options, 
+      ThreadFactory& threadFactory, const ContextFactory& contextFactory)
+      : contextFactory(contextFactory), executor(WithHooks(this, options), threadFactory) {}
+
+  template <class Context>
+  void ContextExecutor<Context>::Execute(const std::function<void (Context&)>& task) {
+    executor.Execute([this, task]() { RunWithContext<void>(task); });
+  }
+
+  template <class Context>
+  template <class T>
+  Future<T> ContextExecutor<Context>::Submit(const std::function<T (Context&)>& task) {
+    return executor.Submit<T>(std::function<T ()>([this, task]() { 
+      return RunWithContext<T>(task); 
+    }));
+  }
+
+  template <class Context>
+  template <class T>
+  Future<T> ContextExecutor<Context>::Submit(
+      const std::function<T (Context&, const CancellationToken&)>& task) {
+    return executor.Submit<T>(std::function<T (const CancellationToken&)>(
+        [this, task](const CancellationToken& token) {
+          return RunWithContext<T>([&task, &token](Context& context) { 
+            return task(context, token); 
+          });
+        }));
+  }
+
+  template <class Context>
+  void ContextExecutor<Context>::Shutdown() {
+    executor.Shutdown();
+  }
+
+  template <class Context>
+  int ContextExecutor<Context>::NumThreads() const {
+    return executor.NumThreads();
+  }
+
+  template <class Context>
+  long ContextExecutor<Context>::NumRejected() const {
+    return executor.NumRejected();
+  }
+
+  template <class Context>
+  ExecutorOptions ContextExecutor<Context>::WithHooks(
+      ContextExecutor* self, ExecutorOptions options) {
+    auto onStart = options.onWorkerStart;
+    auto onExit = options.onWorkerExit;
+
+    // workers may start before the constructor returns, but contextFactory is set by then.
+    options.onWorkerStart = [self, onStart]() {
+      if (onStart) { onStart(); }
+      current.context = self->contextFactory().release();
+      current.owner = self;
+    };
+    options.onWorkerExit = [self, onExit]() {
+      if (current.owner == self) {
+        delete current.context;
+        current = Current();
+      }
+      if (onExit) { onExit(); }
+    };
+    return options;
+  }
+
+  template <class Context>
+  template <class T>
+  T ContextExecutor<Context>::RunWithContext(const std::function<T (Context&)>& task) {
+    if (current.owner == this && current.context && !current.inUse) {
+      struct Release {
+        ~Release() { current.inUse = false; }
+      } release;
+      current.inUse = true;
+      return task(*current.context);
+    }
+
+    // not one of our workers, its context failed to build, or a task is using it already.
+    std::unique_ptr<Context> context = contextFactory();
+    return task(*context);
+  }
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_CONTEXT_EXECUTOR
@@ -30,6 +30,8 @@
 #define _MDL_CONCURRENT_EXCEPTION
 
 #include <stdexcept>
+#include <string>
+#include <utility>
 
 namespace mdl {
 namespace concurrent {
@@ -41,6 +43,14 @@ namespace concurrent {
       interrupted_exception(const std::string& message);
   };
 
+  // Thrown by executors that have no room for a task.
+  class rejected_exception : public std::runtime_error {
+    public:
+      rejected_exception(const rejected_exception& other);
+      rejected_exception(const char* message);
+      rejected_exception(const std::string& message);
+  };
+
   class execution_exception : public std::runtime_error {
     public:
       execution_exception(const execution_exception& other);
@@ -50,6 +60,10 @@ namespace concurrent {
     private:
       int errorCode;
   };
+
+  // Message and error code of the exception being handled, the way failed tasks report them. 
+  //  The message is empty for exceptions that carry none. Only call from a catch block.
+  std::pair<std::string, int> _CurrentError();
 } // concurrent
 } // mdl
 
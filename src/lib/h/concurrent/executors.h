@@ -31,18 +31,91 @@
 
 #include <atomic>
 #include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
 
+#include "../util/time.h"
+#include "cancellation.h"
 #include "exception.h"
 #include "future.h"
+#include "managedblocking.h"
+#include "spinwait.h"
+#include "synchronizable.h"
 #include "syncqueue.h"
 #include "thread.h"
 
 namespace mdl {
 namespace concurrent {
 
+  // What a bounded executor does with a task when its queue is full.
+  enum class RejectionPolicy {
+    // The thread submitting the task runs it. Slows producers down to the executor's pace.
+    kCallerRuns,
+    // Throws rejected_exception.
+    kAbort,
+    // Drops the task. Futures of dropped tasks get cancelled.
+    kDiscard,
+    // Drops the task that's been queued the longest, and queues this one instead.
+    kDiscardOldest,
+    // Waits for room, up to blockTimeoutMillis, then throws rejected_exception.
+    kBlock
+  };
+
+  struct SlowTask {
+    // Name of the worker running it, as in this_thread::get_name().
+    std::string worker;
+    long runningMillis = 0;
+    // Empty unless ExecutorOptions::captureStackTraces is set.
+    std::string stackTrace;
+  };
+
+  struct ExecutorOptions {
+    // Number of workers kept alive, even when idle.
+    int coreThreads = 1;
+    // Upper bound on the number of workers. Anything above coreThreads makes the executor 
+    //  elastic: extra workers are started under load and retired once idle.
+    int maxThreads = 1;
+    // How long a worker above coreThreads may stay idle before it retires.
+    long keepAliveMillis = 60000;
+    // Grows the pool when this many tasks are queued with no worker free to take them. Zero
+    //  disables this trigger.
+    int growQueueDepth = 1;
+    // Grows the pool when a task waited in the queue longer than this before it started. Zero
+    //  disables this trigger.
+    long growWaitMillis = 0;
+    // How idle workers wait for new tasks. See WaitPolicy::LowLatency.
+    WaitPolicy waitPolicy;
+    // Tasks that may wait in the queue. Zero is unbounded. An elastic executor grows before
+    //  rejecting anything.
+    int queueCapacity = 0;
+    RejectionPolicy rejectionPolicy = RejectionPolicy::kAbort;
+    // Zero waits for as long as it takes.
+    long blockTimeoutMillis = 0;
+    // Has a watchdog report tasks still running after this long. Zero disables it.
+    long slowTaskMillis = 0;
+    // How often the watchdog looks. Zero picks a quarter of slowTaskMillis.
+    long watchdogIntervalMillis = 0;
+    // Called from the watchdog thread, once per slow task. When unset, they're only counted.
+    std::function<void (const SlowTask&)> onSlowTask;
+    // Includes the worker's stack in reports, by signalling it with SIGRTMIN + 3. Stays empty if
+    //  the application has a handler of its own on that signal. See CaptureStackTrace.
+    bool captureStackTraces = false;
+    // Run on each worker thread before its first task and after its last one. Exceptions they 
+    //  throw are ignored.
+    std::function<void ()> onWorkerStart;
+    std::function<void ()> onWorkerExit;
+    // Extra workers started while tasks block in Future::Get, BlockingQueue::Poll, 
+    //  Semaphore::Down or a ManagedBlock, so the pool keeps making progress. One retires when a
+    //  blocked task resumes, or after keepAliveMillis if idle. Zero disables this.
+    int maxCompensationThreads = 0;
+  };
+
   class ExecutorService {
     public:
       ExecutorService(int numThreads, ThreadFactory& threadFactory);
+      ExecutorService(const ExecutorOptions& options, ThreadFactory& threadFactory);
       ExecutorService(const ExecutorService& other) = delete;
       ExecutorService(ExecutorService&& other) = delete;
       virtual ~ExecutorService();
@@ -54,44 +127,136 @@ namespace concurrent {
       template <class T>
       Future<T> Submit(const std::function<T ()>& task);
 
+      // Same as above, for tasks that watch for cancellation. The token passed in fires when the
+      //  returned future is cancelled, even after the task started.
+      template <class T>
+      Future<T> Submit(const std::function<T (const CancellationToken&)>& task);
+
       void Shutdown();
+
+      // Number of workers currently alive.
+      int NumThreads() const;
+      // Tasks turned away by a full queue, whatever the rejection policy did with them.
+      long NumRejected() const;
+      // Tasks running for longer than slowTaskMillis right now. Empty if there's no watchdog.
+      std::vector<SlowTask> SlowTasks() const;
+      // Tasks reported by the watchdog so far.
+      long NumSlowTasks() const;
     private:
-      BlockingQueue<std::function<void ()>> queue;
-      std::list<std::thread> threads;
+      friend class FiberScheduler;
+      friend class PartitionedExecutor;
+      friend class SerialExecutor;
+
+      struct Task {
+        std::function<void ()> fn;
+        util::instant enqueued;
+        // Called instead of fn if the task gets dropped.
+        std::function<void ()> discard;
+        // Came through EnqueueAccepted, and can't be dropped.
+        bool accepted = false;
+      };
+
+      // Installed on workers while they run a task.
+      struct Compensator : public ManagedBlocker {
+        ExecutorService& executor;
+
+        Compensator(ExecutorService& executor) : executor(executor) {}
+        void BeginBlocking() override;
+        void EndBlocking() override;
+      };
+
+      // What the watchdog knows about a worker.
+      struct Worker {
+        std::string name;
+        std::thread::native_handle_type handle;
+        // When the current task started, in steady clock nanoseconds. Zero while idle.
+        std::atomic_long started = 0;
+        // Start of the last task reported, so each one is reported once.
+        long reported = 0;
+        // Held by the watchdog while it signals the thread, and set, holding it, once the 
+        //  thread is on its way out, so it's never signalled after it's gone.
+        Synchronizable signalSync;
+        bool exited = false;
+      };
+
+      ExecutorOptions options;
+      ThreadFactory& threadFactory;
+      BlockingQueue<Task> queue;
+      std::list<Thread> threads;
+      // workers that retired on their own, waiting to be joined.
+      std::list<Thread> retired;
+      Synchronizable sync;
       std::atomic_bool shutdown = false;
-      int numThreads;
-      std::atomic_int numStoppedThreads = 0;
+      // logical pool size, used for growing and shrinking.
+      std::atomic_int numThreads = 0;
+      // worker threads that haven't yet returned. Only reaches zero once they're all joinable.
+      std::atomic_int numRunning = 0;
+      std::atomic_long numRejected = 0;
+      std::list<std::shared_ptr<Worker>> workers;
+      std::thread watchdog;
+      mutable Synchronizable watchdogSync;
+      std::atomic_long numSlowTasks = 0;
+      Compensator compensator;
+      // tasks blocked in a managed block, and workers started to make up for them. Both are 
+      //  included in numThreads.
+      std::atomic_int numBlocked = 0;
+      std::atomic_int numCompensating = 0;
 
-      void WorkerThreadFn();
+      void Enqueue(std::function<void ()>&& fn, std::function<void ()>&& discard = nullptr);
+      // Never rejected, going over queueCapacity if need be. For work continuing something 
+      //  already accepted, like a strand's next batch or a fiber's next slice, which can't be
+      //  dropped, nor run by the caller, nor make the caller's caller see an exception.
+      void EnqueueAccepted(std::function<void ()>&& fn);
+      void GrowIfBacklogged();
+      void Reject(Task&& task);
+      bool IsElastic() const;
+      // Starts a worker, unless already at maxThreads, which runs firstTask, if given, before
+      //  polling the queue. Returns whether it did, firstTask being moved from only then.
+      bool Grow(Task* firstTask = nullptr);
+      // How long the task at the head of the queue has been waiting for a worker.
+      long HeadWaitMillis();
+      void StartThread(Task&& firstTask);
+      bool TryRetire();
+      bool TryRetireCompensating();
+      void ReapRetired();
+      void WorkerThreadFn(Task firstTask);
       void ThreadInterrupterFn();
+      std::shared_ptr<Worker> RegisterWorker();
+      void UnregisterWorker(const std::shared_ptr<Worker>& worker);
+      // Workers running a task that started before threshold, in steady clock nanoseconds.
+      std::vector<std::shared_ptr<Worker>> RunningSince(long threshold) const;
+      void WatchdogThreadFn();
+
+      template <class T>
+      static void RunTask(Future<T>& future, const std::function<T ()>& task);
   };
   
 
   template <class T>
   Future<T> ExecutorService::Submit(const std::function<T ()>& task) {
     Future<T> future;
-    queue.Add([future, task]() mutable {
-      if (future.IsCanceled()) { return; }
-      
-      try {
-        future.Set(task());
-      } catch (int errorCode) {
-        future.SetError("Failed to execute task", errorCode);
-      } catch (const char * msg) {
-        future.SetError(std::string(msg), -1);
-      } catch (const std::string& msg) {
-        future.SetError(msg, -1);
-      } catch (const execution_exception& ex) {
-        future.SetError(ex.what(), ex.what_code());
-      } catch (const std::exception& ex) {
-        future.SetError(ex.what(), -1);
-      } catch (...) {
-        future.SetError("Failed to execute task", -1);
-      }
-    });
+    Enqueue([future, task]() mutable {
+      RunTask(future, task);
+    }, [future]() mutable { future.Cancel(); });
+    return future;
+  }
+
+  template <class T>
+  Future<T> ExecutorService::Submit(const std::function<T (const CancellationToken&)>& task) {
+    Future<T> future;
+    CancellationToken token = future.Cooperate();
+    Enqueue([future, task, token]() mutable {
+      RunTask<T>(future, [&task, &token]() { return task(token); });
+    }, [future]() mutable { future.Cancel(); });
     return future;
   }
 
+  template <class T>
+  void ExecutorService::RunTask(Future<T>& future, const std::function<T ()>& task) {
+    if (!future.Start()) { return; }
+    future.state->Run(task);
+  }
+
 } // concurrent
 } // mdl
 
@@ -0,0 +1,151 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#ifndef _MDL_CONCURRENT_FIBER
+#define _MDL_CONCURRENT_FIBER
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../util/time.h"
+#include "executors.h"
+#include "future.h"
+#include "managedblocking.h"
+#include "synchronizable.h"
+
+namespace mdl {
+namespace concurrent {
+  struct _Fiber;
+  struct _FiberParker;
+
+  struct FiberOptions {
+    // Usable stack of each fiber. A guard page below it turns overflows into a crash.
+    std::size_t stackSize = 64 * 1024;
+    // Stacks of finished fibers kept around for new ones.
+    int cachedStacks = 64;
+  };
+
+  /**
+   * Runs fibers, user space threads with small stacks of their own, on the workers of an 
+   * ExecutorService. Switching between fibers saves and restores a handful of registers 
+   * (x86-64 and aarch64 Linux, ucontext elsewhere), so plain synchronous code can run as 
+   * hundreds of thousands of concurrent flows. 
+   * 
+   * Future::Get, BlockingQueue::Poll and Semaphore::Down called from a fiber yield its worker 
+   * to other fibers instead of parking it. The fiber is set aside until whatever completes the 
+   * future, or frees the ticket, schedules it again. Anything else that blocks, Synchronizable 
+   * and latches included, still parks the worker. 
+   * 
+   * A fiber may resume on a different worker than the one it blocked on: don't hold locks, nor
+   * pointers to thread_local variables, across blocking calls. The executor must run every 
+   * task it's given, so don't bound its queue.
+   */
+  class FiberScheduler {
+    public:
+      FiberScheduler(ExecutorService& executor, const FiberOptions& options = FiberOptions());
+      FiberScheduler(const FiberScheduler& other) = delete;
+      FiberScheduler(FiberScheduler&& other) = delete;
+      // Waits for every fiber to finish. Must run before the executor shuts down.
+      virtual ~FiberScheduler();
+      FiberScheduler& operator=(const FiberScheduler& other) = delete;
+      FiberScheduler& operator=(FiberScheduler&& other) = delete;
+
+      // Runs fn on a new fiber.
+      void Execute(const std::function<void ()>& fn);
+
+      template <class T>
+      Future<T> Submit(const std::function<T ()>& fn);
+
+      // Fibers started and not yet finished.
+      long NumFibers() const;
+
+    private:
+      // Installed on workers while they run a fiber.
+      struct Yielder : public ManagedBlocker {
+        FiberScheduler& scheduler;
+
+        Yielder(FiberScheduler& scheduler) : scheduler(scheduler) {}
+        void BeginBlocking() override;
+        void EndBlocking() override;
+        bool CanYield() const override { return true; }
+        bool YieldUntil(
+            const std::function<bool (const Waker&)>& ready, long timeoutMillis) override;
+      };
+
+      ExecutorService& executor;
+      FiberOptions options;
+      Yielder yielder;
+      std::atomic_long numFibers = 0;
+      // Guards stacks and sleeping. Also waited on by the timer, and by the destructor.
+      Synchronizable sync;
+      std::vector<char*> stacks;
+      // Parked fibers with a deadline, by when they wake up. Those woken up earlier stay until 
+      //  then, harmlessly.
+      std::multimap<util::instant, std::shared_ptr<_FiberParker>> sleeping;
+      bool stopping = false;
+      std::thread timer;
+
+      void Start(std::function<void ()>&& fn);
+      // Runs fiber on the calling worker until it yields, sleeps or finishes.
+      void Resume(_Fiber* fiber);
+      void Schedule(_Fiber* fiber);
+      // Schedules the fiber if it's parked. Otherwise, it won't park next time. Static, as stale
+      //  wakers may call it after the scheduler is gone, with no parked fiber left to schedule.
+      static void Wake(_FiberParker& parker);
+      void Finish(_Fiber* fiber);
+      char* AllocateStack();
+      void ReleaseStack(char* stack);
+      void TimerThreadFn();
+  };
+
+  namespace this_fiber {
+    // Whether the caller runs on a fiber.
+    bool active();
+    // Lets other fibers have the worker. Does nothing outside fibers.
+    void yield();
+    // Suspends the fiber without holding up its worker. Outside fibers, sleeps the thread.
+    void sleep(long millis);
+  }
+
+  template <class T>
+  Future<T> FiberScheduler::Submit(const std::function<T ()>& fn) {
+    Future<T> future;
+    Start([future, fn]() mutable {
+      ExecutorService::RunTask(future, fn);
+    });
+    return future;
+  }
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_FIBER
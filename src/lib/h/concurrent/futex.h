@@ -0,0 +1,54 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _MDL_CONCURRENT_FUTEX
+#define _MDL_CONCURRENT_FUTEX
+
+#include <atomic>
+#include <cstdint>
+
+namespace mdl {
+namespace concurrent {
+
+  /**
+   * Lets a thread sleep on a 32 bit word and be woken up by whoever changes it, with no mutex in
+   * between. Backed by futex(2) on Linux, and by atomic wait/notify elsewhere. Waits can return
+   * spuriously, so callers always re-check their condition in a loop.
+   */
+  typedef std::atomic<uint32_t> futex_t;
+
+  // Sleeps as long as word holds expected, for at most timeoutMillis (forever if negative). 
+  //  Returns false if it timed out.
+  bool FutexWait(futex_t& word, uint32_t expected, long timeoutMillis = -1);
+  void FutexWakeOne(futex_t& word);
+  void FutexWakeAll(futex_t& word);
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_FUTEX
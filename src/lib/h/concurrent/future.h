@@ -29,156 +29,611 @@
 #ifndef _MDL_CONCURRENT_FUTURE
 #define _MDL_CONCURRENT_FUTURE
 
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 
+#include "../util/blockpool.h"
+#include "cancellation.h"
 #include "exception.h"
-#include "synchronizable.h"
+#include "managedblocking.h"
 
 namespace mdl {
 namespace concurrent {
+  template <class T> class Promise;
+
+  // Storage for a future's result. Only constructed once there's a result, so T doesn't need to
+  //  be default constructible, nor copyable.
+  template <class V>
+  struct _FutureValue {
+    alignas(V) unsigned char storage[sizeof(V)];
+
+    template <class... Args>
+    void Construct(Args&&... args) {
+      new (storage) V(std::forward<Args>(args)...);
+    }
+
+    V& Get() {
+      return *std::launder(reinterpret_cast<V*>(storage));
+    }
+
+    void Destroy() {
+      Get().~V();
+    }
+  };
+
+  template <>
+  struct _FutureValue<void> {
+    void Construct() {}
+    void Get() {}
+    void Destroy() {}
+  };
+
+  // Fiber waiting for a future to complete. Futures keep these in a lock free stack, which 
+  //  completing closes.
+  struct _FutureWaiter {
+    ManagedBlocker::Waker waker;
+    _FutureWaiter* next;
+
+    // Head of the stack once the future completed. Never dereferenced.
+    static _FutureWaiter* Closed() {
+      static _FutureWaiter closed;
+      return &closed;
+    }
+  };
+
+  /**
+   * State shared by a Future, its copies and its Promises. Reference counted in place and 
+   * allocated from a per thread BlockPool, so creating a future is a single allocation in the 
+   * worst case, and none once the pool is warm.
+   *
+   * Every transition is a CAS on a single atomic word, so whoever wins a race between Set, 
+   * SetError and Cancel decides the outcome. Completing is held only while the winner writes the
+   * result, and states from Done on are final.
+   */
   template <class T>
-  class Future {
-    public:
-      typedef std::decay_t<T> valueType;
+  struct _FutureState {
+    typedef std::decay_t<T> valueType;
+
+    enum State { kPending, kStarted, kCompleting, kDone, kFailed, kCancelled };
+
+    std::atomic_int state = kPending;
+    std::atomic_long refs = 1;
+    // Promises still able to complete this. When the last one goes, the future fails.
+    std::atomic_long promises = 0;
+    // set once the value was moved out by Future::Take.
+    std::atomic_bool taken = false;
+    _FutureValue<valueType> value;
+    int errorCode = 0;
+    std::string errorMsg;
+    std::atomic<CancellationSource*> cancellation = nullptr;
+    std::atomic<_FutureWaiter*> waiters = nullptr;
+    // set on Empty(), which isn't reference counted.
+    bool immortal = false;
+
+    ~_FutureState() { 
+      if (state.load(std::memory_order_acquire) == kDone) {
+        value.Destroy();
+      }
+      delete cancellation.load(); 
+      _FutureWaiter* waiter = waiters.load();
+      while (waiter && waiter != _FutureWaiter::Closed()) {
+        _FutureWaiter* next = waiter->next;
+        delete waiter;
+        waiter = next;
+      }
+    }
+
+    static _FutureState* New() {
+      return new (Pool::Allocate()) _FutureState();
+    }
+
+    // What moved from futures and promises point at, so they stay usable without owning 
+    //  anything. Already failed, and never freed.
+    static _FutureState* Empty() {
+      static _FutureState* empty = []() {
+        _FutureState* state = new _FutureState();
+        state->immortal = true;
+        state->errorCode = -1;
+        state->errorMsg = "Future has been moved from";
+        state->state = kFailed;
+        return state;
+      }();
+      return empty;
+    }
+
+    void Acquire() {
+      if (immortal) { return; }
+      refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Release() {
+      if (immortal) { return; }
+      if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        this->~_FutureState();
+        Pool::Release(this);
+      }
+    }
 
-      Future();
-      Future(const Future<T>& other);
-      Future(Future<T>&& other);
-      virtual ~Future();
-      Future<T>& operator=(const Future<T>& other);
-      Future<T>& operator=(Future<T>&& other);
+    bool Start() {
+      int current = kPending;
+      // should not start task that's already done.
+      return state.compare_exchange_strong(current, kStarted, std::memory_order_acq_rel)
+          || current == kStarted;
+    }
+
+    template <class... V>
+    bool Set(V&&... val) {
+      if (!TryComplete()) { return false; }
+
+      try {
+        value.Construct(std::forward<V>(val)...);
+      } catch (...) {
+        errorCode = -1;
+        errorMsg = "Failed to store task result";
+        Publish(kFailed);
+        throw;
+      }
+      Publish(kDone);
+      return true;
+    }
 
-      valueType Get();
+    bool SetError(const std::string& msg, int code) {
+      if (!TryComplete()) { return false; }
+
+      errorCode = code;
+      errorMsg = msg;
+      Publish(kFailed);
+      return true;
+    }
+
+    // Completes with what fn returns, or fails with what it throws.
+    void Run(const std::function<T ()>& fn) {
+      try {
+        if constexpr (std::is_void_v<T>) {
+          fn();
+          Set();
+        } else {
+          Set(fn());
+        }
+      } catch (...) {
+        std::pair<std::string, int> error = _CurrentError();
+        SetError(error.first.empty() ? "Failed to execute task" : error.first, error.second);
+      }
+    }
+
+    bool Cancel() {
+      int current = state.load(std::memory_order_acquire);
+      while (true) {
+        if (current == kCancelled) { return true; }
+        if (current >= kCompleting) { return false; }
+        if (current == kStarted && !cancellation.load()) { return false; }
+
+        if (state.compare_exchange_weak(current, kCancelled, std::memory_order_acq_rel)) {
+          break;
+        }
+      }
+
+      state.notify_all();
+      WakeWaiters();
+      CancellationSource* source = cancellation.load();
+      if (source) {
+        source->Cancel();
+      }
+      return true;
+    }
+
+    CancellationToken Cooperate() {
+      CancellationSource* source = cancellation.load();
+      if (!source) {
+        CancellationSource* created = new CancellationSource();
+        if (cancellation.compare_exchange_strong(source, created)) {
+          source = created;
+        } else {
+          delete created;
+        }
+      }
+      return source->Token();
+    }
+
+    bool TryComplete() {
+      int current = state.load(std::memory_order_acquire);
+      while (current < kCompleting) {
+        if (state.compare_exchange_weak(current, kCompleting, std::memory_order_acq_rel)) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void Publish(State final) {
+      state.store(final, std::memory_order_release);
+      state.notify_all();
+      WakeWaiters();
+    }
+
+    // Has waker called once this completes. Returns false, without doing so, if it already did.
+    bool AddWaiter(const ManagedBlocker::Waker& waker) {
+      _FutureWaiter* head = waiters.load(std::memory_order_acquire);
+      if (head == _FutureWaiter::Closed()) { return false; }
+
+      _FutureWaiter* waiter = new _FutureWaiter { waker, head };
+      while (!waiters.compare_exchange_weak(waiter->next, waiter, std::memory_order_acq_rel)) {
+        if (waiter->next == _FutureWaiter::Closed()) {
+          delete waiter;
+          return false;
+        }
+      }
+      return true;
+    }
+
+    void WakeWaiters() {
+      _FutureWaiter* waiter = waiters.exchange(_FutureWaiter::Closed(), std::memory_order_acq_rel);
+      while (waiter && waiter != _FutureWaiter::Closed()) {
+        _FutureWaiter* next = waiter->next;
+        waiter->waker();
+        delete waiter;
+        waiter = next;
+      }
+    }
+
+    // only complete inside member functions, hence the indirection.
+    struct Pool {
+      static void* Allocate() {
+        return util::BlockPool<sizeof(_FutureState), alignof(_FutureState)>::Allocate();
+      }
+      static void Release(void* block) {
+        util::BlockPool<sizeof(_FutureState), alignof(_FutureState)>::Release(block);
+      }
+    };
+
+    State AwaitFinal() {
+      int current = state.load(std::memory_order_acquire);
+      if (current >= kDone) { return static_cast<State>(current); }
+
+      if (ManagedBlocker* fiber = _yielding_blocker()) {
+        bool added = false;
+        fiber->YieldUntil([this, &added](const ManagedBlocker::Waker& waker) {
+          if (state.load(std::memory_order_acquire) >= kDone) { return true; }
+          // left once: it stays until this completes.
+          if (!added) { added = AddWaiter(waker); }
+          return state.load(std::memory_order_acquire) >= kDone;
+        }, -1);
+        return static_cast<State>(state.load(std::memory_order_acquire));
+      }
+
+      ManagedBlock block;
+      while (current < kDone) {
+        // parks on the state word itself (a futex on Linux), no mutex involved.
+        state.wait(current, std::memory_order_acquire);
+        current = state.load(std::memory_order_acquire);
+      }
+      return static_cast<State>(current);
+    }
+  };
+
+  // What Future<T> and Future<void> have in common.
+  template <class T>
+  class _FutureBase {
+    public:
+      _FutureBase(const _FutureBase<T>& other);
+      _FutureBase(_FutureBase<T>&& other);
+      virtual ~_FutureBase();
+      _FutureBase<T>& operator=(const _FutureBase<T>& other);
+      _FutureBase<T>& operator=(_FutureBase<T>&& other);
+
+      // Cancels a task that hasn't started yet. Tasks that take a CancellationToken can also be 
+      //  cancelled while running: their token fires and the future completes as cancelled 
+      //  right away, without waiting for the task to notice.
       bool Cancel();
       bool IsCanceled();
       bool IsDone();
 
     protected:
+      typedef _FutureState<T> State;
+
+      State* state;
+
+      _FutureBase();
+      _FutureBase(State* state);
+
       virtual bool Start();
-      virtual void Set(T&& value);
       virtual void SetError(const std::string& errorMsg, int errorCode);
+      // Marks the task as one that observes cancellation, returning the token it should watch.
+      CancellationToken Cooperate();
+
+      // Waits for completion, throwing unless a value was set.
+      void AwaitValue();
+      // Same, also throwing if the value was taken.
+      void AwaitValue(bool take);
+  };
+
+  template <class T>
+  class Future : public _FutureBase<T> {
+    public:
+      typedef std::decay_t<T> valueType;
+
+      Future();
+
+      // Copy of the result, for any number of consumers.
+      valueType Get();
+      // Moves the result out, for a single consumer. Afterwards, Get, Take and Ref all throw.
+      valueType Take();
+      // The result itself, for readers that don't need a copy. Valid for as long as this or 
+      //  any copy of this future is.
+      const valueType& Ref();
+
+    protected:
+      virtual void Set(T&& value);
 
     private:
-      struct Data {
-        valueType value;
-        int errorCode;
-        std::string errorMsg;
+      Future(_FutureState<T>* state);
 
-        bool started;
-        bool cancelled;
-        bool done;
-        bool failed;
-        Synchronizable sync;
-      };
+      friend class ExecutorService;
+      friend class PartitionedExecutor;
+      friend class SerialExecutor;
+      friend class Promise<T>;
+  };
+
+  template <>
+  class Future<void> : public _FutureBase<void> {
+    public:
+      typedef void valueType;
+
+      Future() {}
 
-      std::shared_ptr<Data> data;
+      // Waits for completion, throwing if the task failed or was cancelled.
+      void Get() { AwaitValue(); }
+
+    protected:
+      virtual void Set() { state->Set(); }
+
+    private:
+      Future(_FutureState<void>* state) : _FutureBase<void>(state) {}
 
       friend class ExecutorService;
+      friend class PartitionedExecutor;
+      friend class SerialExecutor;
+      friend class Promise<void>;
+  };
+
+  /**
+   * Write side of a Future, for results produced outside of an ExecutorService (e.g. by I/O 
+   * callbacks). All copies of a promise complete the same future. If the last copy goes away 
+   * without completing it, the future fails, so that nobody waits on it forever.
+   */
+  template <class T>
+  class Promise {
+    public:
+      typedef std::decay_t<T> valueType;
+
+      Promise();
+      Promise(const Promise<T>& other);
+      Promise(Promise<T>&& other);
+      ~Promise();
+      Promise<T>& operator=(const Promise<T>& other);
+      Promise<T>& operator=(Promise<T>&& other);
+
+      Future<T> GetFuture() const;
+
+      // Each returns true if it was the one that completed the future. Once the future is 
+      //  complete (or cancelled), they have no effect. Set takes whatever valueType can be
+      //  constructed from, or nothing for Promise<void>.
+      template <class... V>
+      bool Set(V&&... value);
+      bool SetError(const std::string& errorMsg, int errorCode);
+      // Completes the future with what fn returns, or fails it with what fn throws.
+      void Run(const std::function<T ()>& fn);
+
+      bool IsCanceled() const;
+      // Fires if the future is cancelled, including while its result is being produced.
+      CancellationToken Token() const;
+
+    private:
+      _FutureState<T>* state;
+
+      void Abandon();
   };
 
 
   template <class T>
-  Future<T>::Future() : data(new Data()) {}
+  _FutureBase<T>::_FutureBase() : state(State::New()) {}
 
   template <class T>
-  Future<T>::Future(const Future<T>& other) : data(other.data) {}
+  _FutureBase<T>::_FutureBase(State* state) : state(state) {
+    state->Acquire();
+  }
 
   template <class T>
-  Future<T>::Future(Future<T>&& other) : data(std::move(other.data)) {}
+  _FutureBase<T>::_FutureBase(const _FutureBase<T>& other) : state(other.state) {
+    state->Acquire();
+  }
 
   template <class T>
-  Future<T>::~Future() {}
+  _FutureBase<T>::_FutureBase(_FutureBase<T>&& other) : state(other.state) {
+    // moved from futures still point at something valid. 
+    other.state = State::Empty();
+  }
 
   template <class T>
-  Future<T>& Future<T>::operator=(const Future<T>& other) {
-    data = other.data;
+  _FutureBase<T>::~_FutureBase() {
+    state->Release();
   }
 
   template <class T>
-  Future<T>& Future<T>::operator=(Future<T>&& other) {
-    data = std::move(other.data);
+  _FutureBase<T>& _FutureBase<T>::operator=(const _FutureBase<T>& other) {
+    other.state->Acquire();
+    state->Release();
+    state = other.state;
+    return *this;
   }
 
   template <class T>
-  typename Future<T>::valueType Future<T>::Get() {
-    return data->sync.template Synchronized<valueType>([this]() {
-      while (!data->done) {
-        data->sync.Wait();
-      }
+  _FutureBase<T>& _FutureBase<T>::operator=(_FutureBase<T>&& other) {
+    std::swap(state, other.state);
+    return *this;
+  }
 
-      if (data->cancelled) {
-        throw interrupted_exception("Task has been cancelled");
-      }
-      if (data->failed) {
-        throw execution_exception(data->errorMsg, data->errorCode);
-      }
+  template <class T>
+  bool _FutureBase<T>::Cancel() {
+    return state->Cancel();
+  }
 
-      return data->value;
-    });
+  template <class T>
+  bool _FutureBase<T>::IsCanceled() {
+    return state->state.load(std::memory_order_acquire) == State::kCancelled;
+  }
+    
+  template <class T>
+  bool _FutureBase<T>::IsDone() {
+    return state->state.load(std::memory_order_acquire) >= State::kDone;
   }
 
   template <class T>
-  bool Future<T>::Cancel() {
-    return data->sync.template Synchronized<bool>([this]() {
-      if (data->cancelled) { return true; }
-      if (data->started || data->done) { return false; }
+  bool _FutureBase<T>::Start() {
+    return state->Start();
+  }
 
-      data->cancelled = true;
-      data->done = true;
+  template <class T>
+  void _FutureBase<T>::SetError(const std::string& errorMsg, int errorCode) {
+    state->SetError(errorMsg, errorCode);
+  }
 
-      data->sync.NotifyAll();
-      return true;
-    });
+  template <class T>
+  CancellationToken _FutureBase<T>::Cooperate() {
+    return state->Cooperate();
   }
 
   template <class T>
-  bool Future<T>::IsCanceled() {
-    return data->sync.template Synchronized<bool>([this]() {
-      return data->cancelled;
-    });
+  void _FutureBase<T>::AwaitValue() {
+    switch (state->AwaitFinal()) {
+      case State::kCancelled:
+        throw interrupted_exception("Task has been cancelled");
+      case State::kFailed:
+        throw execution_exception(state->errorMsg, state->errorCode);
+      default:
+        return;
+    }
   }
-    
+
   template <class T>
-  bool Future<T>::IsDone() {
-    return data->sync.template Synchronized<bool>([this]() {
-      return data->done;
-    });
+  void _FutureBase<T>::AwaitValue(bool take) {
+    AwaitValue();
+    bool taken = take 
+        ? state->taken.exchange(true, std::memory_order_acq_rel) 
+        : state->taken.load(std::memory_order_acquire);
+    if (taken) {
+      throw std::runtime_error("Task result has already been taken.");
+    }
   }
 
   template <class T>
-  bool Future<T>::Start() {
-    return data->sync.template Synchronized<bool>([this]() {
-      // should not start task that's already done.
-      if (data->done) { return false; }
+  Future<T>::Future() {}
 
-      data->started = true;
-      return true;
-    });
+  template <class T>
+  Future<T>::Future(_FutureState<T>* state) : _FutureBase<T>(state) {}
+
+  template <class T>
+  typename Future<T>::valueType Future<T>::Get() {
+    this->AwaitValue(false);
+    return this->state->value.Get();
+  }
+
+  template <class T>
+  typename Future<T>::valueType Future<T>::Take() {
+    this->AwaitValue(true);
+    return std::move(this->state->value.Get());
+  }
+
+  template <class T>
+  const typename Future<T>::valueType& Future<T>::Ref() {
+    this->AwaitValue(false);
+    return this->state->value.Get();
   }
 
   template <class T>
   void Future<T>::Set(T&& value) {
-    data->sync.template Synchronized<void>([this, &value]() {
-      if (data->done) { return; }
+    this->state->Set(std::forward<T>(value));
+  }
+
+  template <class T>
+  Promise<T>::Promise() : state(_FutureState<T>::New()) {
+    state->promises++;
+  }
+
+  template <class T>
+  Promise<T>::Promise(const Promise<T>& other) : state(other.state) {
+    state->Acquire();
+    state->promises++;
+  }
+
+  template <class T>
+  Promise<T>::Promise(Promise<T>&& other) : state(other.state) {
+    other.state = _FutureState<T>::Empty();
+  }
+
+  template <class T>
+  Promise<T>::~Promise() {
+    Abandon();
+  }
+
+  template <class T>
+  Promise<T>& Promise<T>::operator=(const Promise<T>& other) {
+    other.state->Acquire();
+    other.state->promises++;
+    Abandon();
+    state = other.state;
+    return *this;
+  }
 
-      data->value = std::forward<T>(value);
-      data->done = true;
-      data->sync.NotifyAll();
-    });
+  template <class T>
+  Promise<T>& Promise<T>::operator=(Promise<T>&& other) {
+    std::swap(state, other.state);
+    return *this;
+  }
+
+  template <class T>
+  Future<T> Promise<T>::GetFuture() const {
+    return Future<T>(state);
+  }
+
+  template <class T>
+  template <class... V>
+  bool Promise<T>::Set(V&&... value) {
+    return state->Set(std::forward<V>(value)...);
+  }
+
+  template <class T>
+  bool Promise<T>::SetError(const std::string& errorMsg, int errorCode) {
+    return state->SetError(errorMsg, errorCode);
   }
 
   template <class T>
-  void Future<T>::SetError(const std::string& errorMsg, int errorCode) {
-    data->sync.template Synchronized<void>([this, errorMsg, errorCode]() {
-      if (data->done) { return; }
+  void Promise<T>::Run(const std::function<T ()>& fn) {
+    state->Run(fn);
+  }
+
+  template <class T>
+  bool Promise<T>::IsCanceled() const {
+    return state->state.load(std::memory_order_acquire) == _FutureState<T>::kCancelled;
+  }
 
-      data->done = true;
-      data->failed = true;
-      data->errorCode = errorCode;
-      data->errorMsg = errorMsg;
-      data->sync.NotifyAll();
-    });
+  template <class T>
+  CancellationToken Promise<T>::Token() const {
+    return state->Cooperate();
+  }
+
+  template <class T>
+  void Promise<T>::Abandon() {
+    if (state->immortal) { return; }
+    if (state->promises.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      state->SetError("Promise abandoned", -1);
+    }
+    state->Release();
   }
   
 } // concurrent
@@ -0,0 +1,71 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _MDL_CONCURRENT_LATCH
+#define _MDL_CONCURRENT_LATCH
+
+#include "futex.h"
+#include "spinwait.h"
+
+namespace mdl {
+namespace concurrent {
+
+  /**
+   * Lets threads wait until a number of events have happened. Once the count reaches zero it 
+   * stays there, and every current and future waiter goes through without blocking.
+   */
+  class CountDownLatch {
+    public:
+      CountDownLatch(int count, const WaitPolicy& policy = WaitPolicy());
+      CountDownLatch(const CountDownLatch& other) = delete;
+      CountDownLatch(CountDownLatch&& other) = delete;
+
+      CountDownLatch& operator=(const CountDownLatch& other) = delete;
+      CountDownLatch& operator=(CountDownLatch&& other) = delete;
+
+      // Counting down past zero is ignored. Throws std::invalid_argument if n is negative.
+      void CountDown(int n = 1);
+      int Count() const;
+
+      void Await();
+      // Same as Await(), but gives up after timeoutMillis. Returns false if it timed out.
+      bool Await(long timeoutMillis);
+
+    private:
+      // Set along with the count once someone sleeps on it, so CountDown only makes a system 
+      //  call when there's actually someone to wake up.
+      static constexpr uint32_t kWaiters = 0x80000000;
+
+      futex_t state;
+      SpinWait spinWait;
+  };
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_LATCH
@@ -0,0 +1,170 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _MDL_CONCURRENT_LOCK_PROFILER
+#define _MDL_CONCURRENT_LOCK_PROFILER
+
+#include <string>
+#include <vector>
+
+#ifdef MDL_LOCK_PROFILING
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#endif
+
+namespace mdl {
+namespace concurrent {
+
+  struct LockStats {
+    std::string name;
+    long acquisitions = 0;
+    // Acquisitions that found the lock taken and had to wait for it.
+    long contended = 0;
+    long waitMicros = 0;
+    long maxWaitMicros = 0;
+    // Time spent holding the lock, not counting time released inside Wait.
+    long holdMicros = 0;
+    long waits = 0;
+    long notifies = 0;
+  };
+
+  /**
+   * Contention statistics for every Synchronizable and Semaphore alive, for finding out which
+   * lock is hot. Profiling is off unless the library is built with MDL_LOCK_PROFILING defined
+   * (e.g. bazel build --copt=-DMDL_LOCK_PROFILING), in which case every acquisition costs two
+   * extra clock reads. Otherwise it compiles down to nothing, and there's nothing to report.
+   */
+  class LockProfiler {
+    public:
+      static constexpr bool Enabled() {
+#ifdef MDL_LOCK_PROFILING
+        return true;
+#else
+        return false;
+#endif
+      }
+
+      static std::vector<LockStats> Snapshot();
+      // The n locks with the most time spent waiting for them, most contended first.
+      static std::vector<LockStats> TopContended(int n);
+      // Same as TopContended(), one line per lock.
+      static std::string Dump(int n = 10);
+      static void Reset();
+  };
+
+#ifdef MDL_LOCK_PROFILING
+  // Profile of one lock, registered with LockProfiler while alive. Except for the counters, 
+  //  only changes while its lock is held.
+  class _LockProfile {
+    public:
+      _LockProfile(const std::string& name = std::string());
+      _LockProfile(const _LockProfile& other) = delete;
+      ~_LockProfile();
+
+      _LockProfile& operator=(const _LockProfile& other) = delete;
+
+      // Locks mutex, counting the time it took if it was taken.
+      template <class Lock, class Mutex>
+      Lock* Acquire(Mutex& mutex);
+      void Release();
+      // Around the lock being let go while waiting on it.
+      void BeforeWait();
+      void AfterWait();
+      void OnNotify();
+
+      const std::string& Name() const;
+      LockStats Stats() const;
+      void Reset();
+
+    private:
+      friend class LockProfiler;
+
+      std::string name;
+      std::atomic_long acquisitions = 0;
+      std::atomic_long contended = 0;
+      std::atomic_long waitMicros = 0;
+      std::atomic_long maxWaitMicros = 0;
+      std::atomic_long holdMicros = 0;
+      std::atomic_long waits = 0;
+      std::atomic_long notifies = 0;
+      std::chrono::steady_clock::time_point holdStart;
+      // LockProfiler's list of every profile.
+      _LockProfile* prev = nullptr;
+      _LockProfile* next = nullptr;
+
+      static long MicrosSince(std::chrono::steady_clock::time_point start);
+  };
+
+  template <class Lock, class Mutex>
+  Lock* _LockProfile::Acquire(Mutex& mutex) {
+    Lock* lock = new Lock(mutex, std::try_to_lock);
+    if (!lock->owns_lock()) {
+      auto start = std::chrono::steady_clock::now();
+      lock->lock();
+      long waited = MicrosSince(start);
+      contended.fetch_add(1, std::memory_order_relaxed);
+      waitMicros.fetch_add(waited, std::memory_order_relaxed);
+      long max = maxWaitMicros.load(std::memory_order_relaxed);
+      while (waited > max 
+          && !maxWaitMicros.compare_exchange_weak(max, waited, std::memory_order_relaxed)) {}
+    }
+    acquisitions.fetch_add(1, std::memory_order_relaxed);
+    holdStart = std::chrono::steady_clock::now();
+    return lock;
+  }
+#else
+  class _LockProfile {
+    public:
+      _LockProfile(const std::string& = std::string()) {}
+
+      template <class Lock, class Mutex>
+      Lock* Acquire(Mutex& mutex) { return new Lock(mutex); }
+      void Release() {}
+      void BeforeWait() {}
+      void AfterWait() {}
+      void OnNotify() {}
+
+      std::string Name() const { return std::string(); }
+  };
+#endif
+
+  // Calls Release() on the profile when the lock it guards goes away.
+  class _LockProfileHold {
+    public:
+      _LockProfileHold(_LockProfile& profile) : profile(profile) {}
+      _LockProfileHold(const _LockProfileHold& other) = delete;
+      ~_LockProfileHold() { profile.Release(); }
+    private:
+      _LockProfile& profile;
+  };
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_LOCK_PROFILER
@@ -0,0 +1,102 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#ifndef _MDL_CONCURRENT_MANAGED_BLOCKING
+#define _MDL_CONCURRENT_MANAGED_BLOCKING
+
+#include <functional>
+
+namespace mdl {
+namespace concurrent {
+
+  /**
+   * Gets told when the thread it's installed on is about to park, and when it's done. The 
+   * library's blocking calls (Future::Get, BlockingQueue::Poll, Semaphore::Down and their 
+   * variants) do the telling; ExecutorService installs one on its workers so that it can start 
+   * a compensating worker while a task blocks. FiberScheduler installs one that yields instead.
+   */
+  class ManagedBlocker {
+    public:
+      // Wakes up a thread waiting in YieldUntil. Can be called from any thread, any number of 
+      //  times, even once the wait is over.
+      typedef std::function<void ()> Waker;
+
+      virtual ~ManagedBlocker() = default;
+
+      virtual void BeginBlocking() = 0;
+      virtual void EndBlocking() = 0;
+
+      // Whether the thread can run other work instead of parking. True on fibers.
+      virtual bool CanYield() const { return false; }
+      // Runs other work until ready returns true, for blockers that CanYield. ready gets a Waker
+      //  to leave wherever what it waits for happens, and isn't looked at again until that (or 
+      //  a stale Waker) is called. Gives up once timeoutMillis pass, unless negative, returning 
+      //  false. Exceptions thrown by ready propagate. May return on another thread.
+      virtual bool YieldUntil(const std::function<bool (const Waker&)>&, long) { return false; }
+  };
+
+  // Blocker of the calling thread, if any.
+  extern thread_local ManagedBlocker* _managed_blocker;
+
+  // Blocker of the calling thread, if it can yield.
+  inline ManagedBlocker* _yielding_blocker() {
+    ManagedBlocker* blocker = _managed_blocker;
+    return blocker && blocker->CanYield() ? blocker : nullptr;
+  }
+
+  /**
+   * Marks its scope as one where the calling thread may park, for code that blocks in ways the
+   * library doesn't know about, like I/O. Does nothing unless a ManagedBlocker is installed. 
+   * Nested blocks only tell the blocker once.
+   */
+  class ManagedBlock {
+    public:
+      ManagedBlock(bool blocking = true) : blocker(blocking ? _managed_blocker : nullptr) {
+        if (blocker) {
+          _managed_blocker = nullptr;
+          blocker->BeginBlocking();
+        }
+      }
+      ManagedBlock(const ManagedBlock& other) = delete;
+      ManagedBlock(ManagedBlock&& other) = delete;
+      ~ManagedBlock() {
+        if (blocker) {
+          blocker->EndBlocking();
+          _managed_blocker = blocker;
+        }
+      }
+      ManagedBlock& operator=(const ManagedBlock& other) = delete;
+      ManagedBlock& operator=(ManagedBlock&& other) = delete;
+
+    private:
+      ManagedBlocker* blocker;
+  };
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_MANAGED_BLOCKING
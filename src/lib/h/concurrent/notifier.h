@@ -0,0 +1,66 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#ifndef _MDL_CONCURRENT_NOTIFIER
+#define _MDL_CONCURRENT_NOTIFIER
+
+namespace mdl {
+namespace concurrent {
+
+  /**
+   * File descriptor that turns readable once signalled, and stays so until reset: an eventfd on 
+   * Linux, a pipe elsewhere. Lets poll, select, epoll or a Reactor wait on things that aren't 
+   * file descriptors, along with things that are.
+   */
+  class EventNotifier {
+    public:
+      // Throws std::runtime_error if the file descriptor can't be created.
+      EventNotifier();
+      EventNotifier(const EventNotifier& other) = delete;
+      EventNotifier(EventNotifier&& other) = delete;
+      ~EventNotifier();
+      EventNotifier& operator=(const EventNotifier& other) = delete;
+      EventNotifier& operator=(EventNotifier&& other) = delete;
+
+      int Fd() const;
+      void Signal();
+      void Reset();
+
+      // Waits for any of notifiers to be signalled, up to timeoutMillis, or for ever if that's 
+      //  negative. Returns the index of one that is, or -1 on timeout.
+      static int WaitAny(EventNotifier* const* notifiers, int count, long timeoutMillis);
+
+    private:
+      // Read and write ends. The same eventfd on Linux.
+      int readFd;
+      int writeFd;
+  };
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_NOTIFIER
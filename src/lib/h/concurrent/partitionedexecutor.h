@@ -0,0 +1,191 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _MDL_CONCURRENT_PARTITIONED_EXECUTOR
+#define _MDL_CONCURRENT_PARTITIONED_EXECUTOR
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../util/time.h"
+#include "cancellation.h"
+#include "executors.h"
+#include "future.h"
+#include "sharedsynchronizable.h"
+#include "spinwait.h"
+#include "syncqueue.h"
+#include "thread.h"
+
+namespace mdl {
+namespace concurrent {
+
+  struct PartitionedExecutorOptions {
+    // Number of partitions, each with a worker thread and a queue of its own.
+    int partitions = 1;
+    // Keys hash to buckets, and buckets are what gets assigned to partitions. More buckets 
+    //  make for finer grained rebalancing.
+    int bucketsPerPartition = 16;
+    // Rebalances from Execute at most this often. Zero only rebalances when asked to.
+    long rebalanceMillis = 0;
+    // A partition is hot when its recent load is this many times the average.
+    double hotRatio = 1.5;
+    // How idle workers wait for new tasks. See WaitPolicy::LowLatency.
+    WaitPolicy waitPolicy;
+  };
+
+  struct PartitionStats {
+    int buckets = 0;
+    // Tasks waiting in the queue.
+    long queued = 0;
+    long executed = 0;
+    // Time spent running tasks, and time tasks spent in the queue before that.
+    long busyMicros = 0;
+    long waitMicros = 0;
+  };
+
+  /**
+   * Runs every task for a given key on the same worker, in the order they were submitted, so 
+   * that state kept per key stays in that worker's cache and needs no locking. Keys hash to a 
+   * fixed set of buckets, which are spread over the partitions. Rebalancing moves buckets away
+   * from partitions that got hot, but only buckets with no task queued or running, which keeps
+   * per key ordering intact.
+   */
+  class PartitionedExecutor {
+    public:
+      PartitionedExecutor(int partitions, ThreadFactory& threadFactory);
+      PartitionedExecutor(const PartitionedExecutorOptions& options, ThreadFactory& threadFactory);
+      PartitionedExecutor(const PartitionedExecutor& other) = delete;
+      PartitionedExecutor(PartitionedExecutor&& other) = delete;
+      virtual ~PartitionedExecutor();
+      PartitionedExecutor& operator=(const PartitionedExecutor& other) = delete;
+      PartitionedExecutor& operator=(PartitionedExecutor&& other) = delete;
+
+      template <class K>
+      void Execute(const K& key, const std::function<void ()>& task);
+
+      template <class T, class K>
+      Future<T> Submit(const K& key, const std::function<T ()>& task);
+
+      template <class T, class K>
+      Future<T> Submit(const K& key, const std::function<T (const CancellationToken&)>& task);
+
+      // Partition tasks for key go to right now.
+      template <class K>
+      int PartitionOf(const K& key);
+
+      // Moves idle buckets off hot partitions. Returns how many were moved.
+      int Rebalance();
+      std::vector<PartitionStats> Stats() const;
+
+      void Shutdown();
+      int NumPartitions() const;
+
+    private:
+      struct Task {
+        std::function<void ()> fn;
+        util::instant enqueued;
+        int bucket;
+      };
+
+      struct alignas(64) Partition {
+        BlockingQueue<Task> queue;
+        Thread thread;
+        std::atomic_long executed = 0;
+        std::atomic_long busyMicros = 0;
+        std::atomic_long waitMicros = 0;
+
+        Partition(const WaitPolicy& policy) : queue(policy) {}
+      };
+
+      struct Bucket {
+        std::atomic_int partition;
+        // Tasks queued or running. Only buckets at zero may move.
+        std::atomic_long pending = 0;
+        // Tasks submitted lately, halved on every rebalance.
+        std::atomic_long recent = 0;
+      };
+
+      PartitionedExecutorOptions options;
+      std::vector<std::unique_ptr<Partition>> partitions;
+      std::unique_ptr<Bucket[]> buckets;
+      int numBuckets;
+      // Read locked to route a task, write locked to move buckets.
+      SharedSynchronizable routing;
+      std::atomic<util::instant> lastRebalance;
+      std::atomic_bool shutdown = false;
+      std::atomic_int numRunning = 0;
+
+      int BucketOf(std::size_t hash) const;
+      void Enqueue(int bucket, std::function<void ()>&& fn);
+      void WorkerThreadFn(Partition* partition);
+  };
+
+  template <class K>
+  void PartitionedExecutor::Execute(const K& key, const std::function<void ()>& task) {
+    Enqueue(BucketOf(std::hash<K>()(key)), [task]() {
+      try {
+        task();
+      } catch (...) {}
+    });
+  }
+
+  template <class T, class K>
+  Future<T> PartitionedExecutor::Submit(const K& key, const std::function<T ()>& task) {
+    Future<T> future;
+    Enqueue(BucketOf(std::hash<K>()(key)), [future, task]() mutable {
+      ExecutorService::RunTask(future, task);
+    });
+    return future;
+  }
+
+  template <class T, class K>
+  Future<T> PartitionedExecutor::Submit(
+      const K& key, const std::function<T (const CancellationToken&)>& task) {
+    Future<T> future;
+    CancellationToken token = future.Cooperate();
+    Enqueue(BucketOf(std::hash<K>()(key)), [future, task, token]() mutable {
+      ExecutorService::RunTask<T>(future, [&task, &token]() { return task(token); });
+    });
+    return future;
+  }
+
+  template <class K>
+  int PartitionedExecutor::PartitionOf(const K& key) {
+    int bucket = BucketOf(std::hash<K>()(key));
+    return routing.SynchronizedRead<int>([this, bucket]() {
+      return buckets[bucket].partition.load();
+    });
+  }
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_PARTITIONED_EXECUTOR
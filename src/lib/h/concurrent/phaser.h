@@ -0,0 +1,96 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _MDL_CONCURRENT_PHASER
+#define _MDL_CONCURRENT_PHASER
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#include "futex.h"
+#include "spinwait.h"
+
+namespace mdl {
+namespace concurrent {
+
+  /**
+   * Like Barrier, but parties can register and deregister at any time, and can arrive without
+   * waiting for the others. Phase numbers go up to INT_MAX and then wrap around to zero.
+   */
+  class Phaser {
+    public:
+      // onAdvance gets the number of the phase that just ended, and runs before anyone waiting
+      //  on it is released.
+      Phaser(int parties = 0, std::function<void (int)> onAdvance = nullptr, 
+          const WaitPolicy& policy = WaitPolicy());
+      Phaser(const Phaser& other) = delete;
+      Phaser(Phaser&& other) = delete;
+
+      Phaser& operator=(const Phaser& other) = delete;
+      Phaser& operator=(Phaser&& other) = delete;
+
+      // Adds parties to the current phase, which won't end until they arrive. Returns the 
+      //  phase joined. Waits if the current phase is in the middle of ending.
+      int Register(int parties = 1);
+
+      // Returns the phase arrived at, without waiting for it to end.
+      int Arrive();
+      int ArriveAndDeregister();
+      // Returns the phase that comes after the one arrived at.
+      int ArriveAndAwaitAdvance();
+
+      // Waits until the current phase is no longer phase. Returns right away if it already 
+      //  isn't. Returns the current phase.
+      int AwaitAdvance(int phase);
+      // Same as AwaitAdvance(), but gives up after timeoutMillis. Returns false if it timed out.
+      bool AwaitAdvance(int phase, long timeoutMillis);
+
+      int Phase() const;
+      int RegisteredParties() const;
+      int UnarrivedParties() const;
+
+    private:
+      // Phase in the upper half, registered parties and parties yet to arrive in 16 bits each.
+      //  No unarrived parties out of some registered ones means the phase is ending, and so does
+      //  the top bit once the last party deregistered.
+      std::atomic<uint64_t> state;
+      // Bumped every time a phase ends. It's what waiters sleep on.
+      futex_t advances = 0;
+      std::atomic_int waiters = 0;
+      std::function<void (int)> onAdvance;
+      SpinWait spinWait;
+
+      int DoArrive(bool deregister);
+      void Advance(uint64_t ending);
+  };
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_PHASER
@@ -0,0 +1,526 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _MDL_CONCURRENT_PIPELINE
+#define _MDL_CONCURRENT_PIPELINE
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "../util/time.h"
+#include "cancellation.h"
+#include "exception.h"
+#include "synchronizable.h"
+#include "syncqueue.h"
+#include "thread.h"
+
+namespace mdl {
+namespace concurrent {
+
+  struct StageOptions {
+    // Workers running the stage function at once.
+    int parallelism = 1;
+    // Results the stage may have queued for the next one before its workers block.
+    int capacity = 64;
+    // Emits results in the order items came in. Otherwise, as soon as each one is ready.
+    bool ordered = true;
+  };
+
+  struct StageStats {
+    std::string name;
+    int parallelism = 0;
+    long processed = 0;
+    // Items waiting in front of the stage.
+    int queued = 0;
+    // Summed over workers: running the stage function, waiting for input, and waiting for 
+    //  room downstream. The stage with the least idle time is the bottleneck.
+    long busyMicros = 0;
+    long idleMicros = 0;
+    long blockedMicros = 0;
+    // Items processed per second since the pipeline started.
+    double throughput = 0;
+  };
+
+  // State shared by every stage of a pipeline: whether and how it failed.
+  class _PipelineContext {
+    public:
+      _PipelineContext();
+
+      CancellationToken Token() const;
+      void Start();
+      util::instant Started() const;
+
+      // The first failure wins, and cancels every stage.
+      void Fail(const std::string& msg, int errorCode);
+      void FailWithCurrentException(const std::string& stage);
+      // Throws execution_exception with the failure. Must only be called after one.
+      [[noreturn]] void ThrowFailure();
+
+    private:
+      CancellationSource source;
+      Synchronizable sync;
+      std::string errorMsg;
+      int errorCode = 0;
+      util::instant started;
+  };
+
+  template <class T>
+  struct _PipelineItem {
+    long seq = 0;
+    // Nothing here marks the end of the stream.
+    std::optional<T> value;
+  };
+
+  template <class T>
+  struct _PipelineChannel {
+    BlockingQueue<_PipelineItem<T>> queue;
+    std::atomic_long nextSeq = 0;
+    // Set while the pipeline is built. The last producer to finish sends one end of stream 
+    //  marker per consumer.
+    std::atomic_int producers = 1;
+    int consumers = 1;
+
+    _PipelineChannel(int capacity) : queue(capacity) {}
+
+    void Put(long seq, T&& value, const CancellationToken& token) {
+      queue.Add(_PipelineItem<T> { seq, std::move(value) }, token);
+    }
+
+    void PutNext(T&& value, const CancellationToken& token) {
+      Put(nextSeq++, std::move(value), token);
+    }
+
+    void ProducerDone(const CancellationToken& token) {
+      if (--producers > 0) { return; }
+      for (int i = 0; i < consumers; i++) {
+        queue.Add(_PipelineItem<T>(), token);
+      }
+    }
+  };
+
+  class _PipelineStage {
+    public:
+      _PipelineStage(const std::string& name, int parallelism, 
+          const std::shared_ptr<_PipelineContext>& context);
+      _PipelineStage(const _PipelineStage& other) = delete;
+      virtual ~_PipelineStage();
+
+      void Start(ThreadFactory& threadFactory);
+      void Join();
+      StageStats Stats() const;
+
+    protected:
+      std::shared_ptr<_PipelineContext> context;
+      CancellationToken token;
+      std::atomic_long processed = 0;
+      std::atomic_long busyMicros = 0;
+      std::atomic_long idleMicros = 0;
+      std::atomic_long blockedMicros = 0;
+
+      // Body of each worker. Returns at the end of the stream.
+      virtual void Run() = 0;
+      virtual int Queued() const = 0;
+
+      static long Since(util::instant& start);
+
+    private:
+      std::string name;
+      int parallelism;
+      std::vector<Thread> threads;
+
+      void WorkerThreadFn();
+  };
+
+  template <class In, class Out>
+  class _MapStage : public _PipelineStage {
+    public:
+      _MapStage(const std::string& name, const std::function<Out (In)>& fn, 
+          const StageOptions& options, const std::shared_ptr<_PipelineContext>& context, 
+          const std::shared_ptr<_PipelineChannel<In>>& input, 
+          const std::shared_ptr<_PipelineChannel<Out>>& output)
+          : _PipelineStage(name, options.parallelism, context), fn(fn), 
+            ordered(options.ordered), window(std::max(2 * options.parallelism, options.capacity)),
+            input(input), output(output) {}
+
+    protected:
+      void Run() override {
+        util::instant start = util::Now();
+        while (true) {
+          _PipelineItem<In> item = input->queue.Poll(token);
+          idleMicros += Since(start);
+          if (!item.value) { break; }
+
+          Out result = fn(std::move(*item.value));
+          busyMicros += Since(start);
+          processed++;
+
+          Emit(item.seq, std::move(result));
+          blockedMicros += Since(start);
+        }
+        output->ProducerDone(token);
+      }
+
+      int Queued() const override {
+        return std::max(0, input->queue.Size());
+      }
+
+    private:
+      std::function<Out (In)> fn;
+      bool ordered;
+      // How far ahead of the oldest missing result a worker may get.
+      long window;
+      std::shared_ptr<_PipelineChannel<In>> input;
+      std::shared_ptr<_PipelineChannel<Out>> output;
+      // Results that came in ahead of their turn.
+      Synchronizable reorder;
+      std::map<long, Out> held;
+      long next = 0;
+      // Set while a worker puts a run of in order results out.
+      bool emitting = false;
+
+      void Emit(long seq, Out&& result) {
+        if (!ordered) {
+          output->PutNext(std::move(result), token);
+          return;
+        }
+
+        // One worker at a time puts results out, in order, but without the lock, so that a full
+        //  output queue doesn't hold up workers that only came to park a result.
+        std::vector<Out> run;
+        long first = reorder.Synchronized<long>([this, seq, &result, &run]() {
+          while (seq - next >= window) { reorder.Wait(token); }
+          held.emplace(seq, std::move(result));
+          return emitting ? -1L : TakeRun(run);
+        });
+
+        while (first >= 0) {
+          for (Out& value : run) { output->Put(first++, std::move(value), token); }
+          run.clear();
+          first = reorder.Synchronized<long>([this, &run]() { return TakeRun(run); });
+        }
+      }
+
+      // Moves the results that are next in line out of held, returning the seq of the first 
+      //  one, or -1 if there's none. Whoever gets a run emits until it comes back empty handed.
+      //  Must be synchronized.
+      long TakeRun(std::vector<Out>& run) {
+        long first = next;
+        for (auto it = held.begin(); it != held.end() && it->first == next; it = held.erase(it)) {
+          run.push_back(std::move(it->second));
+          next++;
+        }
+        emitting = !run.empty();
+        if (!emitting) { return -1; }
+        reorder.NotifyAll();
+        return first;
+      }
+  };
+
+  template <class T>
+  class _BatchStage : public _PipelineStage {
+    public:
+      _BatchStage(int size, long maxDelayMillis, const std::shared_ptr<_PipelineContext>& context,
+          const std::shared_ptr<_PipelineChannel<T>>& input, 
+          const std::shared_ptr<_PipelineChannel<std::vector<T>>>& output)
+          : _PipelineStage("batch", 1, context), size(size), maxDelayMillis(maxDelayMillis), 
+            input(input), output(output) {}
+
+    protected:
+      void Run() override {
+        std::vector<T> batch;
+        util::instant first;
+        util::instant start = util::Now();
+
+        while (true) {
+          _PipelineItem<T> item;
+          if (batch.empty() || maxDelayMillis <= 0) {
+            item = input->queue.Poll(token);
+          } else {
+            long remaining = maxDelayMillis - util::EllapsedTime(first, util::Now()) / 1000L;
+            if (remaining <= 0 || !input->queue.TryPoll(item, remaining)) {
+              token.ThrowIfCancellationRequested();
+              idleMicros += Since(start);
+              Flush(batch);
+              blockedMicros += Since(start);
+              continue;
+            }
+          }
+          idleMicros += Since(start);
+          if (!item.value) { break; }
+
+          if (batch.empty()) { first = util::Now(); }
+          batch.push_back(std::move(*item.value));
+          processed++;
+          if ((int) batch.size() >= size) { 
+            Flush(batch);
+            blockedMicros += Since(start);
+          }
+        }
+
+        if (!batch.empty()) { Flush(batch); }
+        output->ProducerDone(token);
+      }
+
+      int Queued() const override {
+        return std::max(0, input->queue.Size());
+      }
+
+    private:
+      int size;
+      long maxDelayMillis;
+      std::shared_ptr<_PipelineChannel<T>> input;
+      std::shared_ptr<_PipelineChannel<std::vector<T>>> output;
+
+      void Flush(std::vector<T>& batch) {
+        output->PutNext(std::move(batch), token);
+        batch = std::vector<T>();
+        batch.reserve(size);
+      }
+  };
+
+  template <class In, class Out> class PipelineBuilder;
+
+  /**
+   * Multi-stage pipeline, built with PipelineBuilder. Each stage runs on its own workers, and 
+   * hands its results to the next one through a bounded queue, so a slow stage holds back the
+   * ones before it instead of letting work pile up. Items go in through Push() and come out of
+   * Next(). If any stage throws, every stage stops, and both Push() and Next() throw an 
+   * execution_exception describing the first failure.
+   */
+  template <class In, class Out>
+  class Pipeline {
+    public:
+      Pipeline(const Pipeline& other) = delete;
+      Pipeline(Pipeline&& other) = delete;
+      // Cancels whatever is still running.
+      virtual ~Pipeline();
+
+      Pipeline& operator=(const Pipeline& other) = delete;
+      Pipeline& operator=(Pipeline&& other) = delete;
+
+      // Feeds an item in, waiting while the first stage is behind.
+      void Push(In item);
+      // Ends the stream. Results for everything pushed so far still come out of Next().
+      void Close();
+
+      // Takes the next result, waiting for it. Returns false once the stream ended.
+      bool Next(Out& item);
+      void Cancel();
+
+      std::vector<StageStats> Stats() const;
+
+    private:
+      friend class PipelineBuilder<In, Out>;
+
+      std::shared_ptr<_PipelineContext> context;
+      std::shared_ptr<_PipelineChannel<In>> head;
+      std::shared_ptr<_PipelineChannel<Out>> tail;
+      std::vector<std::unique_ptr<_PipelineStage>> stages;
+      std::atomic_bool closed = false;
+      std::atomic_bool ended = false;
+
+      Pipeline(const std::shared_ptr<_PipelineContext>& context, 
+          const std::shared_ptr<_PipelineChannel<In>>& head, 
+          const std::shared_ptr<_PipelineChannel<Out>>& tail,
+          std::vector<std::unique_ptr<_PipelineStage>>&& stages);
+  };
+
+  /**
+   * Builds a Pipeline one stage at a time. Each call returns a builder for the extended 
+   * pipeline, and leaves this one empty:
+   *
+   *   auto pipeline = PipelineBuilder<std::string>(factory)
+   *       .Stage<Record>("parse", parse, parseOptions)
+   *       .Batch(100)
+   *       .Build();
+   */
+  template <class In, class Out = In>
+  class PipelineBuilder {
+    public:
+      // capacity bounds the items pushed in and not yet taken by the first stage.
+      PipelineBuilder(ThreadFactory& threadFactory, int capacity = 64);
+
+      template <class Next>
+      PipelineBuilder<In, Next> Stage(const std::string& name, const std::function<Next (Out)>& fn,
+          const StageOptions& options = StageOptions());
+
+      // Groups results into batches of up to size, flushed when full, at the end of the stream
+      //  and, if maxDelayMillis is set, once the oldest item in it waited that long.
+      PipelineBuilder<In, std::vector<Out>> Batch(int size, long maxDelayMillis = 0, 
+          int capacity = 64);
+
+      // Starts every stage.
+      std::unique_ptr<Pipeline<In, Out>> Build();
+
+    private:
+      template <class, class> friend class PipelineBuilder;
+
+      ThreadFactory* threadFactory;
+      std::shared_ptr<_PipelineContext> context;
+      std::shared_ptr<_PipelineChannel<In>> head;
+      std::shared_ptr<_PipelineChannel<Out>> tail;
+      std::vector<std::unique_ptr<_PipelineStage>> stages;
+
+      PipelineBuilder(ThreadFactory* threadFactory, 
+          const std::shared_ptr<_PipelineContext>& context,
+          const std::shared_ptr<_PipelineChannel<In>>& head, 
+          const std::shared_ptr<_PipelineChannel<Out>>& tail, 
+          std::vector<std::unique_ptr<_PipelineStage>>&& stages) 
+          : threadFactory(threadFactory), context(context), head(head), tail(tail), 
+            stages(std::move(stages)) {}
+  };
+
+  template <class In, class Out>
+  Pipeline<In, Out>::Pipeline(const std::shared_ptr<_PipelineContext>& context, 
+      const std::shared_ptr<_PipelineChannel<In>>& head, 
+      const std::shared_ptr<_PipelineChannel<Out>>& tail,
+      std::vector<std::unique_ptr<_PipelineStage>>&& stages) 
+      : context(context), head(head), tail(tail), stages(std::move(stages)) {}
+
+  template <class In, class Out>
+  Pipeline<In, Out>::~Pipeline() {
+    Cancel();
+    for (auto& stage : stages) { stage->Join(); }
+  }
+
+  template <class In, class Out>
+  void Pipeline<In, Out>::Push(In item) {
+    if (closed) {
+      throw std::logic_error("Can't push into a closed pipeline");
+    }
+    try {
+      head->PutNext(std::move(item), context->Token());
+    } catch (const interrupted_exception& ex) {
+      context->ThrowFailure();
+    }
+  }
+
+  template <class In, class Out>
+  void Pipeline<In, Out>::Close() {
+    if (closed.exchange(true)) { return; }
+    try {
+      head->ProducerDone(context->Token());
+    } catch (const interrupted_exception& ex) {
+      context->ThrowFailure();
+    }
+  }
+
+  template <class In, class Out>
+  bool Pipeline<In, Out>::Next(Out& item) {
+    if (ended) { return false; }
+
+    _PipelineItem<Out> next;
+    try {
+      next = tail->queue.Poll(context->Token());
+    } catch (const interrupted_exception& ex) {
+      context->ThrowFailure();
+    }
+
+    if (!next.value) {
+      if (context->Token().IsCancellationRequested()) { context->ThrowFailure(); }
+      ended = true;
+      // Lets other threads blocked in here know too.
+      tail->queue.TryAdd(_PipelineItem<Out>());
+      return false;
+    }
+    item = std::move(*next.value);
+    return true;
+  }
+
+  template <class In, class Out>
+  void Pipeline<In, Out>::Cancel() {
+    context->Fail("Pipeline cancelled", -1);
+  }
+
+  template <class In, class Out>
+  std::vector<StageStats> Pipeline<In, Out>::Stats() const {
+    std::vector<StageStats> stats;
+    for (auto& stage : stages) { stats.push_back(stage->Stats()); }
+    return stats;
+  }
+
+  template <class In, class Out>
+  PipelineBuilder<In, Out>::PipelineBuilder(ThreadFactory& threadFactory, int capacity) 
+      : threadFactory(&threadFactory), context(std::make_shared<_PipelineContext>()) {
+    static_assert(std::is_same_v<In, Out>, "A pipeline with no stages outputs what it takes in");
+    head = std::make_shared<_PipelineChannel<In>>(capacity);
+    tail = head;
+  }
+
+  template <class In, class Out>
+  template <class Next>
+  PipelineBuilder<In, Next> PipelineBuilder<In, Out>::Stage(const std::string& name, 
+      const std::function<Next (Out)>& fn, const StageOptions& options) {
+    if (options.parallelism < 1) {
+      throw std::invalid_argument("Stage parallelism must be at least 1");
+    }
+
+    auto output = std::make_shared<_PipelineChannel<Next>>(options.capacity);
+    output->producers = options.parallelism;
+    tail->consumers = options.parallelism;
+    stages.push_back(std::make_unique<_MapStage<Out, Next>>(
+        name, fn, options, context, tail, output));
+    return PipelineBuilder<In, Next>(threadFactory, context, head, output, std::move(stages));
+  }
+
+  template <class In, class Out>
+  PipelineBuilder<In, std::vector<Out>> PipelineBuilder<In, Out>::Batch(
+      int size, long maxDelayMillis, int capacity) {
+    if (size < 1) {
+      throw std::invalid_argument("Batch size must be at least 1");
+    }
+
+    auto output = std::make_shared<_PipelineChannel<std::vector<Out>>>(capacity);
+    tail->consumers = 1;
+    stages.push_back(std::make_unique<_BatchStage<Out>>(
+        size, maxDelayMillis, context, tail, output));
+    return PipelineBuilder<In, std::vector<Out>>(
+        threadFactory, context, head, output, std::move(stages));
+  }
+
+  template <class In, class Out>
+  std::unique_ptr<Pipeline<In, Out>> PipelineBuilder<In, Out>::Build() {
+    tail->consumers = 1;
+    context->Start();
+    for (auto& stage : stages) { stage->Start(*threadFactory); }
+    return std::unique_ptr<Pipeline<In, Out>>(
+        new Pipeline<In, Out>(context, head, tail, std::move(stages)));
+  }
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_PIPELINE
@@ -0,0 +1,86 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _MDL_CONCURRENT_RATE_LIMITER
+#define _MDL_CONCURRENT_RATE_LIMITER
+
+#include <atomic>
+#include <cstdint>
+
+#include "../util/time.h"
+
+namespace mdl {
+namespace concurrent {
+
+  /**
+   * Token bucket that hands out permits at a steady rate, letting up to burst of them through 
+   * at once after a quiet period. Implemented as a generic cell rate algorithm: all its state 
+   * is the time at which the bucket would be full again, moved forward with a compare-exchange
+   * as permits are taken, so there's no refill thread and no lock. Callers that get ahead of 
+   * the rate sleep until their turn.
+   */
+  class RateLimiter {
+    public:
+      RateLimiter(double permitsPerSecond, long burst = 1);
+      RateLimiter(const RateLimiter& other) = delete;
+      RateLimiter(RateLimiter&& other) = delete;
+
+      RateLimiter& operator=(const RateLimiter& other) = delete;
+      RateLimiter& operator=(RateLimiter&& other) = delete;
+
+      // Waits until permits can be taken, and takes them. Asking for more than burst works, 
+      //  it only waits longer. Returns the time waited, in microseconds.
+      long Acquire(long permits = 1);
+      // Same as Acquire(), but gives up, taking nothing, if it would have to wait longer than 
+      //  timeoutMillis. Doesn't wait at all in that case.
+      bool TryAcquire(long permits = 1, long timeoutMillis = 0);
+
+      // Applies to permits taken from now on. 
+      void SetRate(double permitsPerSecond);
+      double Rate() const;
+      long Burst() const;
+
+    private:
+      util::instant origin;
+      long burst;
+      // Nanoseconds between two permits.
+      std::atomic<int64_t> interval;
+      // Nanoseconds since origin until the next permit is due, assuming the bucket was empty.
+      std::atomic<int64_t> due;
+
+      int64_t Elapsed() const;
+      // Takes permits if that means waiting no longer than maxWait. Returns the nanoseconds 
+      //  to wait, or a negative number if it didn't take them.
+      int64_t Reserve(long permits, int64_t maxWait);
+      static int64_t Interval(double permitsPerSecond);
+  };
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_RATE_LIMITER
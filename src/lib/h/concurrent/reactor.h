@@ -0,0 +1,192 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#ifndef _MDL_CONCURRENT_REACTOR
+#define _MDL_CONCURRENT_REACTOR
+
+#ifdef __linux__
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include "../util/time.h"
+#include "cancellation.h"
+#include "executors.h"
+#include "future.h"
+#include "synchronizable.h"
+
+namespace mdl {
+namespace concurrent {
+
+  // What a Reactor watches file descriptors for. Masks combine these with |.
+  enum IoEvent {
+    kReadable = 1,
+    kWritable = 2,
+    // The other end hung up. Reported whether asked for or not.
+    kHangup = 4,
+    kError = 8
+  };
+
+  /**
+   * Event loop over epoll, on a thread of its own (Linux only). Calls back when file descriptors
+   * become ready, when timers expire, and for work posted to it. Callbacks run one at a time on
+   * the loop thread and should be quick: anything heavy belongs on an ExecutorService, which is
+   * what the WhenReady overload taking one is for. Readiness is level triggered, so a callback 
+   * keeps getting called for as long as there's something for it to read or room to write.
+   * Exceptions thrown by callbacks are dropped, so the loop carries on; NumFailedCallbacks 
+   * counts them.
+   */
+  class Reactor {
+    public:
+      typedef std::function<void (int)> IoCallback;
+
+      Reactor(const std::string& name = "reactor");
+      Reactor(const Reactor& other) = delete;
+      Reactor(Reactor&& other) = delete;
+      // Stops the loop, waiting for it. Registered file descriptors are left open. Must not 
+      //  run on the loop: that terminates the program.
+      virtual ~Reactor();
+      Reactor& operator=(const Reactor& other) = delete;
+      Reactor& operator=(Reactor&& other) = delete;
+
+      // Calls fn from the loop, with the IoEvents fd is ready for, until Remove. Throws 
+      //  std::runtime_error if fd can't be watched, e.g. because it already is.
+      void Add(int fd, int events, IoCallback&& fn);
+      void Modify(int fd, int events);
+      // Once this returns, fn is neither running nor called again, unless this is called from 
+      //  fn itself. Returns false if fd wasn't registered.
+      bool Remove(int fd);
+
+      // Runs fn on the loop after delayMillis, then every periodMillis if that's positive. 
+      //  Returns an id for Cancel.
+      long Schedule(long delayMillis, std::function<void ()>&& fn, long periodMillis = 0);
+      // Returns false if the timer already fired for good, or was cancelled. One firing right 
+      //  now may still run.
+      bool Cancel(long timerId);
+
+      // Runs fn on the loop, soon. Safe from any thread, the loop included.
+      void Post(std::function<void ()>&& fn);
+      bool InLoop() const;
+      // Stops the loop, dropping whatever it hasn't run yet. Waits for it, unless called from it.
+      void Stop();
+      // Callbacks that threw so far, of any kind.
+      long NumFailedCallbacks() const;
+
+      // Completes with the IoEvents fd is ready for, the first time it is. fd must not be 
+      //  registered otherwise until then. Cancelling the future unregisters it.
+      Future<int> WhenReady(int fd, int events);
+      // Same as above, but completes with what fn returns for those events. fn runs on 
+      //  executor, keeping the loop free for other I/O.
+      template <class T>
+      Future<T> WhenReady(
+          int fd, int events, ExecutorService& executor, const std::function<T (int)>& fn);
+      // Completes after delayMillis.
+      Future<void> After(long delayMillis);
+
+    private:
+      struct Handler {
+        long id;
+        int fd;
+        IoCallback fn;
+        // Unregisters fd when the future waiting on it is cancelled.
+        CancellationRegistration cancellation;
+      };
+
+      struct Timer {
+        long periodMillis;
+        std::shared_ptr<std::function<void ()>> fn;
+      };
+
+      int epollFd;
+      // Written to by Post and Stop, to wake the loop.
+      int wakeFd;
+      // Armed for the earliest timer.
+      int timerFd;
+      Synchronizable sync;
+      std::unordered_map<int, std::shared_ptr<Handler>> handlers;
+      // Handler whose callback is running, so that Remove can wait for it.
+      std::shared_ptr<Handler> running;
+      std::deque<std::function<void ()>> posted;
+      // Timers by deadline then id, and deadlines by id.
+      std::map<std::pair<util::instant, long>, Timer> timers;
+      std::unordered_map<long, util::instant> deadlines;
+      std::atomic_long nextId = 0;
+      std::atomic_long numFailedCallbacks = 0;
+      std::atomic_bool stopping = false;
+      std::once_flag joined;
+      std::thread loop;
+
+      std::shared_ptr<Handler> AddHandler(long id, int fd, int events, IoCallback&& fn);
+      // Removes fd's handler, or only the one with that id when id is positive.
+      bool RemoveHandler(int fd, long id);
+      // Registers a one off handler that calls complete, and that goes away if token fires.
+      void Watch(int fd, int events, IoCallback&& complete, const CancellationToken& token);
+      void Wake();
+      // Must be synchronized.
+      void ArmTimer();
+      void LoopFn();
+      void Dispatch(int fd, std::uint32_t events);
+      void RunCallback(const std::function<void ()>& fn);
+      void RunPosted();
+      void RunTimers();
+  };
+
+  template <class T>
+  Future<T> Reactor::WhenReady(
+      int fd, int events, ExecutorService& executor, const std::function<T (int)>& fn) {
+    Promise<T> promise;
+    Future<T> future = promise.GetFuture();
+    Watch(fd, events, [&executor, promise, fn](int ready) mutable {
+      try {
+        executor.Execute([promise, fn, ready]() mutable {
+          promise.Run([&fn, ready]() { return fn(ready); });
+        });
+      } catch (...) {
+        // e.g. rejected: fails the future, rather than going unnoticed on the loop.
+        std::exception_ptr error = std::current_exception();
+        promise.Run([error]() -> T { std::rethrow_exception(error); });
+      }
+    }, promise.Token());
+    return future;
+  }
+
+} // concurrent
+} // mdl
+
+#endif // __linux__
+
+#endif // _MDL_CONCURRENT_REACTOR
@@ -0,0 +1,318 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _MDL_CONCURRENT_RECLAMATION
+#define _MDL_CONCURRENT_RECLAMATION
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mdl {
+namespace concurrent {
+
+  // An object unlinked from a lock free structure, waiting until no reader can still see it.
+  struct _Retired {
+    void* ptr;
+    void (*deleter)(void*);
+    long epoch;
+  };
+
+  // Per thread state of a reclamation domain.
+  struct _ReclaimRecord {
+    std::atomic_bool inUse = true;
+    _ReclaimRecord* next = nullptr;
+    // Only touched by the thread owning the record.
+    std::vector<_Retired> retired;
+
+    virtual ~_ReclaimRecord() {}
+  };
+
+  // Every record of a domain. Threads claim one on first use, and give it back when they exit,
+  //  handing over whatever they still had retired. Records are reused, never freed before the 
+  //  registry, so it's safe to walk them at any time. Threads only keep weak references to 
+  //  registries, which go away with their domain.
+  class _ReclaimRegistry : public std::enable_shared_from_this<_ReclaimRegistry> {
+    public:
+      _ReclaimRegistry(std::function<_ReclaimRecord* ()>&& newRecord);
+      _ReclaimRegistry(const _ReclaimRegistry& other) = delete;
+      ~_ReclaimRegistry();
+
+      _ReclaimRegistry& operator=(const _ReclaimRegistry& other) = delete;
+
+      _ReclaimRecord& Local();
+      _ReclaimRecord* Head() const;
+      // Moves objects retired by threads that exited into retired, unless another thread is 
+      //  already at it.
+      void AdoptOrphans(std::vector<_Retired>& retired);
+      // Frees everything retired. Nobody may be using the domain anymore.
+      void FreeAll();
+      void Release(_ReclaimRecord* record);
+
+    private:
+      // Unlike its address, never reused by another registry.
+      const long id;
+      std::atomic<_ReclaimRecord*> head = nullptr;
+      std::function<_ReclaimRecord* ()> newRecord;
+      std::mutex orphansMutex;
+      std::vector<_Retired> orphans;
+
+      _ReclaimRecord* Claim();
+  };
+
+  /**
+   * Epoch based memory reclamation, for lock free structures. Readers enter a critical section
+   * with a Guard, which costs a store and a fence, and never waits. Writers unlink objects and
+   * Retire() them instead of deleting them, and every retireThreshold of those, the retiring 
+   * thread tries to move the global epoch forward and frees whatever was retired two epochs 
+   * ago, as no reader can still be looking at it. A reader stuck inside a Guard holds back all
+   * reclamation, so guards must be short lived. See HazardPointerDomain when that matters.
+   */
+  class EpochDomain {
+    private:
+      struct Record;
+
+    public:
+      // Reentrant critical section. Pointers loaded from the structure while it's alive stay 
+      //  valid until it's gone.
+      class Guard {
+        public:
+          Guard(EpochDomain& domain = EpochDomain::Default());
+          Guard(const Guard& other) = delete;
+          Guard(Guard&& other) = delete;
+          ~Guard();
+
+          Guard& operator=(const Guard& other) = delete;
+          Guard& operator=(Guard&& other) = delete;
+        private:
+          Record& record;
+      };
+
+      EpochDomain(int retireThreshold = 64);
+      EpochDomain(const EpochDomain& other) = delete;
+      EpochDomain(EpochDomain&& other) = delete;
+      // Frees everything retired. No thread may be using the domain anymore.
+      ~EpochDomain();
+
+      EpochDomain& operator=(const EpochDomain& other) = delete;
+      EpochDomain& operator=(EpochDomain&& other) = delete;
+
+      static EpochDomain& Default();
+
+      template <class T>
+      void Retire(T* ptr);
+      void Retire(void* ptr, void (*deleter)(void*));
+
+      // Waits for every reader that was inside a Guard when called, then frees what this thread 
+      //  retired. Must not be called from inside a Guard.
+      void Synchronize();
+      long Epoch() const;
+
+    private:
+      friend class Guard;
+
+      std::atomic_long epoch = 1;
+      int retireThreshold;
+      std::shared_ptr<_ReclaimRegistry> registry;
+
+      Record& Local();
+      bool TryAdvance();
+      void Collect(Record& record);
+  };
+
+  /**
+   * Hazard pointer based memory reclamation, for lock free structures. Unlike EpochDomain, a 
+   * stalled reader only keeps the few objects it points at from being freed, at the cost of a
+   * store, a fence and a reload on every pointer a reader protects. Each thread has kSlots
+   * hazards to hold at once.
+   */
+  class HazardPointerDomain {
+    private:
+      struct Record;
+
+    public:
+      static constexpr int kSlots = 4;
+
+      // Takes one of the thread's hazard slots while alive.
+      class Hazard {
+        public:
+          Hazard(HazardPointerDomain& domain = HazardPointerDomain::Default());
+          Hazard(const Hazard& other) = delete;
+          Hazard(Hazard&& other) = delete;
+          ~Hazard();
+
+          Hazard& operator=(const Hazard& other) = delete;
+          Hazard& operator=(Hazard&& other) = delete;
+
+          // Loads src, keeping what it points at from being freed until this is reset, 
+          //  destroyed or used to protect something else.
+          template <class T>
+          T* Protect(const std::atomic<T*>& src);
+          void Reset();
+
+        private:
+          Record& record;
+          int index;
+
+          void Set(void* ptr);
+      };
+
+      HazardPointerDomain(int retireThreshold = 64);
+      HazardPointerDomain(const HazardPointerDomain& other) = delete;
+      HazardPointerDomain(HazardPointerDomain&& other) = delete;
+      // Frees everything retired. No thread may be using the domain anymore.
+      ~HazardPointerDomain();
+
+      HazardPointerDomain& operator=(const HazardPointerDomain& other) = delete;
+      HazardPointerDomain& operator=(HazardPointerDomain&& other) = delete;
+
+      static HazardPointerDomain& Default();
+
+      template <class T>
+      void Retire(T* ptr);
+      void Retire(void* ptr, void (*deleter)(void*));
+
+      // Frees whatever this thread retired that no hazard points at.
+      void Collect();
+
+    private:
+      friend class Hazard;
+
+      int retireThreshold;
+      std::shared_ptr<_ReclaimRegistry> registry;
+
+      Record& Local();
+  };
+
+  /**
+   * Holds a value that's read all the time and replaced now and then, such as configuration, 
+   * read-copy-update style. Readers get a consistent snapshot without taking any lock or ever 
+   * waiting, while writers publish a whole new copy and retire the old one to an EpochDomain,
+   * which frees it once the last reader is done with it.
+   */
+  template <class T>
+  class AtomicSharedSnapshot {
+    public:
+      // Keeps the value it was taken from alive while in scope. Should be short lived, like any
+      //  EpochDomain::Guard.
+      class Snapshot {
+        public:
+          Snapshot(const Snapshot& other) = delete;
+          Snapshot(Snapshot&& other) = delete;
+
+          Snapshot& operator=(const Snapshot& other) = delete;
+          Snapshot& operator=(Snapshot&& other) = delete;
+
+          const T& operator*() const { return *value; }
+          const T* operator->() const { return value; }
+          const T* Get() const { return value; }
+
+        private:
+          friend class AtomicSharedSnapshot<T>;
+
+          EpochDomain::Guard guard;
+          const T* value;
+
+          Snapshot(EpochDomain& domain, const std::atomic<T*>& src) 
+              : guard(domain), value(src.load(std::memory_order_acquire)) {}
+      };
+
+      AtomicSharedSnapshot(const T& initial = T(), EpochDomain& domain = EpochDomain::Default())
+          : AtomicSharedSnapshot(std::make_unique<T>(initial), domain) {}
+      AtomicSharedSnapshot(std::unique_ptr<T> initial, 
+          EpochDomain& domain = EpochDomain::Default()) 
+          : domain(domain), current(initial.release()) {}
+      AtomicSharedSnapshot(const AtomicSharedSnapshot& other) = delete;
+      AtomicSharedSnapshot(AtomicSharedSnapshot&& other) = delete;
+      // Readers must be done with it.
+      ~AtomicSharedSnapshot() { delete current.load(); }
+
+      AtomicSharedSnapshot& operator=(const AtomicSharedSnapshot& other) = delete;
+      AtomicSharedSnapshot& operator=(AtomicSharedSnapshot&& other) = delete;
+
+      Snapshot Read() const { return Snapshot(domain, current); }
+      T Load() const { return *Read(); }
+
+      void Store(const T& value) { Store(std::make_unique<T>(value)); }
+      void Store(std::unique_ptr<T> value) {
+        domain.Retire(current.exchange(value.release(), std::memory_order_acq_rel));
+      }
+
+      // Applies fn to a copy of the current value and publishes it. If another writer got in 
+      //  first, starts over from its value, so fn may run more than once.
+      void Update(const std::function<void (T&)>& fn);
+
+    private:
+      EpochDomain& domain;
+      std::atomic<T*> current;
+  };
+
+  template <class T>
+  void EpochDomain::Retire(T* ptr) {
+    Retire(ptr, [](void* ptr) { delete static_cast<T*>(ptr); });
+  }
+
+  template <class T>
+  void HazardPointerDomain::Retire(T* ptr) {
+    Retire(ptr, [](void* ptr) { delete static_cast<T*>(ptr); });
+  }
+
+  template <class T>
+  T* HazardPointerDomain::Hazard::Protect(const std::atomic<T*>& src) {
+    T* ptr = src.load(std::memory_order_relaxed);
+    while (true) {
+      Set(ptr);
+      // Still there after the hazard became visible, so nobody could have retired it before
+      //  seeing the hazard.
+      T* again = src.load(std::memory_order_acquire);
+      if (again == ptr) { return ptr; }
+      ptr = again;
+    }
+  }
+
+  template <class T>
+  void AtomicSharedSnapshot<T>::Update(const std::function<void (T&)>& fn) {
+    while (true) {
+      EpochDomain::Guard guard(domain);
+      T* expected = current.load(std::memory_order_acquire);
+      std::unique_ptr<T> next = std::make_unique<T>(*expected);
+      fn(*next);
+      if (current.compare_exchange_strong(expected, next.get(), std::memory_order_acq_rel)) {
+        next.release();
+        domain.Retire(expected);
+        return;
+      }
+    }
+  }
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_RECLAMATION
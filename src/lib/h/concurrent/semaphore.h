@@ -30,7 +30,12 @@
 #define _MDL_CONCURRENT_SEMAPHORE
 
 #include <atomic>
+#include <map>
+#include <optional>
+#include <string>
+#include <type_traits>
 
+#include "managedblocking.h"
 #include "synchronizable.h"
 
 namespace mdl {
@@ -39,6 +44,9 @@ namespace concurrent {
   class Semaphore {
     public:
       Semaphore(long tickets = 0);
+      Semaphore(long tickets, const WaitPolicy& policy);
+      // name identifies this semaphore in LockProfiler reports.
+      Semaphore(const std::string& name, long tickets = 0, const WaitPolicy& policy = WaitPolicy());
       Semaphore(const Semaphore& tickets) = delete;
       Semaphore(Semaphore&& other) = delete;
 
@@ -50,27 +58,100 @@ namespace concurrent {
       template<class T>
       T Up(std::function<T (long)>&& doBeforeFn);
       
+      // Tells the thread's ManagedBlocker, if any, when no ticket is available. So does TryDown, 
+      //  when given a timeout. On fibers, these yield until Up wakes them up instead.
       void Down();
 
       template<class T>
       T Down(std::function<T (long)>&& doAfterFn);
 
+      // Same as Down(), but gives up, throwing interrupted_exception, once token fires.
+      void Down(const CancellationToken& token);
+
+      template<class T>
+      T Down(const CancellationToken& token, std::function<T (long)>&& doAfterFn);
+
+      // Same as Down(), but gives up after timeoutMillis. Returns false (and does not call 
+      //  doAfterFn) if no ticket became available in time.
+      bool TryDown(long timeoutMillis);
+      bool TryDown(long timeoutMillis, std::function<void (long)>&& doAfterFn);
+
       long NumTickets() const;
+
+      // Runs fn under the same lock Up and Down run theirs, without taking or releasing tickets.
+      template<class T>
+      T Inspect(std::function<T (long)>&& fn);
       
       void InterruptAll();
     private:
+      // A negative number of tickets is the number of threads waiting in Down.
       std::atomic_long tickets;
+      // Tickets handed by Up to threads still waiting in Down, but which haven't woken up yet.
+      //  Waiters only leave when they can take one of these, which makes them immune to 
+      //  spurious wake ups and to notifications meant for a waiter that timed out.
+      long wakeups = 0;
       Synchronizable sync;
+      // Bumped by InterruptAll, for fibers, which don't wait on sync.
+      std::atomic_long interrupts = 0;
+      // Fibers waiting for a ticket, by when they got in line. Unlike threads, they don't count
+      //  in tickets: Up wakes the first one up, then it takes the ticket if it's still free.
+      std::map<long, ManagedBlocker::Waker> fibers;
+      long fiberSeq = 0;
+
+      // A fiber's place in line, from when it first finds no ticket until it leaves.
+      struct FiberWait {
+        Semaphore& semaphore;
+        long since;
+        const CancellationToken* token;
+        long id = 0;
+        bool took = false;
+        CancellationRegistration cancellation;
+
+        FiberWait(Semaphore& semaphore, const CancellationToken* token);
+        FiberWait(const FiberWait& other) = delete;
+        FiberWait(FiberWait&& other) = delete;
+        // Leaves the line, waking up the next fiber if this one was woken up for a ticket it 
+        //  didn't take.
+        ~FiberWait();
+        FiberWait& operator=(const FiberWait& other) = delete;
+        FiberWait& operator=(FiberWait&& other) = delete;
+
+        // Throws interrupted_exception once interrupted or cancelled. Has cancelling wake the
+        //  fiber up, through waker.
+        void ThrowIfGivenUp(const ManagedBlocker::Waker& waker);
+        // Takes a ticket if one is free, or gets in line to be woken up through waker. Must be 
+        //  synchronized.
+        bool TakeOrQueue(const ManagedBlocker::Waker& waker);
+      };
+
+      void AwaitTicket();
+      bool AwaitTicket(long timeoutMillis);
+      void AwaitTicket(const CancellationToken& token);
+      // Returns the waker of a fiber to hand the ticket to, if no thread waits for it. Call it 
+      //  once out of sync. Must be synchronized.
+      ManagedBlocker::Waker ReleaseTicket();
+      // Takes the fiber that's been waiting the longest out of line. Must be synchronized.
+      ManagedBlocker::Waker NextFiber();
+      // Takes a ticket if one is free, without waiting. Must be synchronized.
+      bool TryTake();
+
+      template<class T>
+      T YieldingDown(
+          ManagedBlocker* fiber, const CancellationToken* token, std::function<T (long)>& doAfterFn);
+      bool YieldingTryDown(
+          ManagedBlocker* fiber, long timeoutMillis, std::function<void (long)>& doAfterFn);
   };
 
   template<class T>
   T Semaphore::Up(std::function<T (long)>&& doBeforeFn) {
-    return sync.Synchronized<T>([this, &doBeforeFn]() {
+    ManagedBlocker::Waker fiber;
+    T val = sync.Synchronized<T>([this, &doBeforeFn, &fiber]() {
       T val = doBeforeFn(tickets);
-      tickets++;
-      sync.Notify();
+      fiber = ReleaseTicket();
       return val;
     });
+    if (fiber) { fiber(); }
+    return val;
   }
 
   template<>
@@ -78,11 +159,13 @@ namespace concurrent {
 
   template<class T>
   T Semaphore::Down(std::function<T (long)>&& doAfterFn) {
+    if (ManagedBlocker* fiber = _yielding_blocker()) { 
+      return YieldingDown<T>(fiber, nullptr, doAfterFn); 
+    }
+
+    ManagedBlock block(tickets.load() <= 0);
     return sync.Synchronized<T>([this, &doAfterFn]() {
-      tickets--;
-      if (tickets < 0) {
-        sync.Wait();
-      }
+      AwaitTicket();
       return doAfterFn(tickets);
     });
   }
@@ -90,7 +173,53 @@ namespace concurrent {
   template<>
   void Semaphore::Down<void>(std::function<void (long)>&& doAfterFn);
 
+  template<class T>
+  T Semaphore::Down(const CancellationToken& token, std::function<T (long)>&& doAfterFn) {
+    if (ManagedBlocker* fiber = _yielding_blocker()) { 
+      return YieldingDown<T>(fiber, &token, doAfterFn); 
+    }
+
+    ManagedBlock block(tickets.load() <= 0);
+    return sync.Synchronized<T>([this, &token, &doAfterFn]() {
+      AwaitTicket(token);
+      return doAfterFn(tickets);
+    });
+  }
+
+  template<class T>
+  T Semaphore::Inspect(std::function<T (long)>&& fn) {
+    return sync.Synchronized<T>([this, &fn]() {
+      return fn(tickets);
+    });
+  }
+
+  template<class T>
+  T Semaphore::YieldingDown(
+      ManagedBlocker* fiber, const CancellationToken* token, std::function<T (long)>& doAfterFn) {
+    FiberWait wait(*this, token);
+    if constexpr (std::is_void_v<T>) {
+      fiber->YieldUntil([this, &wait, &doAfterFn](const ManagedBlocker::Waker& waker) {
+        wait.ThrowIfGivenUp(waker);
+        return sync.Synchronized<bool>([this, &wait, &doAfterFn, &waker]() {
+          if (!wait.TakeOrQueue(waker)) { return false; }
+          doAfterFn(tickets);
+          return true;
+        });
+      }, -1);
+    } else {
+      std::optional<T> result;
+      fiber->YieldUntil([this, &wait, &doAfterFn, &result](const ManagedBlocker::Waker& waker) {
+        wait.ThrowIfGivenUp(waker);
+        sync.Synchronized<void>([this, &wait, &doAfterFn, &result, &waker]() {
+          if (wait.TakeOrQueue(waker)) { result.emplace(doAfterFn(tickets)); }
+        });
+        return result.has_value();
+      }, -1);
+      return std::move(*result);
+    }
+  }
+
 } // concurrent
 } // mdl
 
-#endif // _MDL_CONCURRENT_THREAD_LOCAL
+#endif // _MDL_CONCURRENT_SEMAPHORE
@@ -0,0 +1,120 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _MDL_CONCURRENT_SERIAL_EXECUTOR
+#define _MDL_CONCURRENT_SERIAL_EXECUTOR
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "cancellation.h"
+#include "executors.h"
+#include "future.h"
+
+namespace mdl {
+namespace concurrent {
+
+  /**
+   * Runs the tasks given to it one at a time, in the order they were submitted, on the workers
+   * of an ExecutorService. A strand owns no thread: it only takes up a worker while it has 
+   * tasks queued, and gives it back after maxBatch of them so other strands get a turn. That
+   * makes it cheap to have one per account, file or session, on a small pool. Tasks of one 
+   * strand may run on different workers, but never at the same time, and each one sees 
+   * everything the ones before it did. A strand takes at most one spot in the executor's queue,
+   * and the executor's rejection policy doesn't apply to it, even once the queue is full.
+   */
+  class SerialExecutor {
+    public:
+      SerialExecutor(ExecutorService& executor, int maxBatch = 16);
+      SerialExecutor(const SerialExecutor& other) = delete;
+      SerialExecutor(SerialExecutor&& other) = delete;
+
+      SerialExecutor& operator=(const SerialExecutor& other) = delete;
+      SerialExecutor& operator=(SerialExecutor&& other) = delete;
+
+      void Execute(const std::function<void ()>& task);
+
+      template <class T>
+      Future<T> Submit(const std::function<T ()>& task);
+
+      template <class T>
+      Future<T> Submit(const std::function<T (const CancellationToken&)>& task);
+
+      // Tasks submitted but not yet finished, including the one running.
+      long Pending() const;
+
+    private:
+      struct Node {
+        std::function<void ()> fn;
+        std::atomic<Node*> next = nullptr;
+      };
+
+      // Kept apart from the strand, so tasks still queued on the executor can outlive it.
+      struct State {
+        ExecutorService& executor;
+        int maxBatch;
+        // Multiple producer, single consumer queue: producers swap themselves in as the tail,
+        //  and only the worker currently running the strand moves the head.
+        std::atomic<Node*> tail;
+        Node* head;
+        std::atomic_long pending = 0;
+
+        State(ExecutorService& executor, int maxBatch);
+        ~State();
+      };
+
+      std::shared_ptr<State> state;
+
+      void Enqueue(std::function<void ()>&& fn);
+      static void Drain(const std::shared_ptr<State>& state);
+  };
+
+  template <class T>
+  Future<T> SerialExecutor::Submit(const std::function<T ()>& task) {
+    Future<T> future;
+    Enqueue([future, task]() mutable {
+      ExecutorService::RunTask(future, task);
+    });
+    return future;
+  }
+
+  template <class T>
+  Future<T> SerialExecutor::Submit(const std::function<T (const CancellationToken&)>& task) {
+    Future<T> future;
+    CancellationToken token = future.Cooperate();
+    Enqueue([future, task, token]() mutable {
+      ExecutorService::RunTask<T>(future, [&task, &token]() { return task(token); });
+    });
+    return future;
+  }
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_SERIAL_EXECUTOR
@@ -0,0 +1,148 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _MDL_CONCURRENT_SHARED_SYNCHRONIZABLE
+#define _MDL_CONCURRENT_SHARED_SYNCHRONIZABLE
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#include "../concurrent/threadlocal.h"
+
+namespace mdl {
+namespace concurrent {
+
+  /**
+   * Reader/writer counterpart to Synchronizable, for read-mostly state. Any number of threads
+   * may be inside SynchronizedRead at once, while SynchronizedWrite is exclusive. Writers are 
+   * preferred: once one is waiting, new readers hold off until it's done.
+   *
+   * Readers register in one of several cache line sized slots, picked per thread, so that 
+   * readers on different cores don't fight over the same counter. The price is paid by writers,
+   * which have to check every slot.
+   *
+   * Both are reentrant. A thread holding the write lock may also read, but a thread holding 
+   * only the read lock can't upgrade to writing. Wait, Notify, NotifyAll and Interrupt behave as
+   * in Synchronizable, and require the write lock.
+   */
+  class SharedSynchronizable {
+    public: 
+      // readerSlots is rounded up to a power of two. Zero picks one slot per hardware thread.
+      SharedSynchronizable(int readerSlots = 0);
+      SharedSynchronizable(const SharedSynchronizable& other);
+      SharedSynchronizable(SharedSynchronizable&& other) = delete;
+      virtual ~SharedSynchronizable();
+
+      SharedSynchronizable& operator=(const SharedSynchronizable& other);
+      SharedSynchronizable& operator=(SharedSynchronizable&& other) = delete;
+
+      template<class T>
+      T SynchronizedRead(std::function<T ()>&& operation);
+
+      template<class T>
+      T SynchronizedWrite(std::function<T ()>&& operation);
+
+      void Wait();
+      bool Wait(long timeoutMillis);
+      void Notify();
+      void NotifyAll();
+      void Interrupt();
+
+    private:
+      enum Mode { kRead = 1, kWrite = 2 };
+
+      struct alignas(64) ReaderSlot {
+        std::atomic_long readers = 0;
+      };
+
+      // RAII for the outermost lock a thread takes. Unlocks even if the operation throws.
+      class Holder {
+        public:
+          Holder(SharedSynchronizable& owner, Mode mode);
+          Holder(const Holder& other) = delete;
+          ~Holder();
+        private:
+          SharedSynchronizable& owner;
+          Mode mode;
+          // the slot LockRead registered in. The thread's hint may move on before unlocking.
+          ReaderSlot* slot = nullptr;
+      };
+
+      int numSlots;
+      std::unique_ptr<ReaderSlot[]> slots;
+      std::atomic_bool writer = false;
+      // bumped by readers leaving while a writer waits for them to drain.
+      std::atomic_long drainSeq = 0;
+
+      std::atomic_long interruptedSeq = 0;
+      std::mutex waitMutex;
+      std::condition_variable condition;
+      mdl::concurrent::ThreadLocal<Mode> threadMode;
+
+      ReaderSlot& Slot();
+      ReaderSlot& LockRead();
+      void UnlockRead(ReaderSlot& slot);
+      void LockWrite();
+      void UnlockWrite();
+      void CheckWriteLocked(const char* operation);
+  };
+
+  template<class T>
+  T SharedSynchronizable::SynchronizedRead(std::function<T ()>&& operation) {
+    if (threadMode) {
+      // either reading already, or writing, which includes reading.
+      return operation();
+    }
+
+    auto guard = threadMode.Set(new Mode(kRead));
+    Holder holder(*this, kRead);
+    return operation();
+  }
+
+  template<class T>
+  T SharedSynchronizable::SynchronizedWrite(std::function<T ()>&& operation) {
+    if (threadMode) {
+      if (*threadMode != kWrite) {
+        throw std::runtime_error("Cannot upgrade a read lock to a write lock.");
+      }
+      return operation();
+    }
+
+    auto guard = threadMode.Set(new Mode(kWrite));
+    Holder holder(*this, kWrite);
+    return operation();
+  }
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_SHARED_SYNCHRONIZABLE
@@ -0,0 +1,124 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _MDL_CONCURRENT_SPIN_WAIT
+#define _MDL_CONCURRENT_SPIN_WAIT
+
+#include <atomic>
+#include <thread>
+
+namespace mdl {
+namespace concurrent {
+
+  /**
+   * Tells waiters how hard to try before giving up the CPU. A waiter first spins (busy waits 
+   * with a cpu pause hint) for up to maxSpins iterations, then yields its time slice up to 
+   * maxYields times and only then parks in the kernel. The default parks right away.
+   */
+  struct WaitPolicy {
+    int maxSpins = 0;
+    int maxYields = 0;
+    // When set, the spin budget follows how long recent waits actually took: it grows while 
+    //  spinning pays off and shrinks while waiters end up parking anyway.
+    bool adaptive = true;
+
+    bool Spins() const { return maxSpins > 0 || maxYields > 0; }
+
+    static WaitPolicy Park();
+    static WaitPolicy LowLatency();
+  };
+
+  inline void CpuRelax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+  }
+
+  class SpinWait {
+    public:
+      SpinWait(const WaitPolicy& policy = WaitPolicy());
+      SpinWait(const SpinWait& other) = delete;
+      SpinWait(SpinWait&& other) = delete;
+      SpinWait& operator=(const SpinWait& other) = delete;
+      SpinWait& operator=(SpinWait&& other) = delete;
+
+      // Spins, then yields, until ready returns true. Returns false if the budget ran out, in 
+      //  which case the caller is expected to park.
+      template <class Predicate>
+      bool Await(Predicate&& ready);
+
+      const WaitPolicy& Policy() const;
+      int SpinBudget() const;
+
+    private:
+      // Never shrinks below this, so the budget can grow back once waits get short again.
+      static constexpr int kMinSpins = 16;
+
+      WaitPolicy policy;
+      std::atomic_int spinBudget;
+
+      void OnSuccess(int spins);
+      void OnFailure();
+  };
+
+  template <class Predicate>
+  bool SpinWait::Await(Predicate&& ready) {
+    int budget = policy.adaptive ? spinBudget.load(std::memory_order_relaxed) : policy.maxSpins;
+    for (int i = 0; i < budget; i++) {
+      if (ready()) {
+        OnSuccess(i);
+        return true;
+      }
+      CpuRelax();
+    }
+
+    for (int i = 0; i < policy.maxYields; i++) {
+      if (ready()) {
+        OnSuccess(budget);
+        return true;
+      }
+      std::this_thread::yield();
+    }
+
+    if (ready()) {
+      OnSuccess(budget);
+      return true;
+    }
+
+    OnFailure();
+    return false;
+  }
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_SPIN_WAIT
@@ -0,0 +1,54 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _MDL_CONCURRENT_STACK_TRACE
+#define _MDL_CONCURRENT_STACK_TRACE
+
+#include <string>
+#include <thread>
+
+namespace mdl {
+namespace concurrent {
+
+  // Symbolized stack of the calling thread, one frame per line.
+  std::string CurrentStackTrace();
+
+  /**
+   * Stack of another thread in this process, one frame per line. The thread is interrupted with
+   * a real time signal (SIGRTMIN + 3), whose handler records its stack, so it must not block 
+   * that signal. The handler is installed on first use, for the whole process, unless the 
+   * application already handles that signal, in which case nothing is captured. Returns an 
+   * empty string then, if the thread didn't respond within timeoutMillis, or on platforms other
+   * than Linux. Only one capture runs at a time.
+   */
+  std::string CaptureStackTrace(std::thread::native_handle_type thread, long timeoutMillis = 100);
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_STACK_TRACE
@@ -0,0 +1,179 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _MDL_CONCURRENT_STRIPED_COUNTER
+#define _MDL_CONCURRENT_STRIPED_COUNTER
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "../util/threadhint.h"
+#include "spinwait.h"
+
+namespace mdl {
+namespace concurrent {
+
+  /**
+   * Counter for events counted from many threads at once, also known as a LongAdder. Instead of
+   * a single atomic, which every core would have to own in turn, increments are spread over
+   * cache line sized cells picked per thread, and a thread that finds its cell contended moves
+   * to another. Sum() adds all cells up, so it's the slow side: made for counters updated all
+   * the time and read now and then, such as statistics.
+   */
+  class StripedCounter {
+    public:
+      // cells is rounded up to a power of two. Zero picks one per hardware thread.
+      StripedCounter(int cells = 0);
+      StripedCounter(const StripedCounter& other) = delete;
+      StripedCounter(StripedCounter&& other) = delete;
+
+      StripedCounter& operator=(const StripedCounter& other) = delete;
+      StripedCounter& operator=(StripedCounter&& other) = delete;
+
+      void Add(long delta);
+      void Increment() { Add(1); }
+      void Decrement() { Add(-1); }
+
+      // Not a snapshot: updates made while adding up may or may not count.
+      long Sum() const;
+      void Reset();
+      // Same as Sum() followed by Reset(), but doesn't lose updates made in between.
+      long SumThenReset();
+
+    private:
+      struct alignas(64) Cell {
+        std::atomic_long value = 0;
+      };
+
+      int numCells;
+      std::unique_ptr<Cell[]> cells;
+  };
+
+  typedef StripedCounter LongAdder;
+
+  /**
+   * Generalizes StripedCounter to any T and any associative and commutative Op, such as 
+   * std::plus, a max, or a histogram merge. Each thread folds values into its own cell, guarded
+   * by a spin lock that only sees contention while Get() is reading it, or when more threads 
+   * than cells are writing. Get() merges every cell on read.
+   */
+  template <class T, class Op = std::plus<T>>
+  class ThreadLocalAccumulator {
+    public:
+      // identity is the value cells start at, such that Op(identity, x) == x.
+      ThreadLocalAccumulator(const T& identity = T(), int cells = 0, const Op& op = Op());
+      ThreadLocalAccumulator(const ThreadLocalAccumulator& other) = delete;
+      ThreadLocalAccumulator(ThreadLocalAccumulator&& other) = delete;
+
+      ThreadLocalAccumulator& operator=(const ThreadLocalAccumulator& other) = delete;
+      ThreadLocalAccumulator& operator=(ThreadLocalAccumulator&& other) = delete;
+
+      void Accumulate(const T& value);
+      T Get() const;
+      void Reset();
+      T GetThenReset();
+
+    private:
+      struct alignas(64) Cell {
+        std::atomic_bool locked = false;
+        T value;
+      };
+
+      // RAII for a cell's spin lock.
+      class CellLock {
+        public:
+          CellLock(Cell& cell, bool writer);
+          CellLock(const CellLock& other) = delete;
+          ~CellLock() { cell.locked.store(false, std::memory_order_release); }
+        private:
+          Cell& cell;
+      };
+
+      T identity;
+      Op op;
+      int numCells;
+      std::unique_ptr<Cell[]> cells;
+  };
+
+  template <class T, class Op>
+  ThreadLocalAccumulator<T, Op>::ThreadLocalAccumulator(const T& identity, int cells, const Op& op)
+      : identity(identity), op(op), numCells(util::NumThreadSlots(cells)), cells(new Cell[numCells]) {
+    for (int i = 0; i < numCells; i++) { this->cells[i].value = identity; }
+  }
+
+  template <class T, class Op>
+  void ThreadLocalAccumulator<T, Op>::Accumulate(const T& value) {
+    Cell& cell = cells[util::ThreadHint() & (numCells - 1)];
+    CellLock lock(cell, true);
+    cell.value = op(cell.value, value);
+  }
+
+  template <class T, class Op>
+  T ThreadLocalAccumulator<T, Op>::Get() const {
+    T result = identity;
+    for (int i = 0; i < numCells; i++) {
+      CellLock lock(cells[i], false);
+      result = op(result, cells[i].value);
+    }
+    return result;
+  }
+
+  template <class T, class Op>
+  void ThreadLocalAccumulator<T, Op>::Reset() {
+    for (int i = 0; i < numCells; i++) {
+      CellLock lock(cells[i], false);
+      cells[i].value = identity;
+    }
+  }
+
+  template <class T, class Op>
+  T ThreadLocalAccumulator<T, Op>::GetThenReset() {
+    T result = identity;
+    for (int i = 0; i < numCells; i++) {
+      CellLock lock(cells[i], false);
+      result = op(result, cells[i].value);
+      cells[i].value = identity;
+    }
+    return result;
+  }
+
+  template <class T, class Op>
+  ThreadLocalAccumulator<T, Op>::CellLock::CellLock(Cell& cell, bool writer) : cell(cell) {
+    while (cell.locked.exchange(true, std::memory_order_acquire)) {
+      // Next time, a writer that had to wait picks another cell, so two busy threads don't 
+      //  keep sharing one.
+      if (writer) { util::NextThreadHint(); }
+      while (cell.locked.load(std::memory_order_relaxed)) { CpuRelax(); }
+    }
+  }
+
+} // concurrent
+} // mdl
+
+#endif // _MDL_CONCURRENT_STRIPED_COUNTER
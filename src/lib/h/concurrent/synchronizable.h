@@ -34,7 +34,12 @@
 #include <memory>
 #include <mutex>
 #include <condition_variable>
+#include <string>
+#include <type_traits>
 
+#include "../concurrent/cancellation.h"
+#include "../concurrent/lockprofiler.h"
+#include "../concurrent/spinwait.h"
 #include "../concurrent/threadlocal.h"
 
 namespace mdl {
@@ -45,6 +50,11 @@ namespace concurrent {
       typedef std::unique_lock<std::mutex> lock_t;
 
       Synchronizable();
+      // Waiters spin according to policy before parking, which saves a round trip to the 
+      //  kernel when notifications come in quickly.
+      Synchronizable(const WaitPolicy& policy);
+      // name identifies this lock in LockProfiler reports.
+      Synchronizable(const std::string& name, const WaitPolicy& policy = WaitPolicy());
       Synchronizable(const Synchronizable& other);
       Synchronizable(Synchronizable&& other) = delete;
       virtual ~Synchronizable();
@@ -55,7 +65,8 @@ namespace concurrent {
       template<class T>
       T Synchronized(std::function<T ()>&& operation) {
         if (!threadLock) {
-          auto guard = threadLock.Set(new lock_t(mutex));
+          auto guard = threadLock.Set(profile.Acquire<lock_t>(mutex));
+          _LockProfileHold hold(profile);
           return operation();
         }
         
@@ -63,6 +74,15 @@ namespace concurrent {
       }
 
       void Wait();
+      // Same as Wait(), but gives up after timeoutMillis. Returns false if it timed out.
+      bool Wait(long timeoutMillis);
+      // Same as Wait(), but also wakes up, throwing interrupted_exception, once token fires.
+      void Wait(const CancellationToken& token);
+
+      // Runs waitLoop, which must be synchronized, with token set to wake up every waiter on this
+      //  object when it fires. Lets callers with their own wait conditions also check the token.
+      template<class T>
+      T Cancellable(const CancellationToken& token, std::function<T ()>&& waitLoop);
       void Notify();
       void NotifyAll();
       void Interrupt();
@@ -72,8 +92,40 @@ namespace concurrent {
       std::mutex mutex;
       std::condition_variable condition;
       mdl::concurrent::ThreadLocal<lock_t> threadLock;
+      SpinWait spinWait;
+      // Waiters currently spinning with the lock released, and notifications handed to them
+      //  instead of the condition. Both only change while holding the lock.
+      std::atomic_int spinning = 0;
+      std::atomic_int handoffs = 0;
+      [[no_unique_address]] _LockProfile profile;
+
+      bool SpinForHandoff(long seq);
+      void Unregister(CancellationRegistration& registration);
   };
 
+  template<class T>
+  T Synchronizable::Cancellable(const CancellationToken& token, std::function<T ()>&& waitLoop) {
+    if (!token.CanBeCancelled()) { return waitLoop(); }
+
+    CancellationRegistration registration = token.Register([this]() {
+      Synchronized<void>([this]() { NotifyAll(); });
+    });
+
+    try {
+      if constexpr (std::is_void_v<T>) {
+        waitLoop();
+        Unregister(registration);
+      } else {
+        T result = waitLoop();
+        Unregister(registration);
+        return result;
+      }
+    } catch (...) {
+      Unregister(registration);
+      throw;
+    }
+  }
+
 } // concurrent
 } // mdl
 
@@ -29,11 +29,14 @@
 #ifndef _MDL_CONCURRENT_QUEUE
 #define _MDL_CONCURRENT_QUEUE
 
+#include <atomic>
+#include <chrono>
 #include <list>
 #include <memory>
 #include <utility>
 
 #include "../util/exception.h"
+#include "notifier.h"
 #include "synchronizable.h"
 #include "semaphore.h"
 
@@ -66,6 +69,11 @@ namespace concurrent {
         return data.size();
       }
 
+      // The oldest item, which Poll would return next. Queue must not be empty.
+      const R& Front() const {
+        return data.front();
+      }
+
     private:
       std::list<R> data;
   };
@@ -118,43 +126,213 @@ namespace concurrent {
   class BlockingQueue  {
     public:
       BlockingQueue() {}
+      // Pollers spin according to policy before parking. Worth it for queues that usually refill
+      //  within microseconds.
+      BlockingQueue(const WaitPolicy& policy) : semaphore(0, policy) {}
+      // Holds at most capacity items, Add blocks until there's room for more. Zero is unbounded.
+      BlockingQueue(int capacity, const WaitPolicy& policy = WaitPolicy()) 
+          : semaphore(0, policy), capacity(capacity), slots(capacity, policy) {}
       // TODO: Consider making this copy constructible. Requires removing constness.
       BlockingQueue(const BlockingQueue& other) = delete;
       BlockingQueue(BlockingQueue&& other) = delete;
 
+      ~BlockingQueue() {
+        delete notifier.load();
+      }
+
       BlockingQueue& operator=(const BlockingQueue& other) = delete;
       BlockingQueue& operator=(BlockingQueue&& other) = delete;
 
       void Add(const R& item) {
-        semaphore.Up<void>([this, &item] (int numTickets) {
+        if (capacity > 0) { slots.Down(); }
+        bool wasEmpty;
+        semaphore.Up<void>([this, &item, &wasEmpty] (int numTickets) {
+          wasEmpty = numTickets <= 0;
           queue.Add(item);
         });
+        Added(wasEmpty);
       }
 
       void Add(R&& item) {
-        semaphore.Up<void>([this, &item] (int numTickets) {
+        if (capacity > 0) { slots.Down(); }
+        bool wasEmpty;
+        semaphore.Up<void>([this, &item, &wasEmpty] (int numTickets) {
+          wasEmpty = numTickets <= 0;
           queue.Add(std::move(item));
         });
+        Added(wasEmpty);
+      }
+
+      // Same as Add(), but gives up waiting for room, throwing interrupted_exception, once token
+      //  fires.
+      void Add(R&& item, const CancellationToken& token) {
+        if (capacity > 0) { slots.Down(token); }
+        bool wasEmpty;
+        semaphore.Up<void>([this, &item, &wasEmpty] (int numTickets) {
+          wasEmpty = numTickets <= 0;
+          queue.Add(std::move(item));
+        });
+        Added(wasEmpty);
+      }
+
+      // Same as Add(), but gives up after timeoutMillis. Returns false, leaving item untouched,
+      //  if there was no room in time.
+      bool TryAdd(R&& item, long timeoutMillis = 0) {
+        if (capacity > 0 && !slots.TryDown(timeoutMillis)) { return false; }
+        bool wasEmpty;
+        semaphore.Up<void>([this, &item, &wasEmpty] (int numTickets) {
+          wasEmpty = numTickets <= 0;
+          queue.Add(std::move(item));
+        });
+        Added(wasEmpty);
+        return true;
+      }
+
+      // Same as Add(), but never waits for room, going over capacity instead, until enough items
+      //  are polled. For items that can neither wait nor be dropped.
+      void ForceAdd(R&& item) {
+        if (capacity > 0 && !slots.TryDown(0)) { overflow++; }
+        bool wasEmpty;
+        semaphore.Up<void>([this, &item, &wasEmpty] (int numTickets) {
+          wasEmpty = numTickets <= 0;
+          queue.Add(std::move(item));
+        });
+        Added(wasEmpty);
       }
 
       R Poll() {
-        return semaphore.Down<R>([this] (int numTickets) {
+        R item = semaphore.Down<R>([this] (int numTickets) {
           return queue.Poll();
         });
+        Freed();
+        return item;
+      }
+
+      // Same as Poll(), but gives up, throwing interrupted_exception, once token fires.
+      R Poll(const CancellationToken& token) {
+        R item = semaphore.Down<R>(token, [this] (long numTickets) {
+          return queue.Poll();
+        });
+        Freed();
+        return item;
+      }
+
+      // Same as Poll(), but gives up after timeoutMillis. Returns false, leaving item untouched,
+      //  if nothing arrived in time.
+      bool TryPoll(R& item, long timeoutMillis = 0) {
+        if (!semaphore.TryDown(timeoutMillis, [this, &item] (long numTickets) {
+          item = queue.Poll();
+        })) {
+          return false;
+        }
+        Freed();
+        return true;
       }
 
       int Size() const {
         return semaphore.NumTickets();
       }
 
+      // Calls fn with the item Poll would return next, without taking it. Returns false, without
+      //  calling fn, if the queue is empty.
+      bool Peek(std::function<void (const R&)>&& fn) {
+        return semaphore.Inspect<bool>([this, &fn] (long numTickets) {
+          if (queue.Size() == 0) { return false; }
+          fn(queue.Front());
+          return true;
+        });
+      }
+
+      int Capacity() const {
+        return capacity;
+      }
+
+      // Readable once an item arrives to an empty queue, for poll, select, epoll or a Reactor. 
+      //  Reset it, then TryPoll until the queue is empty, before waiting on it again. Created on
+      //  first use, already signalled if there are items. See also WaitAny.
+      EventNotifier& Notifier() {
+        EventNotifier* current = notifier.load(std::memory_order_acquire);
+        if (current) { return *current; }
+
+        EventNotifier* created = new EventNotifier();
+        if (!notifier.compare_exchange_strong(current, created, std::memory_order_acq_rel)) {
+          delete created;
+          return *current;
+        }
+        // items added before the notifier existed didn't signal it.
+        if (Size() > 0) { created->Signal(); }
+        return *created;
+      }
+
+      // Interrupts pollers waiting for items, and adders waiting for room.
       void InterruptAll() {
         semaphore.InterruptAll();
+        if (capacity > 0) { slots.InterruptAll(); }
       }
     private:
       Queue<R> queue;
       mdl::concurrent::Semaphore semaphore;
+      int capacity = 0;
+      // free room in a bounded queue.
+      mdl::concurrent::Semaphore slots;
+      // Items ForceAdd put in without a slot. Polling those doesn't free one.
+      std::atomic_int overflow = 0;
+      std::atomic<EventNotifier*> notifier = nullptr;
+
+      void Freed() {
+        if (capacity <= 0) { return; }
+        int over = overflow.load();
+        while (over > 0) {
+          if (overflow.compare_exchange_weak(over, over - 1)) { return; }
+        }
+        slots.Up();
+      }
+
+      // Only signals once the item can be polled, or a waiter could check too early, then 
+      //  miss the signal.
+      void Added(bool wasEmpty) {
+        if (!wasEmpty) { return; }
+        EventNotifier* current = notifier.load(std::memory_order_acquire);
+        if (current) { current->Signal(); }
+      }
   };
 
+  /**
+   * Waits, without polling, until one of queues has items, for up to timeoutMillis, or for ever
+   * if that's negative. Returns the index of a queue with items, or -1 on timeout. Items aren't
+   * taken: TryPoll them, and expect to come back empty handed now and then if there are other 
+   * consumers. With several consumers waiting on the same queue, every time it stops being 
+   * empty wakes at least one of them. Uses, and resets, the queues' notifiers.
+   */
+  template <class... Queues>
+  int WaitAny(long timeoutMillis, Queues&... queues) {
+    EventNotifier* notifiers[] = { &queues.Notifier()... };
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+
+    while (true) {
+      // reset first: an item arriving after the check signals again.
+      for (EventNotifier* notifier : notifiers) { notifier->Reset(); }
+
+      int index = 0;
+      int found = -1;
+      auto check = [&index, &found](auto& queue) {
+        if (found < 0 && queue.Size() > 0) { found = index; }
+        index++;
+      };
+      (check(queues), ...);
+      if (found >= 0) { return found; }
+
+      long remaining = -1;
+      if (timeoutMillis >= 0) {
+        remaining = std::chrono::ceil<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) { return -1; }
+      }
+      // timing out comes back around to the check above.
+      EventNotifier::WaitAny(notifiers, sizeof...(queues), remaining);
+    }
+  }
+
 } // concurrent
 } // mdl
 
@@ -30,8 +30,13 @@
 #define _MDL_CONCURRENT_THREAD
 
 #include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
 #include <string>
 #include <thread>
+#include <tuple>
+#include <utility>
 
 #include "syncqueue.h"
 
@@ -52,9 +57,14 @@ namespace concurrent {
 
   typedef BlockingQueue<std::function<void ()>> worker_queue_t;
 
+  // Also names the thread for the kernel, so that top, perf and gdb show it. Those names are 
+  //  limited to 15 characters, longer ones get cut.
+  void _set_native_thread_name(const std::string& name);
+
   template<class Function, class... Args>
   void _named_thread_fn(const std::string name, Function&& f, Args&&... args) {
     this_thread::name = name;
+    _set_native_thread_name(name);
     try {
       std::invoke(std::forward<Function>(f), std::forward<Args>(args)...);
     } catch (...) {
@@ -88,26 +98,139 @@ namespace concurrent {
         std::forward<Args>(args)...);
   }
 
+  enum class SchedulingPolicy {
+    kDefault,
+    // For CPU bound work that doesn't care about latency. Gets longer, less frequent slices.
+    kBatch,
+    // Only runs when nothing else wants the CPU.
+    kIdle,
+    // Real time, runs until it blocks or yields. Usually requires privileges.
+    kFifo
+  };
+
+  // Settings the system refuses, such as kFifo without the privileges for it, are left as they 
+  //  were: threads still start.
+  struct ThreadOptions {
+    // Zero keeps the system default, usually 8 MB. Lean threads need only a few hundred KB.
+    std::size_t stackSize = 0;
+    SchedulingPolicy schedulingPolicy = SchedulingPolicy::kDefault;
+    // For kFifo only.
+    int fifoPriority = 1;
+    // Added to the nice value threads inherit. Zero leaves it.
+    int nice = 0;
+    // Run in every new thread, before and after its function.
+    std::function<void ()> onStart;
+    std::function<void ()> onExit;
+  };
+
+  // Applies what ThreadOptions asks of the calling thread. Returns false if the system refused 
+  //  any of it.
+  bool _apply_thread_options(const ThreadOptions& options);
+
+  // What a Thread runs: a function and its arguments, copied or moved in the way std::thread 
+  //  does it.
+  struct _ThreadBody {
+    virtual ~_ThreadBody() {}
+    virtual void Run() = 0;
+  };
+
+  template<class Function, class... Args>
+  struct _ThreadBodyOf : public _ThreadBody {
+    std::tuple<Function, Args...> call;
+
+    template<class F, class... A>
+    _ThreadBodyOf(F&& f, A&&... args) : call(std::forward<F>(f), std::forward<A>(args)...) {}
+
+    void Run() override {
+      std::apply([](auto&&... parts) { 
+        std::invoke(std::forward<decltype(parts)>(parts)...); 
+      }, std::move(call));
+    }
+  };
+
+  // Shared by a Thread and the thread it started, which may outlive it once detached.
+  struct _ThreadStart;
+
+  /**
+   * Thread started by a ThreadFactory. Works like std::thread, but is created with its own 
+   * attributes, so that it gets the stack size its factory asks for without changing the 
+   * process wide default. Like std::thread, it must be joined or detached before it's destroyed.
+   */
+  class Thread {
+    public:
+      typedef std::thread::native_handle_type native_handle_type;
+
+      Thread() noexcept;
+      Thread(std::unique_ptr<_ThreadBody>&& body, std::size_t stackSize = 0);
+      Thread(const Thread& other) = delete;
+      Thread(Thread&& other) noexcept;
+      ~Thread();
+
+      Thread& operator=(const Thread& other) = delete;
+      Thread& operator=(Thread&& other) noexcept;
+
+      bool joinable() const noexcept;
+      void join();
+      void detach();
+      // Waits for the thread to start, if it hasn't yet.
+      std::thread::id get_id() const noexcept;
+      native_handle_type native_handle();
+
+    private:
+#ifdef __linux__
+      native_handle_type handle {};
+      std::shared_ptr<_ThreadStart> start;
+#else
+      std::thread thread;
+#endif
+  };
+
+  template<class Function, class... Args>
+  void _factory_thread_fn(const std::string name, std::shared_ptr<const ThreadOptions> options,
+      Function f, Args... args) {
+    // named before the hooks run, so they can tell which thread they're in.
+    this_thread::name = name;
+    _set_native_thread_name(name);
+    _apply_thread_options(*options);
+    if (options->onStart) { options->onStart(); }
+
+    // Runs onExit even if f throws.
+    struct ExitHook {
+      const ThreadOptions& options;
+      ~ExitHook() { if (options.onExit) { options.onExit(); } }
+    } exitHook { *options };
+
+    std::invoke(std::move(f), std::move(args)...);
+  }
+
   class ThreadFactory {
     public:
-      ThreadFactory(const std::string& name);
+      ThreadFactory(const std::string& name, const ThreadOptions& options = ThreadOptions());
 
       template <class Function, class... Args>
-      std::thread NewThread(Function&& f, Args&&... args);
+      Thread NewThread(Function&& f, Args&&... args);
+
+      const ThreadOptions& Options() const;
     private:
       std::string name;
       std::atomic_int idSeq;
+      // Shared with the threads, which may outlive the factory.
+      std::shared_ptr<const ThreadOptions> options;
 
       std::string NextName();
   };
 
   template <class Function, class... Args>
-  std::thread ThreadFactory::NewThread(Function&& f, Args&&... args) {
-    // std::invoke(std::forward<Function>(f), std::forward<Args>(args)...);
-    return named_thread(
-        NextName(), 
-        std::forward<Function>(f),
-        std::forward<Args>(args)...);
+  Thread ThreadFactory::NewThread(Function&& f, Args&&... args) {
+    typedef void (*entry_t)(const std::string, std::shared_ptr<const ThreadOptions>, 
+        std::decay_t<Function>, std::decay_t<Args>...);
+    entry_t entry = _factory_thread_fn<std::decay_t<Function>, std::decay_t<Args>...>;
+
+    return Thread(
+        std::make_unique<_ThreadBodyOf<entry_t, std::string, std::shared_ptr<const ThreadOptions>, 
+            std::decay_t<Function>, std::decay_t<Args>...>>(
+            entry, NextName(), options, std::forward<Function>(f), std::forward<Args>(args)...),
+        options->stackSize);
   }
 
 } // concurrent
@@ -0,0 +1,119 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef _MDL_UTIL_BLOCK_POOL
+#define _MDL_UTIL_BLOCK_POOL
+
+#include <cstddef>
+#include <new>
+
+namespace mdl {
+namespace util {
+
+  /**
+   * Recycles fixed size blocks of memory, for objects that get created and destroyed at a high
+   * rate. Freed blocks are cached by the thread freeing them, up to MaxCached, and handed out 
+   * again by that same thread without going through the allocator. The cache is released when
+   * the thread exits. Blocks released after that, say by another thread_local's destructor, go
+   * straight back to the allocator.
+   */
+  template <std::size_t Size, std::size_t Align = alignof(std::max_align_t), int MaxCached = 1024>
+  class BlockPool {
+    public:
+      static void* Allocate() {
+        if (Destroyed()) { return ::operator new(kBlockSize, std::align_val_t(kAlign)); }
+        FreeList& list = List();
+        if (list.head) {
+          Node* node = list.head;
+          list.head = node->next;
+          list.size--;
+          return node;
+        }
+        return ::operator new(kBlockSize, std::align_val_t(kAlign));
+      }
+
+      static void Release(void* block) {
+        if (Destroyed()) {
+          ::operator delete(block, std::align_val_t(kAlign));
+          return;
+        }
+        FreeList& list = List();
+        if (list.size >= MaxCached) {
+          ::operator delete(block, std::align_val_t(kAlign));
+          return;
+        }
+        Node* node = static_cast<Node*>(block);
+        node->next = list.head;
+        list.head = node;
+        list.size++;
+      }
+
+      // Number of blocks cached by the calling thread.
+      static int Cached() {
+        return Destroyed() ? 0 : List().size;
+      }
+
+    private:
+      struct Node {
+        Node* next;
+      };
+
+      static constexpr std::size_t kBlockSize = Size < sizeof(Node) ? sizeof(Node) : Size;
+      static constexpr std::size_t kAlign = Align < alignof(Node) ? alignof(Node) : Align;
+
+      struct FreeList {
+        Node* head = nullptr;
+        int size = 0;
+
+        ~FreeList() {
+          Destroyed() = true;
+          while (head) {
+            Node* node = head;
+            head = node->next;
+            ::operator delete(node, std::align_val_t(kAlign));
+          }
+        }
+      };
+
+      static FreeList& List() {
+        static thread_local FreeList list;
+        return list;
+      }
+
+      // Kept apart from the FreeList, as a trivially destructible thread_local stays usable 
+      //  until the thread is gone.
+      static bool& Destroyed() {
+        static thread_local bool destroyed = false;
+        return destroyed;
+      }
+  };
+
+} // util
+} // mdl
+
+#endif // _MDL_UTIL_BLOCK_POOL
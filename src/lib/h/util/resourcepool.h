@@ -29,23 +29,408 @@
 #ifndef _MDL_UTIL_RESOURCE_POOL
 #define _MDL_UTIL_RESOURCE_POOL
 
-#include <list>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <stdexcept>
+
+#include "../concurrent/synchronizable.h"
+#include "../util/threadhint.h"
+#include "../util/time.h"
 
 namespace mdl {
 namespace util {
 
-  // TODO: IMPLEMENT THIS! :-)
-  
-  // template<class R>
-  // class ResourcePool {
-  //   public:
-  //     std::unique_ptr<R> Borrow();
-
-  //   private:
-  //     std::list<std::unique_ptr<R>> queue;
-  //     void Return(std::unique_ptr<R>&& resource);
-  // };
+  struct ResourcePoolOptions {
+    // Resources created up front, and never evicted.
+    int minSize = 0;
+    // Resources alive at any given time, borrowed or idle. Borrowers wait once it's reached.
+    int maxSize = 16;
+    // Idle resources above minSize get destroyed after this long. Zero keeps them forever.
+    long maxIdleMillis = 0;
+    // Per thread caches, rounded up to a power of two. Zero uses one per hardware thread.
+    int threadCaches = 0;
+  };
+
+  /**
+   * Lends out resources that are expensive to create, such as connections or large buffers. 
+   * A resource returned by a thread is kept in that thread's cache slot and handed back to it
+   * on its next Borrow(), so a thread borrowing and returning in a loop doesn't touch any shared
+   * state. Everything else goes through lock free free lists, and only borrowers that find the 
+   * pool exhausted take a lock to wait. The pool must outlive every handle it lent.
+   */
+  template <class R>
+  class ResourcePool {
+    public:
+      typedef std::function<std::unique_ptr<R> ()> factory_t;
+
+      // Gives the resource back to the pool when it goes out of scope.
+      class Handle {
+        public:
+          Handle() : pool(nullptr), index(kNil) {}
+          Handle(const Handle& other) = delete;
+          Handle(Handle&& other) : pool(other.pool), index(other.index) { other.index = kNil; }
+          ~Handle() { Return(); }
+
+          Handle& operator=(const Handle& other) = delete;
+          Handle& operator=(Handle&& other) {
+            if (this != &other) {
+              Return();
+              pool = other.pool;
+              index = other.index;
+              other.index = kNil;
+            }
+            return *this;
+          }
+
+          R* Get() const { return index == kNil ? nullptr : pool->nodes[index].resource.get(); }
+          R& operator*() const { return *Get(); }
+          R* operator->() const { return Get(); }
+          explicit operator bool() const { return index != kNil; }
+
+          // Gives the resource back now, instead of at the end of the scope.
+          void Return() {
+            if (index != kNil) {
+              pool->Return(index);
+              index = kNil;
+            }
+          }
+
+          // Destroys the resource instead of giving it back, e.g. a connection that went bad. 
+          //  Frees up room for the pool to create a new one.
+          void Discard() {
+            if (index != kNil) {
+              pool->Discard(index);
+              index = kNil;
+            }
+          }
+
+        private:
+          friend class ResourcePool<R>;
+
+          ResourcePool<R>* pool;
+          uint32_t index;
+
+          Handle(ResourcePool<R>* pool, uint32_t index) : pool(pool), index(index) {}
+      };
+
+      ResourcePool(factory_t factory, const ResourcePoolOptions& options = ResourcePoolOptions());
+      ResourcePool(const ResourcePool& other) = delete;
+      ResourcePool(ResourcePool&& other) = delete;
+
+      ResourcePool& operator=(const ResourcePool& other) = delete;
+      ResourcePool& operator=(ResourcePool&& other) = delete;
+
+      // Waits until a resource is available, creating one if the pool has room.
+      Handle Borrow();
+      // Same as Borrow(), but gives up after timeoutMillis, returning false. Doesn't wait at all
+      //  with a zero timeout, and waits for as long as it takes with a negative one.
+      bool TryBorrow(Handle& handle, long timeoutMillis = 0);
+
+      // Creates up to count idle resources ahead of time. Returns how many were created.
+      int WarmUp(int count);
+      // Destroys resources idle for longer than maxIdleMillis, keeping at least minSize alive.
+      //  Returns how many were destroyed. Also runs on its own as resources are returned.
+      int EvictIdle();
+
+      // Resources alive, borrowed or idle.
+      int Size() const;
+      int Idle() const;
+
+    private:
+      static constexpr uint32_t kNil = UINT32_MAX;
+
+      struct Node {
+        std::unique_ptr<R> resource;
+        instant returned;
+        std::atomic<uint32_t> next = kNil;
+      };
+
+      struct alignas(64) CacheSlot {
+        std::atomic<uint32_t> index = kNil;
+      };
+
+      // Treiber stack of node indexes. The head carries a tag, bumped on every change, so a node
+      //  popped and pushed back between a load and a compare-exchange can't go unnoticed.
+      class IndexStack {
+        public:
+          void Push(Node* nodes, uint32_t index) {
+            uint64_t head = top.load(std::memory_order_relaxed);
+            do {
+              nodes[index].next.store(Index(head), std::memory_order_relaxed);
+            } while (!top.compare_exchange_weak(head, Tagged(head, index), 
+                std::memory_order_release, std::memory_order_relaxed));
+          }
+
+          uint32_t Pop(Node* nodes) {
+            uint64_t head = top.load(std::memory_order_acquire);
+            while (Index(head) != kNil) {
+              uint32_t next = nodes[Index(head)].next.load(std::memory_order_relaxed);
+              if (top.compare_exchange_weak(head, Tagged(head, next), 
+                  std::memory_order_acquire, std::memory_order_acquire)) {
+                return Index(head);
+              }
+            }
+            return kNil;
+          }
+
+          bool Empty() const { return Index(top.load()) == kNil; }
+
+        private:
+          std::atomic<uint64_t> top = kNil;
+
+          static uint32_t Index(uint64_t head) { return static_cast<uint32_t>(head); }
+          static uint64_t Tagged(uint64_t head, uint32_t index) {
+            return (((head >> 32) + 1) << 32) | index;
+          }
+      };
+
+      factory_t factory;
+      ResourcePoolOptions options;
+      std::unique_ptr<Node[]> nodes;
+      int numSlots;
+      std::unique_ptr<CacheSlot[]> slots;
+      // Nodes holding an idle resource, and nodes with room for a new one.
+      IndexStack idle;
+      IndexStack vacant;
+      std::atomic_int size = 0;
+      std::atomic_int numIdle = 0;
+      std::atomic_int waiters = 0;
+      std::atomic<instant> lastEviction;
+      concurrent::Synchronizable sync;
+
+      uint32_t TryTake();
+      bool Available() const;
+      uint32_t Create();
+      void Return(uint32_t index);
+      void Discard(uint32_t index);
+      void Release(uint32_t index);
+      void WakeWaiters();
+      CacheSlot& Slot() { return slots[ThreadHint() & (numSlots - 1)]; }
+  };
+
+  template <class R>
+  ResourcePool<R>::ResourcePool(factory_t factory, const ResourcePoolOptions& options)
+      : factory(factory), options(options), nodes(new Node[std::max(options.maxSize, 1)]),
+        lastEviction(Now()) {
+    if (options.maxSize < 1 || options.minSize > options.maxSize) {
+      throw std::invalid_argument("ResourcePool requires 0 <= minSize <= maxSize and maxSize > 0");
+    }
+
+    numSlots = NumThreadSlots(options.threadCaches);
+    slots.reset(new CacheSlot[numSlots]);
+
+    for (int i = options.maxSize - 1; i >= 0; i--) {
+      vacant.Push(nodes.get(), i);
+    }
+    WarmUp(options.minSize);
+  }
+
+  template <class R>
+  typename ResourcePool<R>::Handle ResourcePool<R>::Borrow() {
+    Handle handle;
+    TryBorrow(handle, -1);
+    return handle;
+  }
+
+  template <class R>
+  bool ResourcePool<R>::TryBorrow(Handle& handle, long timeoutMillis) {
+    instant deadline = Now() + std::chrono::milliseconds(std::max(timeoutMillis, 0L));
+    uint32_t index;
+    while ((index = TryTake()) == kNil && (index = Create()) == kNil && timeoutMillis != 0) {
+      // Resources are created outside the lock, it's only held to park.
+      bool timedOut = sync.Synchronized<bool>([this, timeoutMillis, &deadline]() {
+        waiters++;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool expired = false;
+        try {
+          // Returners check for waiters after making a resource available, so whatever they 
+          //  made available before we registered shows up here, and anything after wakes us.
+          if (!Available()) {
+            if (timeoutMillis < 0) {
+              sync.Wait();
+            } else {
+              long remaining = (EllapsedTime(Now(), deadline) + 999) / 1000L;
+              expired = remaining <= 0 || !sync.Wait(remaining);
+            }
+          }
+        } catch (...) {
+          waiters--;
+          throw;
+        }
+        waiters--;
+        return expired;
+      });
+
+      if (timedOut) {
+        if ((index = TryTake()) == kNil) { index = Create(); }
+        break;
+      }
+    }
+
+    if (index == kNil) { return false; }
+    handle = Handle(this, index);
+    return true;
+  }
+
+  template <class R>
+  int ResourcePool<R>::WarmUp(int count) {
+    int created = 0;
+    for (; created < count; created++) {
+      uint32_t index = Create();
+      if (index == kNil) { break; }
+      Release(index);
+    }
+    return created;
+  }
+
+  template <class R>
+  int ResourcePool<R>::EvictIdle() {
+    if (options.maxIdleMillis <= 0) { return 0; }
+
+    instant now = Now();
+    lastEviction = now;
+    int evicted = 0;
+    uint32_t keep = kNil;
+
+    auto consider = [this, &now, &evicted, &keep](uint32_t index) {
+      Node& node = nodes[index];
+      if (size.load() > options.minSize 
+          && EllapsedTime(node.returned, now) / 1000L >= options.maxIdleMillis) {
+        node.resource.reset();
+        size--;
+        evicted++;
+        vacant.Push(nodes.get(), index);
+      } else {
+        node.next.store(keep, std::memory_order_relaxed);
+        keep = index;
+      }
+    };
+
+    for (int i = 0; i < numSlots; i++) {
+      uint32_t index = slots[i].index.exchange(kNil, std::memory_order_acquire);
+      if (index != kNil) {
+        numIdle--;
+        consider(index);
+      }
+    }
+
+    uint32_t index;
+    while ((index = idle.Pop(nodes.get())) != kNil) {
+      numIdle--;
+      consider(index);
+    }
+
+    while (keep != kNil) {
+      uint32_t next = nodes[keep].next.load(std::memory_order_relaxed);
+      numIdle++;
+      idle.Push(nodes.get(), keep);
+      keep = next;
+    }
+
+    // Waiters may have found the pool empty while everything was out for inspection.
+    WakeWaiters();
+    return evicted;
+  }
+
+  template <class R>
+  int ResourcePool<R>::Size() const {
+    return size.load();
+  }
+
+  template <class R>
+  int ResourcePool<R>::Idle() const {
+    return numIdle.load();
+  }
+
+  // Tries the calling thread's own slot first, then the shared list, and only then the slots 
+  //  of other threads.
+  template <class R>
+  uint32_t ResourcePool<R>::TryTake() {
+    uint32_t index = Slot().index.exchange(kNil, std::memory_order_acquire);
+    if (index == kNil) { index = idle.Pop(nodes.get()); }
+    for (int i = 0; index == kNil && i < numSlots; i++) {
+      index = slots[i].index.exchange(kNil, std::memory_order_acquire);
+    }
+
+    if (index != kNil) { numIdle--; }
+    return index;
+  }
+
+  template <class R>
+  bool ResourcePool<R>::Available() const {
+    if (!idle.Empty() || !vacant.Empty()) { return true; }
+    for (int i = 0; i < numSlots; i++) {
+      if (slots[i].index.load() != kNil) { return true; }
+    }
+    return false;
+  }
+
+  template <class R>
+  uint32_t ResourcePool<R>::Create() {
+    uint32_t index = vacant.Pop(nodes.get());
+    if (index == kNil) { return kNil; }
+
+    try {
+      nodes[index].resource = factory();
+    } catch (...) {
+      vacant.Push(nodes.get(), index);
+      WakeWaiters();
+      throw;
+    }
+    if (!nodes[index].resource) {
+      vacant.Push(nodes.get(), index);
+      WakeWaiters();
+      throw std::runtime_error("ResourcePool factory returned no resource");
+    }
+
+    size++;
+    return index;
+  }
+
+  template <class R>
+  void ResourcePool<R>::Return(uint32_t index) {
+    Release(index);
+    WakeWaiters();
+
+    if (options.maxIdleMillis > 0) {
+      instant last = lastEviction.load(std::memory_order_relaxed);
+      instant now = Now();
+      if (EllapsedTime(last, now) / 1000L >= options.maxIdleMillis 
+          && lastEviction.compare_exchange_strong(last, now)) {
+        EvictIdle();
+      }
+    }
+  }
+
+  template <class R>
+  void ResourcePool<R>::Discard(uint32_t index) {
+    nodes[index].resource.reset();
+    size--;
+    vacant.Push(nodes.get(), index);
+    WakeWaiters();
+  }
+
+  template <class R>
+  void ResourcePool<R>::Release(uint32_t index) {
+    nodes[index].returned = Now();
+    numIdle++;
+
+    uint32_t expected = kNil;
+    if (!Slot().index.compare_exchange_strong(expected, index, std::memory_order_release)) {
+      idle.Push(nodes.get(), index);
+    }
+  }
+
+  template <class R>
+  void ResourcePool<R>::WakeWaiters() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load() > 0) {
+      sync.Synchronized<void>([this]() { sync.NotifyAll(); });
+    }
+  }
 
 } // util
 } // mdl
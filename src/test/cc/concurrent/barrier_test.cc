@@ -0,0 +1,107 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <mdl/concurrent.h>
+
+namespace mdl {
+namespace concurrent {
+namespace barriertest {
+  void TestPhases(const WaitPolicy& policy) {
+    const int kThreads = 6;
+    const int kPhases = 200;
+    std::atomic_int arrived = 0;
+    std::atomic_int completions = 0;
+    std::atomic_bool consistent = true;
+
+    Barrier barrier(kThreads, [&]() {
+      // every party arrived at the same phase before it ends.
+      if (arrived != (completions + 1) * kThreads) { consistent = false; }
+      completions++;
+    }, policy);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; i++) {
+      threads.emplace_back([&]() {
+        for (int p = 0; p < kPhases; p++) {
+          arrived++;
+          if (barrier.ArriveAndWait() != p) { consistent = false; }
+          if (completions <= p) { consistent = false; }
+        }
+      });
+    }
+    for (auto& t : threads) { t.join(); }
+
+    ASSERT_TRUE(consistent);
+    ASSERT_EQ(kPhases, completions);
+    ASSERT_EQ(kPhases, barrier.Phase());
+  }
+
+  TEST(BarrierTestSuite, TestBarrier_Phases) {
+    TestPhases(WaitPolicy::Park());
+  }
+
+  TEST(BarrierTestSuite, TestBarrier_Phases_Spinning) {
+    TestPhases(WaitPolicy::LowLatency());
+  }
+
+  TEST(BarrierTestSuite, TestBarrier_ArriveAndDrop) {
+    std::atomic_int completions = 0;
+    Barrier barrier(3, [&completions]() { completions++; });
+
+    std::thread t1([&barrier]() { barrier.ArriveAndWait(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    barrier.ArriveAndDrop();
+    ASSERT_EQ(0, completions);
+
+    // the phase ends with the third party.
+    barrier.ArriveAndWait();
+    t1.join();
+    ASSERT_EQ(1, completions);
+    ASSERT_EQ(2, barrier.Parties());
+
+    // and from now on two are enough.
+    std::thread t2([&barrier]() { barrier.ArriveAndWait(); });
+    barrier.ArriveAndWait();
+    t2.join();
+    ASSERT_EQ(2, completions);
+  }
+
+  TEST(BarrierTestSuite, TestBarrier_CompletionThrows) {
+    Barrier barrier(1, []() { throw std::runtime_error("Oops"); });
+    ASSERT_THROW(barrier.ArriveAndWait(), std::runtime_error);
+    ASSERT_EQ(1, barrier.Phase());
+  }
+} // barriertest
+} // concurrent
+} // mdl
@@ -0,0 +1,181 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <mdl/concurrent.h>
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace mdl {
+namespace concurrent {
+namespace cancellationtest {
+
+  TEST(CancellationTestSuite, TestDefaultToken) {
+    CancellationToken token;
+    ASSERT_FALSE(token.CanBeCancelled());
+    ASSERT_FALSE(token.IsCancellationRequested());
+    token.ThrowIfCancellationRequested();
+
+    bool called = false;
+    auto registration = token.Register([&called]() { called = true; });
+    ASSERT_FALSE(called);
+  }
+
+  TEST(CancellationTestSuite, TestCancel) {
+    CancellationSource source;
+    CancellationToken token = source.Token();
+    ASSERT_TRUE(token.CanBeCancelled());
+    ASSERT_FALSE(token.IsCancellationRequested());
+
+    int calls = 0;
+    auto r1 = token.Register([&calls]() { calls++; });
+    auto r2 = token.Register([&calls]() { calls += 10; });
+
+    ASSERT_TRUE(source.Cancel());
+    ASSERT_EQ(11, calls);
+    ASSERT_TRUE(source.IsCancellationRequested());
+    ASSERT_TRUE(token.IsCancellationRequested());
+    ASSERT_THROW(token.ThrowIfCancellationRequested(), interrupted_exception);
+
+    // only once.
+    ASSERT_FALSE(source.Cancel());
+    ASSERT_EQ(11, calls);
+
+    // late registrations run right away.
+    auto r3 = token.Register([&calls]() { calls += 100; });
+    ASSERT_EQ(111, calls);
+  }
+
+  TEST(CancellationTestSuite, TestUnregister) {
+    CancellationSource source;
+    int calls = 0;
+    {
+      auto registration = source.Token().Register([&calls]() { calls++; });
+    }
+    auto registration = source.Token().Register([&calls]() { calls += 10; });
+    registration.Unregister();
+
+    source.Cancel();
+    ASSERT_EQ(0, calls);
+  }
+
+  TEST(CancellationTestSuite, TestUnregister_WaitsForRunningCallback) {
+    CancellationSource source;
+    std::atomic_bool started = false;
+    std::atomic_bool finished = false;
+
+    auto registration = source.Token().Register([&started, &finished]() {
+      started = true;
+      std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(100));
+      finished = true;
+    });
+
+    std::thread t1([&source]() { source.Cancel(); });
+    while (!started) { std::this_thread::yield(); }
+    registration.Unregister();
+    ASSERT_TRUE(finished);
+    t1.join();
+  }
+
+  TEST(CancellationTestSuite, TestWait_Cancelled) {
+    CancellationSource source;
+    Synchronizable sync;
+    bool done = false;
+
+    std::thread t1([&sync, &source, &done]() {
+      sync.Synchronized<void>([&sync, &source, &done]() {
+        try {
+          sync.Wait(source.Token());
+          FAIL();
+        } catch (interrupted_exception& ex) {
+          done = true;
+        }
+      });
+    });
+
+    std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(100));
+    ASSERT_FALSE(done);
+    source.Cancel();
+    t1.join();
+    ASSERT_TRUE(done);
+
+    // still usable, and fails fast with a cancelled token.
+    ASSERT_THROW(sync.Synchronized<void>([&sync, &source]() { sync.Wait(source.Token()); }), 
+        interrupted_exception);
+  }
+
+  TEST(CancellationTestSuite, TestSemaphoreDown_Cancelled) {
+    CancellationSource source;
+    Semaphore s(0);
+    bool done = false;
+
+    std::thread t1([&s, &source, &done]() {
+      try {
+        s.Down(source.Token());
+        FAIL();
+      } catch (interrupted_exception& ex) {
+        done = true;
+      }
+    });
+
+    std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(100));
+    ASSERT_EQ(-1, s.NumTickets());
+    source.Cancel();
+    t1.join();
+    ASSERT_TRUE(done);
+    // the cancelled thread gave back its claim.
+    ASSERT_EQ(0, s.NumTickets());
+
+    s.Up();
+    s.Down(CancellationToken());
+    ASSERT_EQ(0, s.NumTickets());
+  }
+
+  TEST(CancellationTestSuite, TestQueuePoll_Cancelled) {
+    CancellationSource source;
+    BlockingQueue<int> queue;
+
+    queue.Add(10);
+    ASSERT_EQ(10, queue.Poll(source.Token()));
+
+    std::thread t1([&source]() {
+      std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(100));
+      source.Cancel();
+    });
+    ASSERT_THROW(queue.Poll(source.Token()), interrupted_exception);
+    t1.join();
+
+    queue.Add(20);
+    ASSERT_EQ(20, queue.Poll());
+    ASSERT_EQ(0, queue.Size());
+  }
+
+} // cancellationtest
+} // concurrent
+} // mdl
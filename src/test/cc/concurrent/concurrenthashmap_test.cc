@@ -0,0 +1,204 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mdl/concurrent.h>
+
+namespace mdl {
+namespace concurrent {
+namespace concurrenthashmaptest {
+  TEST(ConcurrentHashMapTestSuite, TestConcurrentHashMap_Basics) {
+    ConcurrentHashMap<std::string, int> map(4, 8);
+    ASSERT_TRUE(map.Empty());
+
+    ASSERT_TRUE(map.Put("one", 1));
+    ASSERT_FALSE(map.Put("one", 11));
+    ASSERT_TRUE(map.PutIfAbsent("two", 2));
+    ASSERT_FALSE(map.PutIfAbsent("two", 22));
+    ASSERT_EQ(2, map.Size());
+
+    int value = 0;
+    ASSERT_TRUE(map.Get("one", value));
+    ASSERT_EQ(11, value);
+    ASSERT_TRUE(map.Get("two", value));
+    ASSERT_EQ(2, value);
+    ASSERT_FALSE(map.Get("three", value));
+    ASSERT_EQ(2, value);
+
+    ASSERT_TRUE(map.Remove("one"));
+    ASSERT_FALSE(map.Remove("one"));
+    ASSERT_FALSE(map.Contains("one"));
+    ASSERT_TRUE(map.Contains("two"));
+
+    map.Clear();
+    ASSERT_TRUE(map.Empty());
+    ASSERT_FALSE(map.Contains("two"));
+  }
+
+  TEST(ConcurrentHashMapTestSuite, TestConcurrentHashMap_GrowsIncrementally) {
+    // a single small segment, so it grows many times over.
+    ConcurrentHashMap<int, int> map(1, 4);
+    const int count = 10000;
+    for (int i = 0; i < count; i++) {
+      ASSERT_TRUE(map.Put(i, 2 * i));
+      // everything stays reachable while buckets move over.
+      int value;
+      ASSERT_TRUE(map.Get(i / 2, value));
+      ASSERT_EQ(i / 2 * 2, value);
+    }
+    ASSERT_EQ(count, map.Size());
+
+    for (int i = 0; i < count; i += 2) { ASSERT_TRUE(map.Remove(i)); }
+    ASSERT_EQ(count / 2, map.Size());
+    for (int i = 0; i < count; i++) { ASSERT_EQ(i % 2 == 1, map.Contains(i)); }
+  }
+
+  TEST(ConcurrentHashMapTestSuite, TestConcurrentHashMap_HighBitKeys) {
+    // keys that only differ above bit 40 still land in different buckets.
+    std::set<uint64_t> buckets;
+    for (uint64_t i = 0; i < 1024; i++) {
+      buckets.insert(util::MixHash(std::hash<uint64_t>()(i << 40)) & 1023);
+    }
+    ASSERT_GT(buckets.size(), 512);
+
+    ConcurrentHashMap<uint64_t, int> map(1, 4);
+    for (uint64_t i = 0; i < 1024; i++) { ASSERT_TRUE(map.Put(i << 40, i)); }
+    for (uint64_t i = 0; i < 1024; i++) { 
+      int value;
+      ASSERT_TRUE(map.Get(i << 40, value));
+      ASSERT_EQ(i, value);
+    }
+  }
+
+  TEST(ConcurrentHashMapTestSuite, TestConcurrentHashMap_ComputeIfAbsentAndMerge) {
+    ConcurrentHashMap<int, long> map;
+    std::atomic_int computed = 0;
+    const int numThreads = 8;
+    const int keys = 100;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+      threads.emplace_back([&map, &computed]() {
+        for (int k = 0; k < keys; k++) {
+          long value = map.ComputeIfAbsent(k, [&computed](const int& key) {
+            computed++;
+            return (long) key * 10;
+          });
+          ASSERT_EQ(k * 10, value);
+          map.Merge(-k - 1, 1, [](const long& current, const long& value) { 
+            return current + value; 
+          });
+        }
+      });
+    }
+    for (auto& thread : threads) { thread.join(); }
+
+    ASSERT_EQ(keys, computed);
+    ASSERT_EQ(2 * keys, map.Size());
+    long value;
+    for (int k = 0; k < keys; k++) {
+      ASSERT_TRUE(map.Get(-k - 1, value));
+      ASSERT_EQ(numThreads, value);
+    }
+  }
+
+  struct Named {
+    std::string name;
+
+    explicit Named(const std::string& name) : name(name) {}
+  };
+
+  TEST(ConcurrentHashMapTestSuite, TestConcurrentHashMap_ComputeIfAbsent_NoDefaultConstructor) {
+    ConcurrentHashMap<int, Named> map;
+    ASSERT_EQ("one", map.ComputeIfAbsent(1, [](const int&) { return Named("one"); }).name);
+    ASSERT_EQ("one", map.ComputeIfAbsent(1, [](const int&) { return Named("other"); }).name);
+  }
+
+  TEST(ConcurrentHashMapTestSuite, TestConcurrentHashMap_ForEach) {
+    ConcurrentHashMap<int, int> map(2);
+    for (int i = 0; i < 100; i++) { map.Put(i, i); }
+
+    long sum = 0;
+    int visited = 0;
+    map.ForEach([&map, &sum, &visited](const int& key, const int& value) {
+      sum += value;
+      visited++;
+      // updating while iterating is fine.
+      if (key % 2 == 0) {
+        map.Remove(key);
+      } else {
+        map.Put(key, -value);
+      }
+    });
+    ASSERT_EQ(100, visited);
+    ASSERT_EQ(99 * 100 / 2, sum);
+    ASSERT_EQ(50, map.Size());
+    ASSERT_FALSE(map.Contains(0));
+    int value;
+    ASSERT_TRUE(map.Get(1, value));
+    ASSERT_EQ(-1, value);
+  }
+
+  TEST(ConcurrentHashMapTestSuite, TestConcurrentHashMap_Concurrent) {
+    ConcurrentHashMap<int, int> map(4, 4);
+    const int numThreads = 8;
+    const int perThread = 5000;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+      threads.emplace_back([&map, t]() {
+        for (int i = 0; i < perThread; i++) {
+          int key = t * perThread + i;
+          map.Put(key, key);
+          int value;
+          ASSERT_TRUE(map.Get(key, value));
+          ASSERT_EQ(key, value);
+          if (i % 3 == 0) { ASSERT_TRUE(map.Remove(key)); }
+        }
+      });
+    }
+    for (auto& thread : threads) { thread.join(); }
+
+    long expected = numThreads * (perThread - (perThread + 2) / 3);
+    ASSERT_EQ(expected, map.Size());
+    long entries = 0;
+    map.ForEach([&entries](const int& key, const int& value) { 
+      ASSERT_EQ(key, value);
+      entries++; 
+    });
+    ASSERT_EQ(expected, entries);
+  }
+} // concurrenthashmaptest
+} // concurrent
+} // mdl
@@ -0,0 +1,155 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <mdl/concurrent.h>
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace mdl {
+namespace concurrent {
+namespace contextexecutortest {
+  std::atomic_int numCreated = 0;
+  std::atomic_int numDestroyed = 0;
+
+  struct Scratch {
+    std::string owner;
+    std::vector<int> buffer;
+    int uses = 0;
+
+    Scratch() : owner(this_thread::get_name()) { numCreated++; }
+    ~Scratch() { numDestroyed++; }
+  };
+
+  TEST(ContextExecutorTestSuite, ContextExecutorTest_OnePerWorker) {
+    numCreated = numDestroyed = 0;
+    ThreadFactory factory("my-thread");
+    ExecutorOptions options;
+    options.coreThreads = options.maxThreads = 3;
+    ContextExecutor<Scratch> executor(options, factory);
+
+    std::vector<Future<std::string>> futures;
+    for (int i = 0; i < 300; i++) {
+      futures.push_back(executor.Submit<std::string>([](Scratch& scratch) {
+        scratch.uses++;
+        scratch.buffer.push_back(scratch.uses);
+        // a worker's context is only ever used from that worker.
+        EXPECT_EQ(this_thread::get_name(), scratch.owner);
+        return scratch.owner;
+      }));
+    }
+
+    std::set<std::string> owners;
+    for (auto& future : futures) { owners.insert(future.Get()); }
+    ASSERT_LE(owners.size(), 3);
+    ASSERT_EQ(3, numCreated);
+
+    executor.Shutdown();
+    ASSERT_EQ(3, numDestroyed);
+  }
+
+  TEST(ContextExecutorTestSuite, ContextExecutorTest_Factory) {
+    ThreadFactory factory("my-thread");
+    ExecutorOptions options;
+    std::atomic_int started = 0;
+    options.onWorkerStart = [&started]() { started++; };
+    std::atomic_int next = 10;
+    ContextExecutor<int> executor(options, factory, [&next]() { 
+      return std::make_unique<int>(next++); 
+    });
+
+    ASSERT_EQ(10, executor.Submit<int>([](int& value) { return value++; }).Get());
+    ASSERT_EQ(11, executor.Submit<int>([](int& value) { return value; }).Get());
+    ASSERT_EQ(1, started);
+
+    CountDownLatch latch(1);
+    Future<int> cancelled = executor.Submit<int>([&latch](int& value, const CancellationToken& token) {
+      latch.CountDown();
+      while (!token.IsCancellationRequested()) { this_thread::sleep(1); }
+      return value;
+    });
+    latch.Await();
+    cancelled.Cancel();
+    ASSERT_TRUE(cancelled.IsCanceled());
+  }
+
+  TEST(ContextExecutorTestSuite, ContextExecutorTest_CallerRuns) {
+    numCreated = numDestroyed = 0;
+    ThreadFactory factory("my-thread");
+    ExecutorOptions options;
+    options.queueCapacity = 1;
+    options.rejectionPolicy = RejectionPolicy::kCallerRuns;
+    ContextExecutor<Scratch> executor(options, factory);
+    CountDownLatch latch(1);
+
+    executor.Execute([&latch](Scratch&) { latch.Await(); });
+    this_thread::sleep(20);
+    executor.Execute([](Scratch&) {});
+    // no room, so it runs right here, with a context of its own.
+    std::string caller = this_thread::get_name();
+    std::string owner;
+    executor.Execute([&owner](Scratch& scratch) { owner = scratch.owner; });
+    ASSERT_EQ(caller, owner);
+    ASSERT_EQ(2, numCreated);
+    ASSERT_EQ(1, numDestroyed);
+
+    latch.CountDown();
+    executor.Shutdown();
+    ASSERT_EQ(2, numDestroyed);
+  }
+
+  TEST(ContextExecutorTestSuite, ContextExecutorTest_CallerRuns_FromWorker) {
+    ThreadFactory factory("my-thread");
+    ExecutorOptions options;
+    options.queueCapacity = 1;
+    options.rejectionPolicy = RejectionPolicy::kCallerRuns;
+    std::atomic_int next = 0;
+    ContextExecutor<int> executor(options, factory, [&next]() { 
+      return std::make_unique<int>(next++); 
+    });
+    CountDownLatch latch(1);
+
+    Future<bool> shared = executor.Submit<bool>([&executor, &latch](int& outer) {
+      // fills the queue, so the next one runs right here, while this task still uses outer.
+      executor.Execute([&latch](int&) { latch.Await(); });
+      int inner = -1;
+      executor.Execute([&inner](int& context) { inner = context; });
+      latch.CountDown();
+      return inner == outer;
+    });
+    ASSERT_FALSE(shared.Get());
+    ASSERT_EQ(2, next);
+  }
+
+} // contextexecutortest
+} // concurrent
+} // mdl
@@ -258,6 +258,441 @@ namespace executorstest {
     ASSERT_FALSE(executed);
   }
 
+  TEST(ExecutorsTestSuite, ExecutorsTest_Elastic_GrowsAndShrinks) {
+    ThreadFactory factory("my-thread");
+    ExecutorOptions options;
+    options.coreThreads = 1;
+    options.maxThreads = 4;
+    options.keepAliveMillis = 100;
+    ExecutorService executor(options, factory);
+    ASSERT_EQ(1, executor.NumThreads());
+
+    std::atomic_int done = 0;
+    for (int i = 0; i < 8; i++) {
+      executor.Execute([&done]() {
+        this_thread::sleep(50);
+        done++;
+      });
+    }
+
+    ASSERT_EQ(4, executor.NumThreads());
+
+    // allow jobs to finish and extra workers to time out
+    this_thread::sleep(400);
+    ASSERT_EQ(8, done.load());
+    ASSERT_EQ(1, executor.NumThreads());
+
+    // still usable after shrinking
+    Future<int> future = executor.Submit<int>([]() { return 10; });
+    ASSERT_EQ(10, future.Get());
+    executor.Shutdown();
+    ASSERT_EQ(0, executor.NumThreads());
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_Elastic_GrowsOnWaitTime) {
+    ThreadFactory factory("my-thread");
+    ExecutorOptions options;
+    options.coreThreads = 1;
+    options.maxThreads = 2;
+    options.keepAliveMillis = 1000;
+    options.growQueueDepth = 0;
+    options.growWaitMillis = 20;
+    ExecutorService executor(options, factory);
+
+    for (int i = 0; i < 4; i++) {
+      executor.Execute([]() { this_thread::sleep(50); });
+    }
+
+    // depth alone doesn't grow the pool.
+    ASSERT_EQ(1, executor.NumThreads());
+
+    // the second task waited ~50ms to start, longer than allowed.
+    this_thread::sleep(80);
+    ASSERT_EQ(2, executor.NumThreads());
+    executor.Shutdown();
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_Elastic_GrowsOnWaitTime_WorkersBusy) {
+    ThreadFactory factory("my-thread");
+    ExecutorOptions options;
+    options.coreThreads = 1;
+    options.maxThreads = 2;
+    options.keepAliveMillis = 1000;
+    options.growQueueDepth = 0;
+    options.growWaitMillis = 20;
+    ExecutorService executor(options, factory);
+
+    executor.Execute([]() { this_thread::sleep(300); });
+    executor.Execute([]() {});
+    this_thread::sleep(50);
+    ASSERT_EQ(1, executor.NumThreads());
+
+    // the only worker won't dequeue for a while, but the head task is already overdue.
+    executor.Execute([]() {});
+    ASSERT_EQ(2, executor.NumThreads());
+    executor.Shutdown();
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_LowLatencyWaitPolicy) {
+    ThreadFactory factory("my-thread");
+    ExecutorOptions options;
+    options.coreThreads = 2;
+    options.maxThreads = 2;
+    options.waitPolicy = WaitPolicy::LowLatency();
+    ExecutorService executor(options, factory);
+
+    long sum = 0;
+    for (int i = 0; i < 1000; i++) {
+      sum += executor.Submit<int>([i]() { return i; }).Get();
+    }
+    ASSERT_EQ(999 * 1000 / 2, sum);
+    executor.Shutdown();
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_TestSubmit_CancelRunning) {
+    ThreadFactory factory("my-thread");
+    ExecutorService executor(1, factory);
+    std::atomic_bool started = false;
+    std::atomic_bool stopped = false;
+
+    Future<int> future = executor.Submit<int>([&started, &stopped](const CancellationToken& token) {
+      started = true;
+      while (!token.IsCancellationRequested()) {
+        this_thread::sleep(1);
+      }
+      stopped = true;
+      return 10;
+    });
+
+    while (!started) { this_thread::sleep(1); }
+    ASSERT_TRUE(future.Cancel());
+    ASSERT_TRUE(future.IsCanceled());
+    ASSERT_THROW(future.Get(), interrupted_exception);
+
+    // the worker is free again.
+    Future<int> next = executor.Submit<int>([]() { return 20; });
+    ASSERT_EQ(20, next.Get());
+    ASSERT_TRUE(stopped);
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_TestSubmit_CancelRunning_Blocked) {
+    ThreadFactory factory("my-thread");
+    ExecutorService executor(1, factory);
+    BlockingQueue<int> queue;
+
+    Future<int> future = executor.Submit<int>([&queue](const CancellationToken& token) {
+      return queue.Poll(token);
+    });
+
+    this_thread::sleep(50);
+    ASSERT_TRUE(future.Cancel());
+
+    Future<int> next = executor.Submit<int>([]() { return 20; });
+    ASSERT_EQ(20, next.Get());
+    ASSERT_EQ(0, queue.Size());
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_TestSubmit_CancelRunning_NotCooperative) {
+    ThreadFactory factory("my-thread");
+    ExecutorService executor(1, factory);
+    std::atomic_bool started = false;
+
+    Future<int> future = executor.Submit<int>([&started]() {
+      started = true;
+      this_thread::sleep(50);
+      return 10;
+    });
+
+    while (!started) { this_thread::sleep(1); }
+    ASSERT_FALSE(future.Cancel());
+    ASSERT_EQ(10, future.Get());
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_TestSubmitVoid) {
+    ThreadFactory factory("my-thread");
+    ExecutorService executor(1, factory);
+    std::atomic_bool executed = false;
+
+    Future<void> future = executor.Submit<void>([&executed]() {
+      this_thread::sleep(10);
+      executed = true;
+    });
+    future.Get();
+    ASSERT_TRUE(executed);
+
+    Future<void> failing = executor.Submit<void>([]() { throw 5; });
+    ASSERT_THROW(failing.Get(), execution_exception);
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_TestSubmitMoveOnly) {
+    ThreadFactory factory("my-thread");
+    ExecutorService executor(1, factory);
+
+    Future<std::unique_ptr<X>> future = executor.Submit<std::unique_ptr<X>>([]() {
+      return std::make_unique<X>(12);
+    });
+    ASSERT_EQ(12, future.Ref()->val);
+    ASSERT_EQ(12, future.Take()->val);
+  }
+
+  // Single worker held up by a latch, and a queue of two.
+  ExecutorOptions Bounded(RejectionPolicy policy) {
+    ExecutorOptions options;
+    options.queueCapacity = 2;
+    options.rejectionPolicy = policy;
+    return options;
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_Bounded_Abort) {
+    ThreadFactory factory("my-thread");
+    ExecutorService executor(Bounded(RejectionPolicy::kAbort), factory);
+    CountDownLatch latch(1);
+
+    executor.Execute([&latch]() { latch.Await(); });
+    this_thread::sleep(20);
+    executor.Execute([]() {});
+    executor.Execute([]() {});
+    ASSERT_THROW(executor.Execute([]() {}), rejected_exception);
+    ASSERT_THROW(executor.Submit<int>([]() { return 1; }), rejected_exception);
+    ASSERT_EQ(2, executor.NumRejected());
+
+    // room again once the worker catches up.
+    latch.CountDown();
+    this_thread::sleep(20);
+    ASSERT_EQ(3, executor.Submit<int>([]() { return 3; }).Get());
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_Bounded_Elastic) {
+    ThreadFactory factory("my-thread");
+    ExecutorOptions options = Bounded(RejectionPolicy::kAbort);
+    options.queueCapacity = 1;
+    options.coreThreads = 1;
+    options.maxThreads = 8;
+    // only a full queue grows the pool, so every new worker is started with a task.
+    options.growQueueDepth = 0;
+    ExecutorService executor(options, factory);
+    CountDownLatch latch(1);
+    CountDownLatch started(1);
+
+    executor.Execute([&latch, &started]() { 
+      started.CountDown();
+      latch.Await(); 
+    });
+    started.Await();
+    // one queued, and one for each worker the pool may still grow by.
+    for (int i = 0; i < 8; i++) {
+      executor.Execute([&latch]() { latch.Await(); });
+    }
+    ASSERT_EQ(0, executor.NumRejected());
+    ASSERT_EQ(8, executor.NumThreads());
+    ASSERT_THROW(executor.Execute([]() {}), rejected_exception);
+
+    latch.CountDown();
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_Bounded_CallerRuns) {
+    ThreadFactory factory("my-thread");
+    ExecutorService executor(Bounded(RejectionPolicy::kCallerRuns), factory);
+    CountDownLatch latch(1);
+
+    executor.Execute([&latch]() { latch.Await(); });
+    this_thread::sleep(20);
+    executor.Execute([]() {});
+    executor.Execute([]() {});
+
+    auto caller = std::this_thread::get_id();
+    Future<bool> future = executor.Submit<bool>([caller]() { 
+      return std::this_thread::get_id() == caller; 
+    });
+    // ran right away, by this thread.
+    ASSERT_TRUE(future.IsDone());
+    ASSERT_TRUE(future.Get());
+    latch.CountDown();
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_Bounded_Discard) {
+    ThreadFactory factory("my-thread");
+    ExecutorService executor(Bounded(RejectionPolicy::kDiscard), factory);
+    CountDownLatch latch(1);
+
+    executor.Execute([&latch]() { latch.Await(); });
+    this_thread::sleep(20);
+    Future<int> first = executor.Submit<int>([]() { return 1; });
+    Future<int> second = executor.Submit<int>([]() { return 2; });
+    Future<int> third = executor.Submit<int>([]() { return 3; });
+    ASSERT_TRUE(third.IsCanceled());
+
+    latch.CountDown();
+    ASSERT_EQ(1, first.Get());
+    ASSERT_EQ(2, second.Get());
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_Bounded_DiscardOldest) {
+    ThreadFactory factory("my-thread");
+    ExecutorService executor(Bounded(RejectionPolicy::kDiscardOldest), factory);
+    CountDownLatch latch(1);
+
+    executor.Execute([&latch]() { latch.Await(); });
+    this_thread::sleep(20);
+    Future<int> first = executor.Submit<int>([]() { return 1; });
+    Future<int> second = executor.Submit<int>([]() { return 2; });
+    Future<int> third = executor.Submit<int>([]() { return 3; });
+    ASSERT_TRUE(first.IsCanceled());
+
+    latch.CountDown();
+    ASSERT_EQ(2, second.Get());
+    ASSERT_EQ(3, third.Get());
+    ASSERT_EQ(1, executor.NumRejected());
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_Bounded_Block) {
+    ThreadFactory factory("my-thread");
+    ExecutorOptions options = Bounded(RejectionPolicy::kBlock);
+    options.blockTimeoutMillis = 30;
+    ExecutorService executor(options, factory);
+    CountDownLatch latch(1);
+
+    executor.Execute([&latch]() { latch.Await(); });
+    this_thread::sleep(20);
+    executor.Execute([]() {});
+    executor.Execute([]() {});
+    ASSERT_THROW(executor.Execute([]() {}), rejected_exception);
+
+    std::thread releaser([&latch]() {
+      this_thread::sleep(10);
+      latch.CountDown();
+    });
+    // room frees up within the timeout.
+    ASSERT_EQ(4, executor.Submit<int>([]() { return 4; }).Get());
+    releaser.join();
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_SlowTasks) {
+    ThreadFactory factory("my-thread");
+    ExecutorOptions options;
+    options.coreThreads = 1;
+    options.slowTaskMillis = 20;
+    options.watchdogIntervalMillis = 5;
+    Synchronizable sync;
+    std::vector<SlowTask> reported;
+    options.onSlowTask = [&](const SlowTask& task) {
+      sync.Synchronized<void>([&]() { reported.push_back(task); });
+    };
+    ExecutorService executor(options, factory);
+    CountDownLatch latch(1);
+
+    executor.Execute([]() {});
+    executor.Execute([&latch]() { latch.Await(); });
+    this_thread::sleep(60);
+
+    std::vector<SlowTask> slow = executor.SlowTasks();
+    ASSERT_EQ(1, slow.size());
+    ASSERT_EQ("my-thread-1", slow[0].worker);
+    ASSERT_GE(slow[0].runningMillis, 20);
+    latch.CountDown();
+    executor.Shutdown();
+
+    // reported once, however long it ran.
+    ASSERT_EQ(1, executor.NumSlowTasks());
+    ASSERT_EQ(1, reported.size());
+    ASSERT_EQ("my-thread-1", reported[0].worker);
+    ASSERT_TRUE(reported[0].stackTrace.empty());
+    ASSERT_TRUE(executor.SlowTasks().empty());
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_SlowTasks_StackTrace) {
+    ThreadFactory factory("my-thread");
+    ExecutorOptions options;
+    options.coreThreads = 1;
+    options.slowTaskMillis = 10;
+    options.captureStackTraces = true;
+    Synchronizable sync;
+    std::string stackTrace;
+    options.onSlowTask = [&](const SlowTask& task) {
+      sync.Synchronized<void>([&]() { stackTrace = task.stackTrace; });
+    };
+    ExecutorService executor(options, factory);
+    CountDownLatch latch(1);
+
+    executor.Execute([&latch]() { latch.Await(); });
+    this_thread::sleep(50);
+    latch.CountDown();
+    executor.Shutdown();
+
+#ifdef __linux__
+    ASSERT_FALSE(stackTrace.empty());
+#endif
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_CurrentStackTrace) {
+#ifdef __linux__
+    ASSERT_FALSE(CurrentStackTrace().empty());
+#else
+    ASSERT_TRUE(CurrentStackTrace().empty());
+#endif
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_ManagedBlocking_Future) {
+    ThreadFactory factory("my-thread");
+    ExecutorOptions options;
+    options.maxCompensationThreads = 2;
+    ExecutorService executor(options, factory);
+
+    // with a single worker, waiting on a task queued behind this one would never return.
+    Future<int> outer = executor.Submit<int>([&executor]() {
+      Future<int> inner = executor.Submit<int>([]() { return 2; });
+      return inner.Get() * 21;
+    });
+    ASSERT_EQ(42, outer.Get());
+
+    // the extra worker retires once nothing is blocked anymore.
+    this_thread::sleep(20);
+    ASSERT_EQ(1, executor.NumThreads());
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_ManagedBlocking_Queue) {
+    ThreadFactory factory("my-thread");
+    ExecutorOptions options;
+    options.coreThreads = options.maxThreads = 2;
+    options.maxCompensationThreads = 2;
+    ExecutorService executor(options, factory);
+    BlockingQueue<int> queue;
+    Semaphore semaphore;
+    CountDownLatch done(3);
+
+    // both workers block, one on a queue and one on a semaphore, fed by a task queued after.
+    executor.Execute([&]() { 
+      ASSERT_EQ(7, queue.Poll());
+      done.CountDown();
+    });
+    executor.Execute([&]() { 
+      semaphore.Down();
+      done.CountDown();
+    });
+    executor.Execute([&]() { 
+      queue.Add(7);
+      semaphore.Up();
+      done.CountDown();
+    });
+    done.Await();
+    ASSERT_LE(executor.NumThreads(), 4);
+  }
+
+  TEST(ExecutorsTestSuite, ExecutorsTest_ManagedBlocking_Disabled) {
+    ThreadFactory factory("my-thread");
+    ExecutorService executor(1, factory);
+    CountDownLatch latch(1);
+
+    Future<void> blocked = executor.Submit<void>([&latch]() { 
+      ManagedBlock block;
+      latch.Await(); 
+    });
+    this_thread::sleep(20);
+    ASSERT_EQ(1, executor.NumThreads());
+    latch.CountDown();
+    blocked.Get();
+  }
+
 } // threadtest
 } // concurrent
 } // mdl
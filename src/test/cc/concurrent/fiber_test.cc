@@ -0,0 +1,153 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <mdl/concurrent.h>
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace mdl {
+namespace concurrent {
+namespace fibertest {
+  // Deep enough to want a real stack, and then some.
+  long Fibonacci(int n) {
+    if (n < 2) { return n; }
+    this_fiber::yield();
+    return Fibonacci(n - 1) + Fibonacci(n - 2);
+  }
+
+  TEST(FiberTestSuite, FiberTest_Submit) {
+    ThreadFactory factory("my-thread");
+    ExecutorService executor(2, factory);
+    FiberScheduler scheduler(executor);
+
+    Future<long> fibonacci = scheduler.Submit<long>([]() { return Fibonacci(15); });
+    Future<bool> active = scheduler.Submit<bool>([]() { return this_fiber::active(); });
+    Future<int> failed = scheduler.Submit<int>([]() -> int { 
+      this_fiber::yield();
+      throw std::runtime_error("failed"); 
+    });
+
+    ASSERT_EQ(610, fibonacci.Get());
+    ASSERT_TRUE(active.Get());
+    ASSERT_FALSE(this_fiber::active());
+    ASSERT_THROW(failed.Get(), execution_exception);
+  }
+
+  TEST(FiberTestSuite, FiberTest_BlockingYields) {
+    ThreadFactory factory("my-thread");
+    // a single worker: any of these parking it would hang the test.
+    ExecutorService executor(1, factory);
+    FiberScheduler scheduler(executor);
+    BlockingQueue<int> queue;
+    Semaphore semaphore;
+    // nobody ever ups this one, so the timeout can't lose a race against the other fibers.
+    Semaphore never;
+    Promise<int> promise;
+    Future<int> promised = promise.GetFuture();
+
+    Future<int> polled = scheduler.Submit<int>([&queue]() { return queue.Poll(); });
+    Future<void> downed = scheduler.Submit<void>([&semaphore]() { semaphore.Down(); });
+    Future<int> got = scheduler.Submit<int>([&promised]() { return promised.Get(); });
+    Future<bool> timedOut = scheduler.Submit<bool>([&never]() { return never.TryDown(10); });
+    scheduler.Execute([&]() {
+      this_fiber::sleep(20);
+      queue.Add(1);
+      semaphore.Up();
+      promise.Set(3);
+    });
+
+    ASSERT_EQ(1, polled.Get());
+    downed.Get();
+    ASSERT_EQ(3, got.Get());
+    ASSERT_FALSE(timedOut.Get());
+  }
+
+  TEST(FiberTestSuite, FiberTest_WokenUp) {
+    ThreadFactory factory("my-thread");
+    ExecutorService executor(1, factory);
+    FiberScheduler scheduler(executor);
+    const int kFibers = 100;
+    Semaphore semaphore;
+    Semaphore interrupted;
+    CancellationSource source;
+    std::atomic_int through = 0;
+
+    for (int i = 0; i < kFibers; i++) {
+      scheduler.Execute([&semaphore, &through]() {
+        semaphore.Down();
+        through++;
+      });
+    }
+    Future<void> cancelled = scheduler.Submit<void>([&semaphore, &source]() { 
+      semaphore.Down(source.Token()); 
+    });
+    Future<void> interrupt = scheduler.Submit<void>([&interrupted]() { interrupted.Down(); });
+    this_thread::sleep(20);
+    ASSERT_EQ(0, through.load());
+
+    source.Cancel();
+    ASSERT_THROW(cancelled.Get(), execution_exception);
+    interrupted.InterruptAll();
+    ASSERT_THROW(interrupt.Get(), execution_exception);
+    for (int i = 0; i < kFibers; i++) { semaphore.Up(); }
+    while (scheduler.NumFibers() > 0) { this_thread::sleep(1); }
+    ASSERT_EQ(kFibers, through.load());
+    ASSERT_EQ(0, semaphore.NumTickets());
+  }
+
+  TEST(FiberTestSuite, FiberTest_Many) {
+    ThreadFactory factory("my-thread");
+    ExecutorService executor(4, factory);
+    FiberOptions options;
+    options.stackSize = 16 * 1024;
+    const int kFibers = 10000;
+    std::atomic_long sum = 0;
+    Promise<int> promise;
+    Future<int> start = promise.GetFuture();
+
+    {
+      FiberScheduler scheduler(executor, options);
+      for (int i = 0; i < kFibers; i++) {
+        scheduler.Execute([i, &sum, start]() mutable {
+          sum += start.Get() * i;
+        });
+      }
+      this_thread::sleep(20);
+      ASSERT_GT(scheduler.NumFibers(), 0);
+      promise.Set(2);
+      // waits for them all.
+    }
+    ASSERT_EQ(2L * kFibers * (kFibers - 1) / 2, sum.load());
+  }
+
+} // fibertest
+} // concurrent
+} // mdl
@@ -28,9 +28,12 @@
 
 #include <mdl/concurrent.h>
 
+#include <atomic>
 #include <gtest/gtest.h>
+#include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 
 using std::cout;
 using std::endl;
@@ -217,6 +220,223 @@ template<class T>
     
     t1.join();
   }
+
+  TEST(FutureTestSuite, FutureTest_MultiThread_ManyGetters) {
+    TestFuture<int> future;
+    std::atomic_int sum = 0;
+    std::vector<std::thread> getters;
+    for (int i = 0; i < 8; i++) {
+      getters.emplace_back([future, &sum]() mutable {
+        sum += future.Get();
+      });
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(50));
+    future.Set(10);
+    for (auto& t : getters) { t.join(); }
+    ASSERT_EQ(80, sum.load());
+  }
+
+  TEST(FutureTestSuite, FutureTest_MultiThread_RacingCompletions) {
+    for (int i = 0; i < 200; i++) {
+      TestFuture<int> future;
+      std::atomic_int cancelled = 0;
+
+      std::thread t1([future]() mutable { future.Set(1); });
+      std::thread t2([future]() mutable { future.SetError("No good", 2); });
+      std::thread t3([future, &cancelled]() mutable { cancelled += future.Cancel(); });
+      t1.join();
+      t2.join();
+      t3.join();
+
+      // exactly one of them wins, and the outcome sticks.
+      ASSERT_TRUE(future.IsDone());
+      if (cancelled) {
+        ASSERT_TRUE(future.IsCanceled());
+        ASSERT_THROW(future.Get(), interrupted_exception);
+      } else {
+        ASSERT_FALSE(future.IsCanceled());
+        try {
+          ASSERT_EQ(1, future.Get());
+        } catch (const execution_exception& ex) {
+          ASSERT_EQ(2, ex.what_code());
+        }
+      }
+    }
+  }
+
+  TEST(FutureTestSuite, FutureTest_StartedNotCancellable) {
+    TestFuture<int> future;
+    ASSERT_TRUE(future.Start());
+    ASSERT_FALSE(future.Cancel());
+    ASSERT_FALSE(future.IsDone());
+    future.Set(10);
+    ASSERT_EQ(10, future.Get());
+    ASSERT_FALSE(future.Start());
+
+    TestFuture<int> cancelled;
+    ASSERT_TRUE(cancelled.Cancel());
+    ASSERT_FALSE(cancelled.Start());
+  }
+
+  TEST(FutureTestSuite, PromiseTest_Set) {
+    Promise<int> promise;
+    Future<int> future = promise.GetFuture();
+    ASSERT_FALSE(future.IsDone());
+
+    ASSERT_TRUE(promise.Set(10));
+    ASSERT_FALSE(promise.Set(20));
+    ASSERT_FALSE(promise.SetError("Not good", 1));
+    ASSERT_TRUE(future.IsDone());
+    ASSERT_EQ(10, future.Get());
+  }
+
+  TEST(FutureTestSuite, PromiseTest_SetError) {
+    Promise<std::string> promise;
+    Future<std::string> future = promise.GetFuture();
+
+    ASSERT_TRUE(promise.SetError("Not good", 2));
+    try {
+      future.Get();
+      FAIL();
+    } catch (const execution_exception& ex) {
+      ASSERT_STREQ("Not good", ex.what());
+      ASSERT_EQ(2, ex.what_code());
+    }
+  }
+
+  TEST(FutureTestSuite, PromiseTest_MultiThread) {
+    Promise<std::string> promise;
+    std::thread t1([promise]() mutable {
+      std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(50));
+      promise.Set("done");
+    });
+
+    ASSERT_EQ("done", promise.GetFuture().Get());
+    t1.join();
+  }
+
+  TEST(FutureTestSuite, PromiseTest_Cancel) {
+    Promise<int> promise;
+    CancellationToken token = promise.Token();
+    Future<int> future = promise.GetFuture();
+
+    ASSERT_TRUE(future.Cancel());
+    ASSERT_TRUE(promise.IsCanceled());
+    ASSERT_TRUE(token.IsCancellationRequested());
+    ASSERT_FALSE(promise.Set(10));
+    ASSERT_THROW(future.Get(), interrupted_exception);
+  }
+
+  TEST(FutureTestSuite, PromiseTest_Abandoned) {
+    Future<int> future = Promise<int>().GetFuture();
+    ASSERT_TRUE(future.IsDone());
+    ASSERT_THROW(future.Get(), execution_exception);
+
+    Future<int> future2;
+    {
+      Promise<int> p1;
+      Promise<int> p2 = p1;
+      future2 = p1.GetFuture();
+    }
+    ASSERT_THROW(future2.Get(), execution_exception);
+  }
+
+  TEST(FutureTestSuite, PromiseTest_RecyclesState) {
+    typedef util::BlockPool<sizeof(_FutureState<int>), alignof(_FutureState<int>)> Pool;
+    {
+      Promise<int> promise;
+      promise.Set(1);
+      ASSERT_EQ(1, promise.GetFuture().Get());
+    }
+    int cached = Pool::Cached();
+    ASSERT_GT(cached, 0);
+
+    // a new future takes its state from the pool, and gives it back when done.
+    {
+      Promise<int> promise;
+      Future<int> future = promise.GetFuture();
+      Future<int> copy = future;
+      ASSERT_EQ(cached - 1, Pool::Cached());
+    }
+    ASSERT_EQ(cached, Pool::Cached());
+  }
+
+  TEST(FutureTestSuite, FutureTest_Move) {
+    Promise<int> promise;
+    Future<int> future = promise.GetFuture();
+
+    Future<int> moved = std::move(future);
+    ASSERT_TRUE(future.IsDone());
+    ASSERT_THROW(future.Get(), execution_exception);
+    ASSERT_FALSE(moved.IsDone());
+
+    // the moved from promise no longer counts, nor completes anything.
+    Promise<int> other = std::move(promise);
+    ASSERT_FALSE(promise.Set(1));
+    promise = Promise<int>();
+    ASSERT_FALSE(moved.IsDone());
+
+    other.Set(10);
+    ASSERT_EQ(10, moved.Get());
+  }
+
+  TEST(FutureTestSuite, FutureTest_TakeAndRef) {
+    Promise<std::vector<int>> promise;
+    Future<std::vector<int>> future = promise.GetFuture();
+    promise.Set(std::vector<int>({1, 2, 3}));
+
+    const std::vector<int>& ref = future.Ref();
+    ASSERT_EQ(3, ref.size());
+    ASSERT_EQ(&ref, &future.Ref());
+    ASSERT_EQ(std::vector<int>({1, 2, 3}), future.Get());
+
+    std::vector<int> taken = future.Take();
+    ASSERT_EQ(std::vector<int>({1, 2, 3}), taken);
+    ASSERT_THROW(future.Take(), std::runtime_error);
+    ASSERT_THROW(future.Get(), std::runtime_error);
+    ASSERT_THROW(future.Ref(), std::runtime_error);
+  }
+
+  TEST(FutureTestSuite, FutureTest_MoveOnly) {
+    Promise<std::unique_ptr<int>> promise;
+    Future<std::unique_ptr<int>> future = promise.GetFuture();
+    promise.Set(std::make_unique<int>(10));
+
+    ASSERT_EQ(10, *future.Ref());
+    std::unique_ptr<int> value = future.Take();
+    ASSERT_EQ(10, *value);
+  }
+
+  struct NoDefault {
+    int val;
+    NoDefault(int val) : val(val) {}
+  };
+
+  TEST(FutureTestSuite, FutureTest_NotDefaultConstructible) {
+    Promise<NoDefault> promise;
+    Future<NoDefault> future = promise.GetFuture();
+    promise.Set(7);
+    ASSERT_EQ(7, future.Get().val);
+  }
+
+  TEST(FutureTestSuite, FutureTest_Void) {
+    Promise<void> promise;
+    Future<void> future = promise.GetFuture();
+    ASSERT_FALSE(future.IsDone());
+
+    std::thread t1([promise]() mutable {
+      std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(50));
+      promise.Set();
+    });
+    future.Get();
+    ASSERT_TRUE(future.IsDone());
+    t1.join();
+
+    Promise<void> failing;
+    failing.SetError("Not good", 3);
+    ASSERT_THROW(failing.GetFuture().Get(), execution_exception);
+  }
 } // futuretestsuite
 } // concurrent
 } // mdl
@@ -0,0 +1,93 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include <mdl/concurrent.h>
+#include <mdl/util.h>
+
+namespace mdl {
+namespace concurrent {
+namespace latchtest {
+  TEST(LatchTestSuite, TestLatch_CountsDown) {
+    CountDownLatch latch(3);
+    ASSERT_EQ(3, latch.Count());
+    util::instant start = util::Now();
+    ASSERT_FALSE(latch.Await(10));
+    ASSERT_GE(util::EllapsedTime(start, util::Now()) / 1000L, 10);
+
+    latch.CountDown();
+    latch.CountDown(5);
+    ASSERT_EQ(0, latch.Count());
+    ASSERT_TRUE(latch.Await(0));
+    latch.Await();
+    latch.CountDown();
+    ASSERT_EQ(0, latch.Count());
+  }
+
+  TEST(LatchTestSuite, TestLatch_NegativeCountDown) {
+    CountDownLatch latch(3);
+    ASSERT_THROW(latch.CountDown(-1), std::invalid_argument);
+    ASSERT_EQ(3, latch.Count());
+  }
+
+  void TestReleasesWaiters(const WaitPolicy& policy) {
+    CountDownLatch start(1, policy);
+    CountDownLatch done(8, policy);
+    std::atomic_int passed = 0;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; i++) {
+      threads.emplace_back([&start, &done, &passed]() {
+        start.Await();
+        passed++;
+        done.CountDown();
+      });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_EQ(0, passed);
+    start.CountDown();
+    ASSERT_TRUE(done.Await(5000));
+    ASSERT_EQ(8, passed);
+    for (auto& t : threads) { t.join(); }
+  }
+
+  TEST(LatchTestSuite, TestLatch_ReleasesWaiters) {
+    TestReleasesWaiters(WaitPolicy::Park());
+  }
+
+  TEST(LatchTestSuite, TestLatch_ReleasesWaiters_Spinning) {
+    TestReleasesWaiters(WaitPolicy::LowLatency());
+  }
+} // latchtest
+} // concurrent
+} // mdl
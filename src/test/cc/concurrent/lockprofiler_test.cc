@@ -0,0 +1,125 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mdl/concurrent.h>
+
+namespace mdl {
+namespace concurrent {
+namespace lockprofilertest {
+  bool Find(const std::string& name, LockStats& stats) {
+    for (const LockStats& s : LockProfiler::Snapshot()) {
+      if (s.name == name) {
+        stats = s;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  TEST(LockProfilerTestSuite, TestLockProfiler_Synchronizable) {
+    Synchronizable sync("lockprofilertest.sync");
+    Synchronizable contender("lockprofilertest.contender");
+    LockStats stats;
+
+    if (!LockProfiler::Enabled()) {
+      // nothing to profile, and nothing to report.
+      sync.Synchronized<void>([]() {});
+      ASSERT_FALSE(Find("lockprofilertest.sync", stats));
+      ASSERT_TRUE(LockProfiler::TopContended(10).empty());
+      ASSERT_EQ("", LockProfiler::Dump());
+      return;
+    }
+
+    for (int i = 0; i < 10; i++) {
+      sync.Synchronized<void>([&sync]() { 
+        sync.Notify();
+        // reentrant, counts once.
+        sync.Synchronized<void>([]() {});
+      });
+    }
+    sync.Synchronized<void>([&sync]() { sync.Wait(1); });
+
+    std::thread holder([&contender]() {
+      contender.Synchronized<void>([]() { this_thread::sleep(50); });
+    });
+    this_thread::sleep(10);
+    contender.Synchronized<void>([]() {});
+    holder.join();
+
+    ASSERT_TRUE(Find("lockprofilertest.sync", stats));
+    ASSERT_EQ(11, stats.acquisitions);
+    ASSERT_EQ(0, stats.contended);
+    ASSERT_EQ(10, stats.notifies);
+    ASSERT_EQ(1, stats.waits);
+
+    ASSERT_TRUE(Find("lockprofilertest.contender", stats));
+    ASSERT_EQ(2, stats.acquisitions);
+    ASSERT_EQ(1, stats.contended);
+    ASSERT_GE(stats.maxWaitMicros, 20000);
+    ASSERT_GE(stats.holdMicros, 40000);
+
+    std::vector<LockStats> top = LockProfiler::TopContended(1);
+    ASSERT_EQ(1, top.size());
+    ASSERT_EQ("lockprofilertest.contender", top[0].name);
+    ASSERT_NE(std::string::npos, LockProfiler::Dump().find("lockprofilertest.contender"));
+
+    LockProfiler::Reset();
+    ASSERT_TRUE(Find("lockprofilertest.contender", stats));
+    ASSERT_EQ(0, stats.acquisitions);
+  }
+
+  TEST(LockProfilerTestSuite, TestLockProfiler_Semaphore) {
+    LockStats stats;
+    {
+      Semaphore semaphore("lockprofilertest.semaphore", 1);
+      semaphore.Down();
+      std::thread upper([&semaphore]() {
+        this_thread::sleep(10);
+        semaphore.Up();
+      });
+      semaphore.Down();
+      upper.join();
+
+      if (LockProfiler::Enabled()) {
+        ASSERT_TRUE(Find("lockprofilertest.semaphore", stats));
+        ASSERT_EQ(3, stats.acquisitions);
+        ASSERT_EQ(1, stats.waits);
+        ASSERT_EQ(1, stats.notifies);
+      }
+    }
+    // gone with its semaphore.
+    ASSERT_FALSE(Find("lockprofilertest.semaphore", stats));
+  }
+} // lockprofilertest
+} // concurrent
+} // mdl
@@ -0,0 +1,136 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <mdl/concurrent.h>
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace mdl {
+namespace concurrent {
+namespace partitionedexecutortest {
+  TEST(PartitionedExecutorTestSuite, PartitionedExecutorTest_SameKeySameWorker) {
+    ThreadFactory factory("partition");
+    PartitionedExecutor executor(4, factory);
+    const int kKeys = 40;
+    const int kTasks = 100;
+
+    // written without locks: each key only ever touched by its own partition's worker.
+    std::vector<std::vector<int>> seen(kKeys);
+    std::vector<std::string> workers(kKeys);
+    std::atomic_bool moved = false;
+    CountDownLatch done(kKeys * kTasks);
+
+    for (int i = 0; i < kTasks; i++) {
+      for (int key = 0; key < kKeys; key++) {
+        executor.Execute(key, [&, key, i]() {
+          if (workers[key].empty()) { workers[key] = this_thread::get_name(); }
+          if (workers[key] != this_thread::get_name()) { moved = true; }
+          seen[key].push_back(i);
+          done.CountDown();
+        });
+      }
+    }
+
+    ASSERT_TRUE(done.Await(10000));
+    ASSERT_FALSE(moved);
+    for (int key = 0; key < kKeys; key++) {
+      ASSERT_EQ(kTasks, seen[key].size());
+      for (int i = 0; i < kTasks; i++) { ASSERT_EQ(i, seen[key][i]); }
+    }
+
+    long executed = 0;
+    for (auto& stats : executor.Stats()) { executed += stats.executed; }
+    ASSERT_EQ(kKeys * kTasks, executed);
+  }
+
+  TEST(PartitionedExecutorTestSuite, PartitionedExecutorTest_Submit) {
+    ThreadFactory factory("partition");
+    PartitionedExecutor executor(2, factory);
+
+    Future<std::string> future = executor.Submit<std::string>(std::string("account-1"), 
+        std::function<std::string ()>([]() { return this_thread::get_name(); }));
+    std::string worker = future.Get();
+    ASSERT_EQ(worker, (executor.Submit<std::string>(std::string("account-1"), 
+        std::function<std::string ()>([]() { return this_thread::get_name(); })).Get()));
+
+    Future<int> failing = executor.Submit<int>(7, std::function<int ()>([]() -> int { 
+      throw std::runtime_error("Bad"); 
+    }));
+    ASSERT_THROW(failing.Get(), execution_exception);
+  }
+
+  TEST(PartitionedExecutorTestSuite, PartitionedExecutorTest_RebalancesIdleBuckets) {
+    ThreadFactory factory("partition");
+    PartitionedExecutorOptions options;
+    options.partitions = 2;
+    options.bucketsPerPartition = 8;
+    options.hotRatio = 1.2;
+    PartitionedExecutor executor(options, factory);
+
+    // keys that all start out on the first partition.
+    std::vector<int> hotKeys;
+    for (int key = 0; hotKeys.size() < 6; key++) {
+      if (executor.PartitionOf(key) == 0) { hotKeys.push_back(key); }
+    }
+
+    // while their tasks are stuck behind a slow one nothing may move.
+    CountDownLatch release(1);
+    executor.Execute(hotKeys[0], [&release]() { release.Await(); });
+    std::atomic_int ran = 0;
+    for (int i = 0; i < 20; i++) {
+      for (int key : hotKeys) {
+        executor.Execute(key, [&ran]() { ran++; });
+      }
+    }
+    ASSERT_EQ(0, executor.Rebalance());
+    ASSERT_GT(executor.Stats()[0].queued, 0);
+
+    release.CountDown();
+    while (ran < 20 * (int) hotKeys.size()) { this_thread::sleep(1); }
+    while (executor.Stats()[0].queued > 0) { this_thread::sleep(1); }
+    this_thread::sleep(10);
+
+    ASSERT_GT(executor.Rebalance(), 0);
+    std::vector<PartitionStats> stats = executor.Stats();
+    ASSERT_EQ(16, stats[0].buckets + stats[1].buckets);
+    ASSERT_GT(stats[1].buckets, 8);
+
+    int onSecond = 0;
+    for (int key : hotKeys) { onSecond += executor.PartitionOf(key); }
+    ASSERT_GT(onSecond, 0);
+    ASSERT_LT(onSecond, (int) hotKeys.size());
+  }
+} // partitionedexecutortest
+} // concurrent
+} // mdl
@@ -0,0 +1,127 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <mdl/concurrent.h>
+
+namespace mdl {
+namespace concurrent {
+namespace phasertest {
+  TEST(PhaserTestSuite, TestPhaser_ArriveWithoutWaiting) {
+    std::vector<int> advanced;
+    Phaser phaser(2, [&advanced](int phase) { advanced.push_back(phase); });
+    ASSERT_EQ(0, phaser.Phase());
+
+    ASSERT_EQ(0, phaser.Arrive());
+    ASSERT_EQ(1, phaser.UnarrivedParties());
+    ASSERT_FALSE(phaser.AwaitAdvance(0, 10));
+    ASSERT_EQ(0, phaser.Arrive());
+
+    ASSERT_EQ(1, phaser.Phase());
+    ASSERT_EQ(2, phaser.UnarrivedParties());
+    ASSERT_EQ(std::vector<int>({0}), advanced);
+    ASSERT_TRUE(phaser.AwaitAdvance(0, 10));
+  }
+
+  TEST(PhaserTestSuite, TestPhaser_RegisterAndDeregister) {
+    Phaser phaser;
+    ASSERT_THROW(phaser.Arrive(), std::logic_error);
+
+    ASSERT_EQ(0, phaser.Register());
+    ASSERT_EQ(0, phaser.Register(2));
+    ASSERT_EQ(3, phaser.RegisteredParties());
+
+    phaser.ArriveAndDeregister();
+    phaser.Arrive();
+    ASSERT_EQ(2, phaser.RegisteredParties());
+    ASSERT_EQ(0, phaser.Phase());
+
+    phaser.ArriveAndDeregister();
+    ASSERT_EQ(1, phaser.Phase());
+    ASSERT_EQ(1, phaser.RegisteredParties());
+
+    phaser.ArriveAndDeregister();
+    ASSERT_EQ(2, phaser.Phase());
+    ASSERT_EQ(0, phaser.RegisteredParties());
+  }
+
+  TEST(PhaserTestSuite, TestPhaser_LastDeregisterAdvancesAfterCallback) {
+    std::atomic_bool inCallback = false;
+    std::atomic_bool done = false;
+    Phaser phaser(1, [&inCallback, &done](int) {
+      inCallback = true;
+      std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(100));
+      done = true;
+    });
+
+    std::thread leaver([&phaser]() { phaser.ArriveAndDeregister(); });
+    while (!inCallback) { std::this_thread::yield(); }
+
+    // neither sees the next phase before onAdvance is through with this one.
+    ASSERT_EQ(1, phaser.AwaitAdvance(0));
+    ASSERT_TRUE(done);
+    ASSERT_EQ(1, phaser.Register());
+    leaver.join();
+    ASSERT_EQ(1, phaser.Phase());
+  }
+
+  TEST(PhaserTestSuite, TestPhaser_DynamicParties) {
+    const int kWorkers = 4;
+    std::atomic_int advances = 0;
+    Phaser phaser(1, [&advances](int) { advances++; }, WaitPolicy::LowLatency());
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kWorkers; i++) {
+      phaser.Register();
+      // worker i leaves after i + 1 phases.
+      threads.emplace_back([&phaser, i]() {
+        for (int p = 0; p < i; p++) {
+          phaser.ArriveAndAwaitAdvance();
+        }
+        phaser.ArriveAndDeregister();
+      });
+    }
+
+    for (int p = 0; p < kWorkers; p++) {
+      ASSERT_EQ(p + 1, phaser.ArriveAndAwaitAdvance());
+      // worker p + 1 may already be gone too.
+      ASSERT_LE(phaser.RegisteredParties(), kWorkers - p);
+    }
+    for (auto& t : threads) { t.join(); }
+
+    ASSERT_EQ(kWorkers, advances);
+    ASSERT_EQ(1, phaser.RegisteredParties());
+  }
+} // phasertest
+} // concurrent
+} // mdl
@@ -0,0 +1,215 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <mdl/concurrent.h>
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mdl {
+namespace concurrent {
+namespace pipelinetest {
+  TEST(PipelineTestSuite, PipelineTest_Ordered) {
+    ThreadFactory factory("pipeline");
+    StageOptions parallel;
+    parallel.parallelism = 4;
+    parallel.capacity = 8;
+
+    auto pipeline = PipelineBuilder<std::string>(factory, 8)
+        .Stage<int>("parse", [](std::string line) { return std::stoi(line); })
+        .Stage<long>("square", [](int n) {
+          // out of order on purpose.
+          if (n % 7 == 0) { this_thread::sleep(2); }
+          return (long) n * n;
+        }, parallel)
+        .Build();
+
+    const int count = 200;
+    std::thread producer([&pipeline]() {
+      for (int i = 0; i < count; i++) { pipeline->Push(std::to_string(i)); }
+      pipeline->Close();
+    });
+
+    long result;
+    for (int i = 0; i < count; i++) {
+      ASSERT_TRUE(pipeline->Next(result));
+      ASSERT_EQ((long) i * i, result);
+    }
+    ASSERT_FALSE(pipeline->Next(result));
+    ASSERT_FALSE(pipeline->Next(result));
+    producer.join();
+
+    std::vector<StageStats> stats = pipeline->Stats();
+    ASSERT_EQ(2, stats.size());
+    ASSERT_EQ("parse", stats[0].name);
+    ASSERT_EQ(count, stats[0].processed);
+    ASSERT_EQ(4, stats[1].parallelism);
+    ASSERT_EQ(count, stats[1].processed);
+    ASSERT_GT(stats[1].busyMicros, 0);
+    ASSERT_GT(stats[1].throughput, 0);
+  }
+
+  TEST(PipelineTestSuite, PipelineTest_Ordered_SlowConsumer) {
+    ThreadFactory factory("pipeline");
+    StageOptions parallel;
+    parallel.parallelism = 4;
+    parallel.capacity = 1;
+
+    // the output is full most of the time, workers park results while one of them waits on it.
+    auto pipeline = PipelineBuilder<int>(factory, 1)
+        .Stage<int>("id", [](int n) { return n; }, parallel)
+        .Build();
+
+    const int count = 50;
+    std::thread producer([&pipeline]() {
+      for (int i = 0; i < count; i++) { pipeline->Push(i); }
+      pipeline->Close();
+    });
+
+    int result;
+    for (int i = 0; i < count; i++) {
+      if (i % 10 == 0) { this_thread::sleep(5); }
+      ASSERT_TRUE(pipeline->Next(result));
+      ASSERT_EQ(i, result);
+    }
+    ASSERT_FALSE(pipeline->Next(result));
+    producer.join();
+  }
+
+  TEST(PipelineTestSuite, PipelineTest_UnorderedAndBatched) {
+    ThreadFactory factory("pipeline");
+    StageOptions unordered;
+    unordered.parallelism = 3;
+    unordered.ordered = false;
+
+    auto pipeline = PipelineBuilder<int>(factory)
+        .Stage<int>("double", [](int n) { return 2 * n; }, unordered)
+        .Batch(16)
+        .Build();
+
+    const int count = 100;
+    for (int i = 0; i < count; i++) { pipeline->Push(i); }
+    pipeline->Close();
+    ASSERT_THROW(pipeline->Push(0), std::logic_error);
+
+    std::vector<int> batch;
+    std::vector<bool> seen(2 * count, false);
+    int batches = 0;
+    int items = 0;
+    while (pipeline->Next(batch)) {
+      batches++;
+      ASSERT_LE(batch.size(), 16);
+      for (int n : batch) { 
+        ASSERT_FALSE(seen[n]);
+        seen[n] = true; 
+        items++;
+      }
+    }
+    ASSERT_EQ(count, items);
+    ASSERT_EQ(7, batches);
+  }
+
+  TEST(PipelineTestSuite, PipelineTest_BatchFlushesOnDelay) {
+    ThreadFactory factory("pipeline");
+    auto pipeline = PipelineBuilder<int>(factory).Batch(10, 20).Build();
+
+    pipeline->Push(1);
+    pipeline->Push(2);
+    std::vector<int> batch;
+    ASSERT_TRUE(pipeline->Next(batch));
+    ASSERT_EQ(std::vector<int>({1, 2}), batch);
+
+    pipeline->Push(3);
+    pipeline->Close();
+    ASSERT_TRUE(pipeline->Next(batch));
+    ASSERT_EQ(std::vector<int>({3}), batch);
+    ASSERT_FALSE(pipeline->Next(batch));
+  }
+
+  TEST(PipelineTestSuite, PipelineTest_ErrorPropagates) {
+    ThreadFactory factory("pipeline");
+    StageOptions small;
+    small.capacity = 2;
+
+    auto pipeline = PipelineBuilder<int>(factory, 2)
+        .Stage<int>("check", [](int n) {
+          if (n == 50) { throw std::runtime_error("Bad record"); }
+          return n;
+        }, small)
+        .Stage<int>("slow", [](int n) {
+          this_thread::sleep(1);
+          return n;
+        }, small)
+        .Build();
+
+    // the producer blocks on the full queues until the failure cancels everything.
+    std::atomic_bool producerFailed = false;
+    std::thread producer([&pipeline, &producerFailed]() {
+      try {
+        for (int i = 0; i < 1000; i++) { pipeline->Push(i); }
+        pipeline->Close();
+      } catch (const execution_exception& ex) {
+        producerFailed = true;
+      }
+    });
+
+    int result;
+    int taken = 0;
+    try {
+      while (pipeline->Next(result)) { taken++; }
+      FAIL() << "Expected the failure to reach the consumer";
+    } catch (const execution_exception& ex) {
+      ASSERT_EQ("Stage check: Bad record", std::string(ex.what()));
+    }
+    producer.join();
+
+    ASSERT_TRUE(producerFailed);
+    ASSERT_LE(taken, 50);
+  }
+
+  TEST(PipelineTestSuite, PipelineTest_Cancel) {
+    ThreadFactory factory("pipeline");
+    auto pipeline = PipelineBuilder<int>(factory)
+        .Stage<int>("identity", [](int n) { return n; })
+        .Build();
+
+    std::thread canceller([&pipeline]() {
+      this_thread::sleep(20);
+      pipeline->Cancel();
+    });
+    int result;
+    ASSERT_THROW(pipeline->Next(result), execution_exception);
+    canceller.join();
+  }
+} // pipelinetest
+} // concurrent
+} // mdl
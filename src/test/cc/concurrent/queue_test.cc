@@ -26,6 +26,7 @@
 // OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <atomic>
 #include <gtest/gtest.h>
 #include <iostream>
 
@@ -253,6 +254,170 @@ namespace queuetest {
     ASSERT_EQ(30, queue.Poll()->id);
     ASSERT_EQ(0, queue.Size());
   }
+
+  TEST(QueueTestSuite, TestBlockingQueue_TryPoll) {
+    BlockingQueue<int> queue;
+    int val = 0;
+
+    ASSERT_FALSE(queue.TryPoll(val));
+    ASSERT_FALSE(queue.TryPoll(val, 50));
+    ASSERT_EQ(0, val);
+    ASSERT_EQ(0, queue.Size());
+
+    queue.Add(10);
+    ASSERT_TRUE(queue.TryPoll(val, 50));
+    ASSERT_EQ(10, val);
+    ASSERT_EQ(0, queue.Size());
+
+    std::thread t1([&queue]() {
+      std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(50));
+      queue.Add(20);
+    });
+    ASSERT_TRUE(queue.TryPoll(val, 1000));
+    ASSERT_EQ(20, val);
+    t1.join();
+  }
+
+  TEST(QueueTestSuite, TestBlockingQueue_Spinning) {
+    BlockingQueue<int> queue(WaitPolicy::LowLatency());
+    const int count = 10000;
+
+    std::thread producer([&queue]() {
+      for (int i = 0; i < count; i++) {
+        queue.Add(i);
+      }
+    });
+
+    long sum = 0;
+    for (int i = 0; i < count; i++) {
+      sum += queue.Poll();
+    }
+    producer.join();
+
+    ASSERT_EQ((long) count * (count - 1) / 2, sum);
+    ASSERT_EQ(0, queue.Size());
+  }
+
+  TEST(QueueTestSuite, TestBlockingQueue_Bounded) {
+    BlockingQueue<int> queue(2);
+    ASSERT_EQ(2, queue.Capacity());
+
+    queue.Add(1);
+    ASSERT_TRUE(queue.TryAdd(2));
+    ASSERT_FALSE(queue.TryAdd(3));
+    ASSERT_FALSE(queue.TryAdd(3, 20));
+    ASSERT_EQ(2, queue.Size());
+
+    std::atomic_bool added = false;
+    std::thread producer([&queue, &added]() {
+      queue.Add(3);
+      added = true;
+    });
+    std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(30));
+    ASSERT_FALSE(added);
+
+    ASSERT_EQ(1, queue.Poll());
+    producer.join();
+    ASSERT_TRUE(added);
+    ASSERT_EQ(2, queue.Poll());
+    ASSERT_EQ(3, queue.Poll());
+
+    CancellationSource source;
+    queue.Add(4);
+    queue.Add(5);
+    std::thread canceller([&source]() {
+      std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(20));
+      source.Cancel();
+    });
+    ASSERT_THROW(queue.Add(6, source.Token()), interrupted_exception);
+    canceller.join();
+    ASSERT_EQ(2, queue.Size());
+  }
+
+  TEST(QueueTestSuite, TestBlockingQueue_ForceAdd) {
+    BlockingQueue<int> queue(1);
+    queue.Add(1);
+    queue.ForceAdd(2);
+    queue.ForceAdd(3);
+    ASSERT_EQ(3, queue.Size());
+    ASSERT_FALSE(queue.TryAdd(4));
+
+    // polling what went over capacity doesn't make room.
+    ASSERT_EQ(1, queue.Poll());
+    ASSERT_EQ(2, queue.Poll());
+    ASSERT_FALSE(queue.TryAdd(4));
+    ASSERT_EQ(3, queue.Poll());
+    ASSERT_TRUE(queue.TryAdd(4));
+    ASSERT_FALSE(queue.TryAdd(5));
+  }
+
+  TEST(QueueTestSuite, TestBlockingQueue_Notifier) {
+    BlockingQueue<int> queue;
+    queue.Add(1);
+    // created late, but signalled for what's there already.
+    EventNotifier& notifier = queue.Notifier();
+    ASSERT_EQ(&notifier, &queue.Notifier());
+    EventNotifier* notifiers[] = { &notifier };
+    ASSERT_EQ(0, EventNotifier::WaitAny(notifiers, 1, 0));
+
+    notifier.Reset();
+    ASSERT_EQ(-1, EventNotifier::WaitAny(notifiers, 1, 0));
+    // not empty before, so no signal.
+    queue.Add(2);
+    ASSERT_EQ(-1, EventNotifier::WaitAny(notifiers, 1, 0));
+
+    ASSERT_EQ(1, queue.Poll());
+    ASSERT_EQ(2, queue.Poll());
+    queue.Add(3);
+    ASSERT_EQ(0, EventNotifier::WaitAny(notifiers, 1, 0));
+  }
+
+  TEST(QueueTestSuite, TestBlockingQueue_WaitAny) {
+    BlockingQueue<int> numbers;
+    BlockingQueue<std::string> strings;
+
+    ASSERT_EQ(-1, WaitAny(0, numbers, strings));
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(-1, WaitAny(20, numbers, strings));
+    ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+
+    std::thread producer([&strings, &numbers]() {
+      std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(20));
+      strings.Add("hello");
+      std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(20));
+      numbers.Add(7);
+    });
+
+    ASSERT_EQ(1, WaitAny(-1, numbers, strings));
+    std::string string;
+    ASSERT_TRUE(strings.TryPoll(string));
+    ASSERT_EQ("hello", string);
+    ASSERT_EQ(0, WaitAny(-1, numbers, strings));
+    ASSERT_EQ(7, numbers.Poll());
+    producer.join();
+  }
+
+#ifdef __linux__
+  TEST(QueueTestSuite, TestBlockingQueue_Reactor) {
+    Reactor reactor;
+    BlockingQueue<int> queue;
+    std::atomic_int sum = 0;
+    CountDownLatch latch(100);
+
+    reactor.Add(queue.Notifier().Fd(), kReadable, [&](int) {
+      queue.Notifier().Reset();
+      int item;
+      while (queue.TryPoll(item)) {
+        sum += item;
+        latch.CountDown();
+      }
+    });
+    for (int i = 0; i < 100; i++) { queue.Add(i); }
+    latch.Await();
+    ASSERT_EQ(4950, sum);
+    reactor.Remove(queue.Notifier().Fd());
+  }
+#endif
 } // queuetest
 } // concurrent
 } // mdl
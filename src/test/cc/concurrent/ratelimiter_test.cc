@@ -0,0 +1,113 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include <mdl/concurrent.h>
+#include <mdl/util.h>
+
+namespace mdl {
+namespace concurrent {
+namespace ratelimitertest {
+  long MillisSince(const util::instant& start) {
+    return util::EllapsedTime(start, util::Now()) / 1000L;
+  }
+
+  TEST(RateLimiterTestSuite, TestRateLimiter_Burst) {
+    RateLimiter limiter(10, 5);
+    ASSERT_EQ(5, limiter.Burst());
+    ASSERT_DOUBLE_EQ(10, limiter.Rate());
+
+    util::instant start = util::Now();
+    for (int i = 0; i < 5; i++) {
+      ASSERT_TRUE(limiter.TryAcquire());
+    }
+    ASSERT_LT(MillisSince(start), 50);
+
+    // the next permit is 100ms away.
+    ASSERT_FALSE(limiter.TryAcquire());
+    ASSERT_FALSE(limiter.TryAcquire(1, 50));
+    ASSERT_TRUE(limiter.TryAcquire(1, 200));
+    ASSERT_GE(MillisSince(start), 90);
+  }
+
+  TEST(RateLimiterTestSuite, TestRateLimiter_SteadyRate) {
+    RateLimiter limiter(200);
+    util::instant start = util::Now();
+    for (int i = 0; i < 21; i++) {
+      limiter.Acquire();
+    }
+    // the first one is free, the other 20 are 5ms apart. Oversleeping in one Acquire shortens
+    //  the next wait, so only the total is predictable.
+    ASSERT_GE(MillisSince(start), 95);
+  }
+
+  TEST(RateLimiterTestSuite, TestRateLimiter_RefillsWhileIdle) {
+    RateLimiter limiter(100, 3);
+    ASSERT_TRUE(limiter.TryAcquire(3));
+    ASSERT_FALSE(limiter.TryAcquire());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    // refills up to burst, no more.
+    ASSERT_TRUE(limiter.TryAcquire(3));
+    ASSERT_FALSE(limiter.TryAcquire());
+  }
+
+  TEST(RateLimiterTestSuite, TestRateLimiter_Concurrent) {
+    RateLimiter limiter(1000, 10);
+    std::atomic_long acquired = 0;
+    util::instant start = util::Now();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+      threads.emplace_back([&limiter, &acquired]() {
+        for (int i = 0; i < 25; i++) {
+          limiter.Acquire();
+          acquired++;
+        }
+      });
+    }
+    for (auto& t : threads) { t.join(); }
+
+    // 200 permits, 10 of them right away, the rest 1ms apart.
+    ASSERT_EQ(200, acquired);
+    ASSERT_GE(MillisSince(start), 185);
+  }
+
+  TEST(RateLimiterTestSuite, TestRateLimiter_InvalidArguments) {
+    ASSERT_THROW(RateLimiter(0), std::invalid_argument);
+    ASSERT_THROW(RateLimiter(10, 0), std::invalid_argument);
+    RateLimiter limiter(10);
+    ASSERT_THROW(limiter.Acquire(-1), std::invalid_argument);
+  }
+} // ratelimitertest
+} // concurrent
+} // mdl
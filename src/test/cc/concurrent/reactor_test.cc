@@ -0,0 +1,218 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <mdl/concurrent.h>
+
+#ifdef __linux__
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace mdl {
+namespace concurrent {
+namespace reactortest {
+  struct Pipe {
+    int fds[2];
+
+    Pipe() { EXPECT_EQ(0, pipe(fds)); }
+    ~Pipe() { 
+      for (int fd : fds) { 
+        if (fd >= 0) { close(fd); } 
+      }
+    }
+    int Read() const { return fds[0]; }
+    int Write() const { return fds[1]; }
+    void CloseWrite() { 
+      close(fds[1]); 
+      fds[1] = -1;
+    }
+  };
+
+  TEST(ReactorTestSuite, ReactorTest_AddRemove) {
+    Reactor reactor;
+    Pipe pipe;
+    std::atomic_int received = 0;
+    CountDownLatch latch(1);
+
+    reactor.Add(pipe.Read(), kReadable, [&](int events) {
+      ASSERT_TRUE(events & kReadable);
+      ASSERT_TRUE(reactor.InLoop());
+      char c;
+      ASSERT_EQ(1, read(pipe.Read(), &c, 1));
+      received += c;
+      latch.CountDown();
+    });
+    ASSERT_THROW(reactor.Add(pipe.Read(), kReadable, [](int) {}), std::runtime_error);
+
+    ASSERT_EQ(1, write(pipe.Write(), "\x05", 1));
+    latch.Await();
+    ASSERT_TRUE(reactor.Remove(pipe.Read()));
+    ASSERT_FALSE(reactor.Remove(pipe.Read()));
+
+    ASSERT_EQ(1, write(pipe.Write(), "\x05", 1));
+    this_thread::sleep(20);
+    ASSERT_EQ(5, received);
+  }
+
+  TEST(ReactorTestSuite, ReactorTest_Post) {
+    Reactor reactor("my-reactor");
+    Promise<std::string> promise;
+    Future<std::string> future = promise.GetFuture();
+
+    ASSERT_FALSE(reactor.InLoop());
+    reactor.Post([&reactor, promise]() mutable {
+      // posted from the loop too, runs after this one.
+      reactor.Post([promise]() mutable { promise.Set(this_thread::get_name()); });
+    });
+    ASSERT_EQ("my-reactor", future.Get());
+  }
+
+  TEST(ReactorTestSuite, ReactorTest_FailedCallbacks) {
+    Reactor reactor;
+    reactor.Post([]() { throw std::runtime_error("failed"); });
+    reactor.Schedule(0, []() { throw std::runtime_error("failed"); });
+    // the loop carried on.
+    reactor.After(20).Get();
+    ASSERT_EQ(2, reactor.NumFailedCallbacks());
+  }
+
+  TEST(ReactorTestSuite, ReactorTest_Timers) {
+    Reactor reactor;
+    std::atomic_int ticks = 0;
+    std::atomic_bool cancelledRan = false;
+    CountDownLatch latch(3);
+
+    long periodic = reactor.Schedule(5, [&]() { 
+      ticks++; 
+      latch.CountDown();
+    }, 5);
+    long cancelled = reactor.Schedule(30, [&]() { cancelledRan = true; });
+    util::instant start = util::Now();
+    reactor.After(15).Get();
+    ASSERT_GE(util::EllapsedTime(start, util::Now()) / 1000L, 14);
+
+    latch.Await();
+    ASSERT_TRUE(reactor.Cancel(periodic));
+    ASSERT_TRUE(reactor.Cancel(cancelled));
+    ASSERT_FALSE(reactor.Cancel(cancelled));
+    int seen = ticks;
+    this_thread::sleep(50);
+    ASSERT_LE(ticks, seen + 1);
+    ASSERT_FALSE(cancelledRan);
+  }
+
+  TEST(ReactorTestSuite, ReactorTest_WhenReady) {
+    Reactor reactor;
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+    Future<int> writable = reactor.WhenReady(fds[0], kWritable);
+    ASSERT_TRUE(writable.Get() & kWritable);
+
+    Future<int> readable = reactor.WhenReady(fds[0], kReadable);
+    this_thread::sleep(10);
+    ASSERT_FALSE(readable.IsDone());
+    ASSERT_EQ(3, write(fds[1], "abc", 3));
+    ASSERT_TRUE(readable.Get() & kReadable);
+
+    char buffer[8];
+    ASSERT_EQ(3, read(fds[0], buffer, sizeof(buffer)));
+    Future<int> hungUp = reactor.WhenReady(fds[0], kReadable);
+    close(fds[1]);
+    ASSERT_TRUE(hungUp.Get() & kHangup);
+    close(fds[0]);
+  }
+
+  TEST(ReactorTestSuite, ReactorTest_WhenReady_Cancel) {
+    Reactor reactor;
+    Pipe pipe;
+
+    Future<int> never = reactor.WhenReady(pipe.Read(), kReadable);
+    never.Cancel();
+    ASSERT_TRUE(never.IsCanceled());
+    // no longer registered.
+    ASSERT_FALSE(reactor.Remove(pipe.Read()));
+    ASSERT_EQ(1, write(pipe.Write(), "x", 1));
+    ASSERT_TRUE(reactor.WhenReady(pipe.Read(), kReadable).Get() & kReadable);
+  }
+
+  TEST(ReactorTestSuite, ReactorTest_WhenReady_Executor) {
+    ThreadFactory factory("my-thread");
+    ExecutorService executor(1, factory);
+    Reactor reactor;
+    Pipe pipe;
+
+    Future<std::string> line = reactor.WhenReady<std::string>(
+        pipe.Read(), kReadable, executor, [&pipe](int) {
+          char buffer[16];
+          long count = read(pipe.Read(), buffer, sizeof(buffer));
+          return this_thread::get_name() + ":" + std::string(buffer, count);
+        });
+    Future<int> failed = reactor.WhenReady<int>(
+        pipe.Write(), kWritable, executor, [](int) -> int { 
+          throw std::runtime_error("failed"); 
+        });
+
+    ASSERT_EQ(5, write(pipe.Write(), "hello", 5));
+    ASSERT_EQ("my-thread-1:hello", line.Get());
+    ASSERT_THROW(failed.Get(), execution_exception);
+  }
+
+  TEST(ReactorTestSuite, ReactorTest_WhenReady_Rejected) {
+    ThreadFactory factory("my-thread");
+    ExecutorOptions options;
+    options.queueCapacity = 1;
+    ExecutorService executor(options, factory);
+    CountDownLatch latch(1);
+    Reactor reactor;
+    Pipe pipe;
+
+    executor.Execute([&latch]() { latch.Await(); });
+    this_thread::sleep(20);
+    executor.Execute([]() {});
+    Future<int> rejected = reactor.WhenReady<int>(
+        pipe.Write(), kWritable, executor, [](int ready) { return ready; });
+
+    try {
+      rejected.Get();
+      FAIL();
+    } catch (const execution_exception& ex) {
+      ASSERT_EQ(std::string("Executor queue is full"), ex.what());
+    }
+    latch.CountDown();
+  }
+
+} // reactortest
+} // concurrent
+} // mdl
+
+#endif // __linux__
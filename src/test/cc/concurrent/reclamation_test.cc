@@ -0,0 +1,228 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mdl/concurrent.h>
+
+namespace mdl {
+namespace concurrent {
+namespace reclamationtest {
+  // Counts live instances, and flags any use after being freed.
+  struct Tracked {
+    static std::atomic_int live;
+    long value;
+    bool alive = true;
+
+    Tracked(long value) : value(value) { live++; }
+    Tracked(const Tracked& other) : value(other.value) { live++; }
+    ~Tracked() { 
+      alive = false;
+      live--; 
+    }
+  };
+
+  std::atomic_int Tracked::live = 0;
+
+  TEST(ReclamationTestSuite, TestEpochDomain_DefersUntilReadersLeave) {
+    EpochDomain domain(1);
+    std::atomic<Tracked*> shared = new Tracked(1);
+    
+    Tracked* old;
+    std::atomic_bool entered = false;
+    std::atomic_bool release = false;
+    std::thread reader([&]() {
+      EpochDomain::Guard guard(domain);
+      Tracked* seen = shared.load();
+      entered = true;
+      while (!release) { std::this_thread::yield(); }
+      ASSERT_TRUE(seen->alive);
+      ASSERT_EQ(1, seen->value);
+    });
+    while (!entered) { std::this_thread::yield(); }
+
+    old = shared.exchange(new Tracked(2));
+    domain.Retire(old);
+    for (int i = 0; i < 10; i++) { domain.Retire(new Tracked(0)); }
+    // the reader is still in, nothing can be freed.
+    ASSERT_EQ(12, Tracked::live);
+
+    release = true;
+    reader.join();
+    domain.Synchronize();
+    ASSERT_EQ(1, Tracked::live);
+    delete shared.load();
+  }
+
+  TEST(ReclamationTestSuite, TestEpochDomain_GuardsNest) {
+    EpochDomain domain;
+    long epoch = domain.Epoch();
+    {
+      EpochDomain::Guard outer(domain);
+      EpochDomain::Guard inner(domain);
+      ASSERT_THROW(domain.Synchronize(), std::logic_error);
+    }
+    domain.Synchronize();
+    ASSERT_GE(domain.Epoch(), epoch + 2);
+  }
+
+  TEST(ReclamationTestSuite, TestEpochDomain_ThreadExitHandsOverRetired) {
+    {
+      EpochDomain domain(1000);
+      std::thread retirer([&domain]() {
+        for (int i = 0; i < 10; i++) { domain.Retire(new Tracked(i)); }
+      });
+      retirer.join();
+      ASSERT_EQ(10, Tracked::live);
+
+      domain.Synchronize();
+      ASSERT_EQ(0, Tracked::live);
+      domain.Retire(new Tracked(0));
+    }
+    // freed with the domain.
+    ASSERT_EQ(0, Tracked::live);
+  }
+
+  TEST(ReclamationTestSuite, TestEpochDomain_ThreadOutlivesDomains) {
+    // domains come and go, likely at the same address, while the thread using them stays.
+    for (int i = 0; i < 100; i++) {
+      std::unique_ptr<EpochDomain> domain = std::make_unique<EpochDomain>(1000);
+      {
+        EpochDomain::Guard guard(*domain);
+        domain->Retire(new Tracked(i));
+      }
+      domain->Synchronize();
+      ASSERT_EQ(0, Tracked::live);
+    }
+
+    // guards find this domain's record, not one cached for a domain that's gone.
+    EpochDomain domain;
+    EpochDomain::Guard guard(domain);
+    EpochDomain::Guard nested(domain);
+    ASSERT_THROW(domain.Synchronize(), std::logic_error);
+  }
+
+  TEST(ReclamationTestSuite, TestHazardPointerDomain_Protects) {
+    HazardPointerDomain domain(1);
+    std::atomic<Tracked*> shared = new Tracked(1);
+
+    {
+      HazardPointerDomain::Hazard hazard(domain);
+      Tracked* seen = hazard.Protect(shared);
+      domain.Retire(shared.exchange(new Tracked(2)));
+      domain.Collect();
+      ASSERT_TRUE(seen->alive);
+      ASSERT_EQ(2, Tracked::live);
+
+      hazard.Reset();
+      domain.Collect();
+      ASSERT_EQ(1, Tracked::live);
+    }
+
+    std::vector<std::unique_ptr<HazardPointerDomain::Hazard>> hazards;
+    for (int i = 0; i < HazardPointerDomain::kSlots; i++) {
+      hazards.push_back(std::make_unique<HazardPointerDomain::Hazard>(domain));
+    }
+    ASSERT_THROW(HazardPointerDomain::Hazard extra(domain), std::runtime_error);
+    delete shared.load();
+  }
+
+  TEST(ReclamationTestSuite, TestHazardPointerDomain_Concurrent) {
+    HazardPointerDomain domain(8);
+    std::atomic<Tracked*> shared = new Tracked(0);
+    std::atomic_bool done = false;
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+      readers.emplace_back([&]() {
+        HazardPointerDomain::Hazard hazard(domain);
+        while (!done) {
+          Tracked* seen = hazard.Protect(shared);
+          ASSERT_TRUE(seen->alive);
+        }
+      });
+    }
+
+    for (int i = 1; i <= 10000; i++) {
+      domain.Retire(shared.exchange(new Tracked(i)));
+    }
+    done = true;
+    for (auto& reader : readers) { reader.join(); }
+    domain.Collect();
+
+    ASSERT_EQ(1, Tracked::live);
+    delete shared.load();
+  }
+
+  TEST(ReclamationTestSuite, TestAtomicSharedSnapshot) {
+    AtomicSharedSnapshot<std::map<std::string, int>> config({ { "threads", 4 } });
+    {
+      auto snapshot = config.Read();
+      config.Store({ { "threads", 8 } });
+      // the old value stays around while in use.
+      ASSERT_EQ(4, snapshot->at("threads"));
+    }
+    ASSERT_EQ(8, config.Read()->at("threads"));
+
+    const int numThreads = 8;
+    const int perThread = 200;
+    std::atomic_bool done = false;
+    std::thread reader([&config, &done]() {
+      while (!done) {
+        auto snapshot = config.Read();
+        // always a consistent value.
+        ASSERT_EQ(snapshot->at("threads"), snapshot->at("copy"));
+      }
+    });
+
+    config.Update([](std::map<std::string, int>& value) { value["copy"] = value["threads"]; });
+    std::vector<std::thread> writers;
+    for (int t = 0; t < numThreads; t++) {
+      writers.emplace_back([&config]() {
+        for (int i = 0; i < perThread; i++) {
+          config.Update([](std::map<std::string, int>& value) { 
+            value["threads"]++;
+            value["copy"]++;
+          });
+        }
+      });
+    }
+    for (auto& writer : writers) { writer.join(); }
+    done = true;
+    reader.join();
+
+    ASSERT_EQ(8 + numThreads * perThread, config.Load().at("threads"));
+  }
+} // reclamationtest
+} // concurrent
+} // mdl
@@ -158,6 +158,40 @@ namespace semaphoretest {
     ASSERT_EQ(0, s.NumTickets());
   }
 
+  TEST(SemaphoreTestSuite, TestSemaphore_TryDown) {
+    Semaphore s(1);
+
+    ASSERT_TRUE(s.TryDown(0));
+    ASSERT_FALSE(s.TryDown(0));
+    ASSERT_FALSE(s.TryDown(50));
+    // gave up, so no longer waiting.
+    ASSERT_EQ(0, s.NumTickets());
+
+    std::thread t1([&s]() {
+      std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(50));
+      s.Up();
+    });
+    ASSERT_TRUE(s.TryDown(1000));
+    ASSERT_EQ(0, s.NumTickets());
+    t1.join();
+  }
+
+  TEST(SemaphoreTestSuite, TestSemaphore_TryDown_MixedWithDown) {
+    Semaphore s(0);
+    std::unordered_set<int> set;
+
+    std::thread t1(Consume, std::ref(s), 1, std::ref(set));
+    std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(50));
+    ASSERT_FALSE(s.TryDown(50));
+    ASSERT_EQ(-1, s.NumTickets());
+
+    // the ticket goes to the thread still waiting.
+    s.Up();
+    t1.join();
+    ASSERT_EQ(1, set.size());
+    ASSERT_EQ(0, s.NumTickets());
+  }
+
 } // semaphoretest
 } // concurrent
 } // mdl
@@ -0,0 +1,173 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <mdl/concurrent.h>
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace mdl {
+namespace concurrent {
+namespace serialexecutortest {
+  TEST(SerialExecutorTestSuite, SerialExecutorTest_RunsInOrder) {
+    ThreadFactory factory("my-thread");
+    ExecutorService executor(4, factory);
+    const int kStrands = 50;
+    const int kTasks = 200;
+
+    std::vector<std::unique_ptr<SerialExecutor>> strands;
+    std::vector<std::vector<int>> seen(kStrands);
+    std::vector<std::atomic_int> running(kStrands);
+    std::atomic_bool overlapped = false;
+    CountDownLatch done(kStrands * kTasks);
+
+    for (int s = 0; s < kStrands; s++) {
+      strands.push_back(std::make_unique<SerialExecutor>(executor, 8));
+    }
+
+    // producers from several threads, each strand fed by one of them.
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 5; p++) {
+      producers.emplace_back([&, p]() {
+        for (int i = 0; i < kTasks; i++) {
+          for (int s = p; s < kStrands; s += 5) {
+            strands[s]->Execute([&, s, i]() {
+              if (running[s]++ > 0) { overlapped = true; }
+              // plain vector: only safe if the strand never runs two tasks at once.
+              seen[s].push_back(i);
+              running[s]--;
+              done.CountDown();
+            });
+          }
+        }
+      });
+    }
+    for (auto& t : producers) { t.join(); }
+
+    ASSERT_TRUE(done.Await(10000));
+    ASSERT_FALSE(overlapped);
+    for (int s = 0; s < kStrands; s++) {
+      ASSERT_EQ(kTasks, seen[s].size());
+      for (int i = 0; i < kTasks; i++) {
+        ASSERT_EQ(i, seen[s][i]);
+      }
+    }
+
+    // the last task counts down just before its strand does.
+    for (int s = 0; s < kStrands; s++) {
+      for (int i = 0; i < 1000 && strands[s]->Pending() > 0; i++) { this_thread::sleep(1); }
+      ASSERT_EQ(0, strands[s]->Pending());
+    }
+    executor.Shutdown();
+  }
+
+  TEST(SerialExecutorTestSuite, SerialExecutorTest_Submit) {
+    ThreadFactory factory("my-thread");
+    ExecutorService executor(2, factory);
+    SerialExecutor strand(executor);
+    int state = 0;
+
+    Future<int> first = strand.Submit<int>([&state]() {
+      this_thread::sleep(20);
+      return ++state;
+    });
+    Future<int> failing = strand.Submit<int>([]() -> int { throw 7; });
+    Future<int> second = strand.Submit<int>([&state]() { return ++state; });
+
+    ASSERT_EQ(2, second.Get());
+    ASSERT_EQ(1, first.Get());
+    ASSERT_THROW(failing.Get(), execution_exception);
+
+    CancellationSource stop;
+    Future<void> cancelled = strand.Submit<void>([](const CancellationToken& token) {
+      while (!token.IsCancellationRequested()) { this_thread::sleep(1); }
+      token.ThrowIfCancellationRequested();
+    });
+    this_thread::sleep(10);
+    ASSERT_TRUE(cancelled.Cancel());
+    ASSERT_EQ(3, strand.Submit<int>([&state]() { return ++state; }).Get());
+    executor.Shutdown();
+  }
+
+  TEST(SerialExecutorTestSuite, SerialExecutorTest_OutlivedByItsTasks) {
+    ThreadFactory factory("my-thread");
+    ExecutorService executor(1, factory);
+    CountDownLatch done(10);
+
+    {
+      SerialExecutor strand(executor);
+      for (int i = 0; i < 10; i++) {
+        strand.Execute([&done]() {
+          this_thread::sleep(2);
+          done.CountDown();
+        });
+      }
+    }
+
+    ASSERT_TRUE(done.Await(5000));
+    executor.Shutdown();
+  }
+
+  TEST(SerialExecutorTestSuite, SerialExecutorTest_BoundedExecutor) {
+    ThreadFactory factory("my-thread");
+    ExecutorOptions options;
+    options.coreThreads = 1;
+    options.maxThreads = 1;
+    options.queueCapacity = 1;
+    options.rejectionPolicy = RejectionPolicy::kAbort;
+    ExecutorService executor(options, factory);
+    SerialExecutor strand(executor, 1);
+
+    // worker busy, and its queue full.
+    CountDownLatch release(1);
+    executor.Execute([&release]() { release.Await(); });
+    this_thread::sleep(10);
+    executor.Execute([]() {});
+    ASSERT_THROW(executor.Execute([]() {}), rejected_exception);
+
+    // the strand still takes tasks, and runs them all once there's room.
+    std::vector<int> seen;
+    CountDownLatch done(10);
+    for (int i = 0; i < 10; i++) {
+      strand.Execute([&seen, &done, i]() { 
+        seen.push_back(i);
+        done.CountDown();
+      });
+    }
+    release.CountDown();
+    ASSERT_TRUE(done.Await(5000));
+    for (int i = 0; i < 10; i++) { ASSERT_EQ(i, seen[i]); }
+    ASSERT_EQ(1, executor.NumRejected());
+    executor.Shutdown();
+  }
+} // serialexecutortest
+} // concurrent
+} // mdl
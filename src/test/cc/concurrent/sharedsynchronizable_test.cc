@@ -0,0 +1,229 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <exception>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <mdl/concurrent.h>
+#include <mdl/util.h>
+
+using std::cout;
+using std::endl;
+
+namespace mdl {
+namespace concurrent {
+namespace sharedsynchronizabletest {
+
+  TEST(SharedSynchronizableTestSuite, TestSynchronized_SingleThread) {
+    SharedSynchronizable sync;
+    ASSERT_EQ(10, sync.SynchronizedRead<int>([]() { return 10; }));
+    ASSERT_EQ(20, sync.SynchronizedWrite<int>([]() { return 20; }));
+  }
+
+  TEST(SharedSynchronizableTestSuite, TestSynchronized_Reentrant) {
+    SharedSynchronizable sync;
+    int result = sync.SynchronizedRead<int>([&sync]() {
+      return sync.SynchronizedRead<int>([]() { return 20; });
+    });
+    ASSERT_EQ(20, result);
+
+    result = sync.SynchronizedWrite<int>([&sync]() {
+      return sync.SynchronizedRead<int>([&sync]() {
+        return sync.SynchronizedWrite<int>([]() { return 30; });
+      });
+    });
+    ASSERT_EQ(30, result);
+  }
+
+  TEST(SharedSynchronizableTestSuite, TestSynchronized_NoUpgrade) {
+    SharedSynchronizable sync;
+    ASSERT_THROW(sync.SynchronizedRead<void>([&sync]() {
+      sync.SynchronizedWrite<void>([]() {});
+    }), std::runtime_error);
+
+    // lock was released on the way out
+    ASSERT_EQ(10, sync.SynchronizedWrite<int>([]() { return 10; }));
+  }
+
+  TEST(SharedSynchronizableTestSuite, TestSynchronized_ConcurrentReaders) {
+    SharedSynchronizable sync(4);
+    std::atomic_int inside = 0;
+    std::atomic_int maxInside = 0;
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < 4; i++) {
+      threads.emplace_back([&sync, &inside, &maxInside]() {
+        sync.SynchronizedRead<void>([&inside, &maxInside]() {
+          int now = ++inside;
+          int max = maxInside.load();
+          while (now > max && !maxInside.compare_exchange_weak(max, now)) {}
+          std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(100));
+          inside--;
+        });
+      });
+    }
+    for (auto& t : threads) { t.join(); }
+
+    ASSERT_EQ(4, maxInside.load());
+  }
+
+  TEST(SharedSynchronizableTestSuite, TestSynchronized_WritersExclusive) {
+    SharedSynchronizable sync;
+    long counter = 0;
+    std::atomic_int backwards = 0;
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < 4; i++) {
+      threads.emplace_back([&sync, &counter]() {
+        for (int j = 0; j < 10000; j++) {
+          sync.SynchronizedWrite<void>([&counter]() { counter++; });
+        }
+      });
+      threads.emplace_back([&sync, &counter, &backwards]() {
+        long last = 0;
+        for (int j = 0; j < 10000; j++) {
+          long val = sync.SynchronizedRead<long>([&counter]() { return counter; });
+          if (val < last) { backwards++; }
+          last = val;
+        }
+      });
+    }
+    for (auto& t : threads) { t.join(); }
+
+    ASSERT_EQ(40000, counter);
+    ASSERT_EQ(0, backwards.load());
+  }
+
+  TEST(SharedSynchronizableTestSuite, TestSynchronized_WriterPreferred) {
+    SharedSynchronizable sync;
+    std::vector<int> order;
+
+    std::thread reader1([&sync, &order]() {
+      sync.SynchronizedRead<void>([&order]() {
+        std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(200));
+        order.push_back(1);
+      });
+    });
+    std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(50));
+
+    std::thread writer([&sync, &order]() {
+      sync.SynchronizedWrite<void>([&order]() {
+        order.push_back(2);
+      });
+    });
+    std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(50));
+
+    // the writer is waiting, so this reader may not jump ahead of it.
+    std::thread reader2([&sync, &order]() {
+      sync.SynchronizedRead<void>([&order]() {
+        order.push_back(3);
+      });
+    });
+
+    reader1.join();
+    writer.join();
+    reader2.join();
+
+    ASSERT_EQ(std::vector<int>({1, 2, 3}), order);
+  }
+
+  TEST(SharedSynchronizableTestSuite, TestSynchronized_HintMovesWhileReading) {
+    SharedSynchronizable sync(64);
+
+    sync.SynchronizedRead<void>([]() {
+      // as a striped structure would on contention. The read lock must still come off the slot
+      //  it went on.
+      int before = util::ThreadHint() & 63;
+      while ((util::ThreadHint() & 63) == before) {
+        util::NextThreadHint();
+      }
+    });
+
+    ASSERT_EQ(10, sync.SynchronizedWrite<int>([]() { return 10; }));
+  }
+
+  TEST(SharedSynchronizableTestSuite, TestWaitNotify) {
+    SharedSynchronizable sync;
+    int x = 0;
+    bool done = false;
+
+    ASSERT_THROW(sync.Wait(), std::runtime_error);
+    ASSERT_THROW(sync.SynchronizedRead<void>([&sync]() { sync.Notify(); }), std::runtime_error);
+
+    std::thread t1([&sync, &x, &done]() {
+      sync.SynchronizedWrite<void>([&sync, &x, &done]() {
+        while (x != 10) {
+          sync.Wait();
+        }
+        done = true;
+      });
+    });
+
+    std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(50));
+    // the waiter let go of the lock.
+    ASSERT_FALSE(sync.SynchronizedRead<bool>([&done]() { return done; }));
+
+    sync.SynchronizedWrite<void>([&sync, &x]() {
+      x = 10;
+      sync.Notify();
+    });
+    t1.join();
+    ASSERT_TRUE(done);
+
+    bool notified = sync.SynchronizedWrite<bool>([&sync]() { return sync.Wait(50); });
+    ASSERT_FALSE(notified);
+  }
+
+  TEST(SharedSynchronizableTestSuite, TestInterrupt) {
+    SharedSynchronizable sync;
+    bool done = false;
+
+    std::thread t1([&sync, &done]() {
+      sync.SynchronizedWrite<void>([&sync, &done]() {
+        try {
+          sync.Wait();
+          FAIL();
+        } catch (interrupted_exception& ex) {
+          done = true;
+        }
+      });
+    });
+
+    std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(100));
+    sync.SynchronizedWrite<void>([&sync]() { sync.Interrupt(); });
+    t1.join();
+    ASSERT_TRUE(done);
+  }
+
+} // sharedsynchronizabletest
+} // concurrent
+} // mdl
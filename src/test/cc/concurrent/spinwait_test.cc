@@ -0,0 +1,99 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <mdl/concurrent.h>
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace mdl {
+namespace concurrent {
+namespace spinwaittest {
+
+  TEST(SpinWaitTestSuite, TestSpinWait_ParkPolicy) {
+    SpinWait spinWait(WaitPolicy::Park());
+    int calls = 0;
+
+    // no budget, only checks once.
+    ASSERT_FALSE(spinWait.Await([&calls]() { calls++; return false; }));
+    ASSERT_EQ(1, calls);
+    ASSERT_TRUE(spinWait.Await([]() { return true; }));
+  }
+
+  TEST(SpinWaitTestSuite, TestSpinWait_Succeeds) {
+    WaitPolicy policy;
+    policy.maxSpins = 1000;
+    policy.adaptive = false;
+    SpinWait spinWait(policy);
+    int calls = 0;
+
+    ASSERT_TRUE(spinWait.Await([&calls]() { return ++calls == 10; }));
+    ASSERT_EQ(10, calls);
+    ASSERT_EQ(1000, spinWait.SpinBudget());
+  }
+
+  TEST(SpinWaitTestSuite, TestSpinWait_AdaptsBudget) {
+    WaitPolicy policy;
+    policy.maxSpins = 1024;
+    policy.maxYields = 1;
+    SpinWait spinWait(policy);
+    ASSERT_EQ(1024, spinWait.SpinBudget());
+
+    // waits that never finish shrink the budget, down to a floor.
+    for (int i = 0; i < 20; i++) {
+      ASSERT_FALSE(spinWait.Await([]() { return false; }));
+    }
+    int shrunk = spinWait.SpinBudget();
+    ASSERT_LT(shrunk, 1024);
+    ASSERT_GT(shrunk, 0);
+
+    // waits that finish while yielding grow it back.
+    for (int i = 0; i < 20; i++) {
+      int calls = 0;
+      int budget = spinWait.SpinBudget();
+      ASSERT_TRUE(spinWait.Await([&calls, budget]() { return calls++ > budget; }));
+    }
+    ASSERT_EQ(1024, spinWait.SpinBudget());
+  }
+
+  TEST(SpinWaitTestSuite, TestSpinWait_SeesOtherThread) {
+    SpinWait spinWait(WaitPolicy::LowLatency());
+    std::atomic_bool flag = false;
+
+    std::thread t1([&flag]() { flag = true; });
+    bool ready = false;
+    while (!ready) {
+      ready = spinWait.Await([&flag]() { return flag.load(); });
+    }
+    t1.join();
+  }
+
+} // spinwaittest
+} // concurrent
+} // mdl
@@ -0,0 +1,108 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include <mdl/concurrent.h>
+
+namespace mdl {
+namespace concurrent {
+namespace stripedcountertest {
+  TEST(StripedCounterTestSuite, TestStripedCounter_Basics) {
+    LongAdder counter(4);
+    ASSERT_EQ(0, counter.Sum());
+    counter.Increment();
+    counter.Add(10);
+    counter.Decrement();
+    ASSERT_EQ(10, counter.Sum());
+
+    ASSERT_EQ(10, counter.SumThenReset());
+    ASSERT_EQ(0, counter.Sum());
+    counter.Add(5);
+    counter.Reset();
+    ASSERT_EQ(0, counter.Sum());
+  }
+
+  TEST(StripedCounterTestSuite, TestStripedCounter_Concurrent) {
+    StripedCounter counter;
+    const int numThreads = 16;
+    const int perThread = 100000;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+      threads.emplace_back([&counter]() {
+        for (int i = 0; i < perThread; i++) { counter.Increment(); }
+      });
+    }
+    for (auto& thread : threads) { thread.join(); }
+
+    ASSERT_EQ((long) numThreads * perThread, counter.Sum());
+  }
+
+  TEST(StripedCounterTestSuite, TestThreadLocalAccumulator_Sum) {
+    ThreadLocalAccumulator<long> sum;
+    const int numThreads = 8;
+    const int perThread = 10000;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+      threads.emplace_back([&sum]() {
+        for (int i = 0; i < perThread; i++) { sum.Accumulate(i); }
+      });
+    }
+    for (auto& thread : threads) { thread.join(); }
+
+    ASSERT_EQ((long) numThreads * perThread * (perThread - 1) / 2, sum.Get());
+    ASSERT_EQ((long) numThreads * perThread * (perThread - 1) / 2, sum.GetThenReset());
+    ASSERT_EQ(0, sum.Get());
+  }
+
+  TEST(StripedCounterTestSuite, TestThreadLocalAccumulator_Max) {
+    auto max = [](int a, int b) { return std::max(a, b); };
+    ThreadLocalAccumulator<int, decltype(max)> accumulator(
+        std::numeric_limits<int>::min(), 2, max);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+      threads.emplace_back([&accumulator, t]() {
+        for (int i = 0; i < 1000; i++) { accumulator.Accumulate(t * 1000 + i); }
+      });
+    }
+    for (auto& thread : threads) { thread.join(); }
+
+    ASSERT_EQ(3999, accumulator.Get());
+    accumulator.Reset();
+    ASSERT_EQ(std::numeric_limits<int>::min(), accumulator.Get());
+  }
+} // stripedcountertest
+} // concurrent
+} // mdl
@@ -210,6 +210,73 @@ namespace syncronizabletest {
     t3.join();
     ASSERT_TRUE(d3);
   }
+
+  TEST(SynchronizableTestSuite, TestTimedWait) {
+    X sync;
+
+    bool notified = sync.Synchronized<bool>([&sync]() {
+      return sync.Wait(50);
+    });
+    ASSERT_FALSE(notified);
+
+    std::thread t1(&X::Set, &sync, 20);
+    notified = sync.Synchronized<bool>([&sync]() {
+      while (sync.x != 20) {
+        if (!sync.Wait(2000)) { return false; }
+      }
+      return true;
+    });
+    ASSERT_TRUE(notified);
+    t1.join();
+  }
+
+  TEST(SynchronizableTestSuite, TestWaitNotify_Spinning) {
+    Synchronizable sync(WaitPolicy::LowLatency());
+    int x = 0;
+
+    std::thread t1([&sync, &x]() {
+      for (int i = 1; i <= 1000; i++) {
+        sync.Synchronized<void>([&sync, &x, i]() {
+          x = i;
+          sync.NotifyAll();
+        });
+      }
+    });
+
+    sync.Synchronized<void>([&sync, &x]() {
+      while (x < 1000) {
+        sync.Wait();
+      }
+    });
+    t1.join();
+    ASSERT_EQ(1000, x);
+  }
+
+  TEST(SynchronizableTestSuite, TestInterrupt_Spinning) {
+    WaitPolicy policy;
+    policy.maxSpins = 1000000000;
+    policy.adaptive = false;
+    Synchronizable sync(policy);
+    bool done = false;
+
+    std::thread t1([&sync, &done]() {
+      sync.Synchronized<void>([&sync, &done]() {
+        try {
+          sync.Wait();
+          FAIL();
+        } catch (interrupted_exception& ex) {
+          done = true;
+        }
+      });
+    });
+
+    std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(50));
+    sync.Synchronized<void>([&sync]() {
+      sync.Interrupt();
+    });
+    t1.join();
+    ASSERT_TRUE(done);
+  }
 } // synchronizabletest
 } // concurrent
 } // mdl
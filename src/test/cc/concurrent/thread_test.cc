@@ -28,8 +28,12 @@
 
 #include <mdl/concurrent.h>
 
+#include <atomic>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <memory>
+#include <pthread.h>
+#include <system_error>
 #include <thread>
 #include <unordered_map>
 
@@ -67,13 +71,13 @@ namespace threadtest {
     bool d2 = false;
     bool d3 = false;
 
-    std::thread t1 = factory.NewThread(AssertName, std::string("threads-1"), std::ref(d1));
+    Thread t1 = factory.NewThread(AssertName, std::string("threads-1"), std::ref(d1));
     std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(20));
 
-    std::thread t2 = factory.NewThread(AssertName, std::string("threads-2"), std::ref(d2));
+    Thread t2 = factory.NewThread(AssertName, std::string("threads-2"), std::ref(d2));
     std::this_thread::sleep_for(std::chrono::duration<long, std::milli>(20));
 
-    std::thread t3 = factory.NewThread(AssertName, std::string("threads-3"), std::ref(d3));
+    Thread t3 = factory.NewThread(AssertName, std::string("threads-3"), std::ref(d3));
 
     t1.join();
     t2.join();
@@ -84,6 +88,92 @@ namespace threadtest {
     ASSERT_TRUE(d3);
   }
 
+  TEST(ThreadTestSuite, TestThread_ThreadFactory_Options) {
+    std::atomic_int started = 0;
+    std::atomic_int exited = 0;
+    ThreadOptions options;
+    options.stackSize = 256 * 1024;
+    options.schedulingPolicy = SchedulingPolicy::kBatch;
+    options.onStart = [&started]() { 
+      ASSERT_EQ("lean-worker-1", this_thread::get_name());
+      started++; 
+    };
+    options.onExit = [&exited]() { exited++; };
+    ThreadFactory factory("lean-worker", options);
+
+    std::string nativeName;
+    size_t stackSize = 0;
+    int policy = -1;
+    Thread t1 = factory.NewThread([&]() {
+      ASSERT_EQ(1, started);
+      ASSERT_EQ(0, exited);
+
+      char buffer[16];
+      pthread_getname_np(pthread_self(), buffer, sizeof(buffer));
+      nativeName = buffer;
+
+      pthread_attr_t attr;
+      pthread_getattr_np(pthread_self(), &attr);
+      pthread_attr_getstacksize(&attr, &stackSize);
+      pthread_attr_destroy(&attr);
+
+      sched_param param;
+      pthread_getschedparam(pthread_self(), &policy, &param);
+    });
+    t1.join();
+
+    ASSERT_EQ("lean-worker-1", nativeName);
+    ASSERT_EQ(256 * 1024, stackSize);
+    ASSERT_EQ(SCHED_BATCH, policy);
+    ASSERT_EQ(1, exited);
+
+    // threads created elsewhere still get the default.
+    std::thread t2([&stackSize]() {
+      pthread_attr_t attr;
+      pthread_getattr_np(pthread_self(), &attr);
+      pthread_attr_getstacksize(&attr, &stackSize);
+      pthread_attr_destroy(&attr);
+    });
+    t2.join();
+    ASSERT_NE(256 * 1024, stackSize);
+
+    options.onStart = nullptr;
+    ThreadFactory longNames("a-rather-long-thread-name", options);
+    Thread t3 = longNames.NewThread([&nativeName]() {
+      char buffer[16];
+      pthread_getname_np(pthread_self(), buffer, sizeof(buffer));
+      nativeName = buffer;
+    });
+    t3.join();
+    // cut down to what the kernel allows.
+    ASSERT_EQ("a-rather-long-t", nativeName);
+    ASSERT_EQ(2, exited);
+  }
+
+  TEST(ThreadTestSuite, TestThread_Thread) {
+    Thread empty;
+    ASSERT_FALSE(empty.joinable());
+    ASSERT_EQ(std::thread::id(), empty.get_id());
+    ASSERT_THROW(empty.join(), std::system_error);
+
+    ThreadFactory factory("moved");
+    std::thread::id inside;
+    Thread t1 = factory.NewThread([&inside](std::unique_ptr<int> value) {
+      // move only arguments work, as with std::thread.
+      ASSERT_EQ(5, *value);
+      inside = std::this_thread::get_id();
+    }, std::make_unique<int>(5));
+    std::thread::id id = t1.get_id();
+    ASSERT_NE(std::thread::id(), id);
+
+    Thread t2 = std::move(t1);
+    ASSERT_FALSE(t1.joinable());
+    ASSERT_TRUE(t2.joinable());
+    t2.join();
+    ASSERT_FALSE(t2.joinable());
+    ASSERT_EQ(id, inside);
+  }
+
 } // threadtest
 } // concurrent
 } // mdl
@@ -0,0 +1,102 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "mdl/util.h"
+
+namespace mdl {
+namespace util {
+namespace blockpooltest {
+  typedef BlockPool<48, 16, 2> TestPool;
+
+  TEST(BlockPoolTestSuite, TestBlockPool_Recycles) {
+    // other tests on this thread may have left blocks behind, start from an empty cache.
+    std::vector<void*> drained;
+    while (TestPool::Cached() > 0) { drained.push_back(TestPool::Allocate()); }
+
+    void* b1 = TestPool::Allocate();
+    void* b2 = TestPool::Allocate();
+    void* b3 = TestPool::Allocate();
+    ASSERT_EQ(0, reinterpret_cast<std::uintptr_t>(b1) % 16);
+
+    TestPool::Release(b1);
+    TestPool::Release(b2);
+    // only caches up to 2 blocks, this one goes back to the allocator.
+    TestPool::Release(b3);
+    ASSERT_EQ(2, TestPool::Cached());
+
+    // last in, first out.
+    ASSERT_EQ(b2, TestPool::Allocate());
+    ASSERT_EQ(b1, TestPool::Allocate());
+    ASSERT_EQ(0, TestPool::Cached());
+
+    TestPool::Release(b1);
+    TestPool::Release(b2);
+    for (void* block : drained) { TestPool::Release(block); }
+  }
+
+  TEST(BlockPoolTestSuite, TestBlockPool_PerThread) {
+    void* block = TestPool::Allocate();
+    int cachedHere = TestPool::Cached();
+    int cachedThere = -1;
+
+    std::thread t1([block, &cachedThere]() {
+      TestPool::Release(block);
+      cachedThere = TestPool::Cached();
+    });
+    t1.join();
+
+    ASSERT_EQ(1, cachedThere);
+    ASSERT_EQ(cachedHere, TestPool::Cached());
+  }
+
+  struct ReleaseOnExit {
+    void* block = nullptr;
+
+    ~ReleaseOnExit() {
+      if (block) { TestPool::Release(block); }
+    }
+  };
+
+  TEST(BlockPoolTestSuite, TestBlockPool_ReleaseAfterThreadCache) {
+    std::thread t1([]() {
+      // constructed before the thread's cache, so destroyed after it.
+      static thread_local ReleaseOnExit holder;
+      holder.block = TestPool::Allocate();
+      TestPool::Release(TestPool::Allocate());
+      ASSERT_EQ(1, TestPool::Cached());
+    });
+    // the holder's block went straight back to the allocator, rather than leaking.
+    t1.join();
+  }
+} // blockpooltest
+} // util
+} // mdl
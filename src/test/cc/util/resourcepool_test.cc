@@ -0,0 +1,196 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "mdl/util.h"
+
+namespace mdl {
+namespace util {
+namespace resourcepooltest {
+  struct Buffer {
+    int id;
+    long uses = 0;
+    Buffer(int id) : id(id) {}
+  };
+
+  ResourcePool<Buffer>::factory_t Counting(std::atomic_int& created) {
+    return [&created]() { return std::make_unique<Buffer>(created++); };
+  }
+
+  TEST(ResourcePoolTestSuite, TestResourcePool_BorrowAndReturn) {
+    std::atomic_int created = 0;
+    ResourcePoolOptions options;
+    options.maxSize = 2;
+    ResourcePool<Buffer> pool(Counting(created), options);
+    ASSERT_EQ(0, pool.Size());
+
+    {
+      auto b1 = pool.Borrow();
+      auto b2 = pool.Borrow();
+      ASSERT_NE(b1->id, b2->id);
+      ASSERT_EQ(2, pool.Size());
+      ASSERT_EQ(0, pool.Idle());
+
+      ResourcePool<Buffer>::Handle b3;
+      ASSERT_FALSE(pool.TryBorrow(b3));
+      instant start = Now();
+      ASSERT_FALSE(pool.TryBorrow(b3, 20));
+      ASSERT_GE(EllapsedTime(start, Now()) / 1000L, 20);
+      ASSERT_FALSE(b3);
+    }
+
+    ASSERT_EQ(2, pool.Idle());
+    // the thread gets back the last resource it returned.
+    auto b1 = pool.Borrow();
+    int id = b1->id;
+    b1.Return();
+    ASSERT_EQ(id, pool.Borrow()->id);
+    ASSERT_EQ(2, created);
+  }
+
+  TEST(ResourcePoolTestSuite, TestResourcePool_WarmUpAndDiscard) {
+    std::atomic_int created = 0;
+    ResourcePoolOptions options;
+    options.minSize = 2;
+    options.maxSize = 3;
+    ResourcePool<Buffer> pool(Counting(created), options);
+    ASSERT_EQ(2, created);
+    ASSERT_EQ(2, pool.Idle());
+
+    ASSERT_EQ(1, pool.WarmUp(5));
+    ASSERT_EQ(3, pool.Size());
+
+    auto b1 = pool.Borrow();
+    b1.Discard();
+    ASSERT_FALSE(b1);
+    ASSERT_EQ(2, pool.Size());
+
+    std::vector<ResourcePool<Buffer>::Handle> all;
+    for (int i = 0; i < 3; i++) { all.push_back(pool.Borrow()); }
+    ASSERT_EQ(4, created);
+  }
+
+  TEST(ResourcePoolTestSuite, TestResourcePool_FactoryFails) {
+    bool fail = true;
+    ResourcePoolOptions options;
+    options.maxSize = 1;
+    ResourcePool<Buffer> pool([&fail]() {
+      if (fail) { throw std::runtime_error("Can't connect"); }
+      return std::make_unique<Buffer>(1);
+    }, options);
+
+    ASSERT_THROW(pool.Borrow(), std::runtime_error);
+    ASSERT_EQ(0, pool.Size());
+
+    // the slot is still there for the next attempt.
+    fail = false;
+    ASSERT_EQ(1, pool.Borrow()->id);
+  }
+
+  TEST(ResourcePoolTestSuite, TestResourcePool_EvictsIdle) {
+    std::atomic_int created = 0;
+    ResourcePoolOptions options;
+    options.minSize = 1;
+    options.maxSize = 4;
+    options.maxIdleMillis = 20;
+    ResourcePool<Buffer> pool(Counting(created), options);
+
+    {
+      std::vector<ResourcePool<Buffer>::Handle> all;
+      for (int i = 0; i < 4; i++) { all.push_back(pool.Borrow()); }
+    }
+    ASSERT_EQ(4, pool.Size());
+    ASSERT_EQ(0, pool.EvictIdle());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    ASSERT_EQ(3, pool.EvictIdle());
+    ASSERT_EQ(1, pool.Size());
+    ASSERT_EQ(1, pool.Idle());
+  }
+
+  TEST(ResourcePoolTestSuite, TestResourcePool_WaitsWhenExhausted) {
+    std::atomic_int created = 0;
+    ResourcePoolOptions options;
+    options.maxSize = 1;
+    ResourcePool<Buffer> pool(Counting(created), options);
+
+    auto b1 = pool.Borrow();
+    std::thread t1([&b1]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      b1.Return();
+    });
+
+    ResourcePool<Buffer>::Handle b2;
+    ASSERT_TRUE(pool.TryBorrow(b2, 5000));
+    ASSERT_EQ(0, b2->id);
+    t1.join();
+  }
+
+  TEST(ResourcePoolTestSuite, TestResourcePool_Contended) {
+    std::atomic_int created = 0;
+    ResourcePoolOptions options;
+    options.maxSize = 3;
+    options.threadCaches = 2;
+    ResourcePool<Buffer> pool(Counting(created), options);
+    std::atomic_int inUse = 0;
+    std::atomic_int maxInUse = 0;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+      threads.emplace_back([&pool, &inUse, &maxInUse]() {
+        for (int i = 0; i < 2000; i++) {
+          auto buffer = pool.Borrow();
+          int now = ++inUse;
+          int seen = maxInUse.load();
+          while (now > seen && !maxInUse.compare_exchange_weak(seen, now)) {}
+          buffer->uses++;
+          inUse--;
+        }
+      });
+    }
+    for (auto& t : threads) { t.join(); }
+
+    ASSERT_LE(maxInUse, 3);
+    ASSERT_LE(created, 3);
+    ASSERT_EQ(pool.Size(), pool.Idle());
+
+    long uses = 0;
+    std::vector<ResourcePool<Buffer>::Handle> all;
+    for (int i = 0; i < pool.Size(); i++) { 
+      all.push_back(pool.Borrow()); 
+      uses += all.back()->uses;
+    }
+    ASSERT_EQ(8 * 2000, uses);
+  }
+} // resourcepooltest
+} // util
+} // mdl
@@ -0,0 +1,50 @@
+// Copyright (c) 2022, Marcio Lucca
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "mdl/util.h"
+
+TEST(ThreadHintTestSuite, TestNumThreadSlots) {
+  ASSERT_EQ(1, mdl::util::NumThreadSlots(1));
+  ASSERT_EQ(4, mdl::util::NumThreadSlots(3));
+  ASSERT_EQ(8, mdl::util::NumThreadSlots(8));
+  ASSERT_LE(std::thread::hardware_concurrency(), (unsigned) mdl::util::NumThreadSlots(0));
+}
+
+TEST(ThreadHintTestSuite, TestThreadHint) {
+  int mine = mdl::util::ThreadHint();
+  int other;
+  std::thread([&other]() { other = mdl::util::ThreadHint(); }).join();
+  ASSERT_NE(mine, other);
+  ASSERT_EQ(mine, mdl::util::ThreadHint());
+
+  mdl::util::NextThreadHint();
+  ASSERT_NE(mine, mdl::util::ThreadHint());
+}